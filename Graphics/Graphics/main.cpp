@@ -1,8 +1,36 @@
 #include <stdlib.h>
+#include <chrono>
 #include <time.h>
 #include <math.h>
+#include "glew.h"
 #include "glut.h"
 #include <stdio.h>
+#include <string.h>
+#include "../asset_pack.h"
+#include "../batch.h"
+#include "../bvh.h"
+#include "../collision.h"
+#include "../city.h"
+#include "../culling.h"
+#include "../draw_queue.h"
+#include "../frame_arena.h"
+#include "../gpu_scene.h"
+#include "../hud.h"
+#include "../jobs.h"
+#include "../lockfree.h"
+#include "../mesh_cache.h"
+#include "../occlusion.h"
+#include "../owl_model.h"
+#include "../pathtracer.h"
+#include "../picking.h"
+#include "../poster.h"
+#include "../primitives.h"
+#include "../scene_graph.h"
+#include "../vecmath.h"
+#include "../simulation.h"
+#include "../text.h"
+#include "../ui.h"
+#include "../vertex_format.h"
 // --- Constants ---
 const double PI = 3.14159;
 
@@ -10,37 +38,121 @@ const double PI = 3.14159;
 const int WINDOW_WIDTH = 600;
 const int WINDOW_HEIGHT = 600;
 
+// Perspective projection of the 3D view: left, right, bottom, top, near, far
+const float VIEW_FRUSTUM[6] = { -1, 1, -1, 1, 1, 300 };
+
 const int TW = 256;
 const int TH = 256;
 
 // Ground size
 const int GROUND_SIZE = 100;
 
+// Spheres culled per run by the --bench-jobs scaling benchmark
+const int BENCHMARK_SPHERES = 1 << 18;
+
+// Baked textures and terrain, written by --bake and used when they match the generators
+const char* const ASSET_PACK_FILE = "house.pak";
+const unsigned HOUSE_ASSET_REVISION = 1; // Bump when a texture or terrain generator changes
+
+// Passes over the terrain per vertex format in the --bench-vertex benchmark
+const int BENCHMARK_VERTEX_PASSES = 200;
+
+// Objects in the synthetic scene checked by --verify-gpu-cull
+const int VERIFY_GPU_OBJECTS = 20000;
+
+// Procedural city around the house (--city N), and the --bench-city object counts
+const unsigned CITY_SEED = 12345;
+const float CITY_CLEAR = 64; // Half size of the square left to the house and its terrain
+const int BENCHMARK_CITY_COUNTS[] = { 10, 100, 1000, 10000, 100000 };
+const int BENCHMARK_CITY_WARMUP = 10;  // Frames per count before timing starts
+const int BENCHMARK_CITY_FRAMES = 120; // Timed frames per count
+
+// Path tracer lights: the sky is the clear color, the sun is high behind the starting view
+const float PATH_SKY[3] = { 0.8f, 0.9f, 1 };
+const Vec3 PATH_SUN_DIRECTION = { 0.45f, 0.8f, 0.4f };
+const float PATH_SUN[3] = { 1.1f, 1.05f, 0.95f };
+const int BENCHMARK_PATH_PASSES = 8; // Passes per worker count in --bench-path
+
+// --batch DIR renders a thumbnail per house variant; defaults for what its arguments leave out
+const int BATCH_SIZE = 256;
+const int BATCH_SAMPLES = 16;
+const BatchRange BATCH_RANGES[] = { { "floors", 1, CITY_MAX_FLOORS, CITY_MAX_FLOORS },
+    { "windows", 1, CITY_WINDOW_REPEATS, CITY_WINDOW_REPEATS },
+    { "roof", -59.5, 60.5, 5 } }; // Floor count, window repeat and roof color slider value
+
+// F4 renders the current view into this file, POSTER_WIDTH pixels across (--poster FILE W [H] for any size)
+const char* const POSTER_FILE = "house_poster.png";
+const int POSTER_WIDTH = 16384;
+
+// Most floors the FLOORS slider can select
+const int MAX_FLOORS = 5;
+
+// Resolution of the CPU depth buffer used for occlusion culling
+const int OCCLUSION_SIZE = 128;
+
+// Terrain is culled in square chunks of this many cells
+const int GROUND_CHUNK = 10;
+const int GROUND_CHUNKS = (GROUND_SIZE + GROUND_CHUNK - 1) / GROUND_CHUNK;
+
+// Clicks pick objects up to the far plane
+const float PICK_DISTANCE = 300;
+
 // Camera properties
+const float CAMERA_RADIUS = 2; // Of the sphere that collides with the scene
 const double INITIAL_EYE_X = 2;
 const double INITIAL_EYE_Y = 25;
 const double INITIAL_EYE_Z = 70;
 
+// Simulation rate (input handling and camera integration)
+const int SIM_TICKS_PER_SECOND = 120;
+
+// --- Simulation <-> Render ---
+// Everything the render thread needs to draw one frame
+struct FrameSnapshot {
+    Vec3 eye;
+    Vec3 direction;
+    int numFloors;
+    double roofColorOffset;
+    int numWindows;
+    int pickX, pickY;  // Last click in the 3D view, window coordinates
+    unsigned picks;    // Clicks in the 3D view so far
+    bool pathTrace;    // Path traced still instead of the rasterized view
+    unsigned posters;  // Poster renders requested so far
+};
+
+// Raw input forwarded from the GLUT callbacks to the simulation thread
+enum InputType { INPUT_SPECIAL_KEY, INPUT_MOUSE_BUTTON, INPUT_MOUSE_DRAG };
+struct InputEvent {
+    InputType type;
+    int key;            // INPUT_SPECIAL_KEY
+    int button, state;  // INPUT_MOUSE_BUTTON
+    int x, y;
+};
+
 // --- Global Variables ---
 
 // Terrain height map
 double ground[GROUND_SIZE][GROUND_SIZE] = { 0 };
 
-// Texture map
-unsigned char tx[TH][TW][3];
+// Texture maps 1-3, generated in parallel before upload
+typedef unsigned char TextureImage[TH][TW][3];
+TextureImage textureImages[3];
+AssetTexture textures[3];                       // Mip chains of textures #1-3, from the pack or built
+std::vector<unsigned char> textureMipStorage[3]; // Levels of procedurally generated textures
+AssetPack assets;                               // Mapped for the whole run when assets come from it
+
 
+// Camera and slider state below is owned by the simulation thread
 
 // Camera position
-double eyeX = INITIAL_EYE_X;
-double eyeY = INITIAL_EYE_Y;
-double eyeZ = INITIAL_EYE_Z;
+Vec3 eye = { INITIAL_EYE_X, INITIAL_EYE_Y, INITIAL_EYE_Z };
 
 // Camera movement
 double speed = 0.0;
 double angularSpeed = 0.0;
 double sightAngle = PI; // Angle in x-z plane
 double pitch = 0.0;
-double direction[3] = { sin(sightAngle), 0, cos(sightAngle) };
+Vec3 direction = { sinf(sightAngle), 0, cosf(sightAngle) };
 
 int isCaptured = 0;
 
@@ -48,9 +160,112 @@ int numFloors = 2;
 double roofColorOffset = 0.5;
 int numWindows = 2;
 
+int pickX = 0, pickY = 0; // Click to pick an object at
+unsigned picks = 0;
+bool pathTrace = false;   // Toggled with F3
+unsigned posters = 0;     // Incremented with F4
+
+// Camera collision: built before the simulation starts, then only used by it
+CollisionWorld collision;
+CollisionMesh wallCollisionMesh, roofCollisionMesh, postCollisionMesh, fenceCollisionMesh, owlCollisionMesh;
+int wallColliders[MAX_FLOORS];  // Walls of 1 to MAX_FLOORS floors, one enabled at a time
+int roofColliders[MAX_FLOORS];  // The roof on top of each
+int collisionFloors = 0;        // Floor count the enabled colliders are for
+
 
 bool isWindowsTexture = false;
 
+// House and fence scene graph (render thread)
+SceneGraph houseGraph;
+int floorNodes[MAX_FLOORS];     // One node per possible floor
+int roofNode = -1;
+int roofFloors = 0;             // Floor count the roof node was last placed for
+MeshCache wallMeshes;           // Walls of every floor count and window repeat in use
+const MeshCacheSlot* walls = 0; // Walls drawn this frame, picked by CullScene
+std::vector<int> fenceWallNodes;
+std::vector<int> fencePostNodes;
+
+// Frustum culling (render thread)
+struct NodeBounds {
+    int node;
+    Vec3 center;  // Local bounding sphere
+    float radius;
+    bool isOccluder; // Rasterized into the occlusion buffer instead of tested against it
+};
+std::vector<NodeBounds> houseBounds;  // One per drawn node, same order as houseCull
+std::vector<int> nodeCullIndex;       // Scene node -> houseCull index, -1 for groups
+CullSet houseCull;
+Aabb groundChunks[GROUND_CHUNKS][GROUND_CHUNKS];
+bool groundChunkVisible[GROUND_CHUNKS][GROUND_CHUNKS];
+PackedMesh groundMeshes[GROUND_CHUNKS][GROUND_CHUNKS]; // 16 bytes per vertex, see vertex_format.h
+const Aabb ROAD_BOUNDS = { { -4, 0.1f, 10 }, { 4, 0.1f, GROUND_SIZE / 2 - 1.0f } };
+bool roadVisible = true;
+
+// Picking (render thread)
+enum PickKind { PICK_NONE, PICK_HOUSE, PICK_FENCE_WALL, PICK_FENCE_POST, PICK_CITY_HOUSE, PICK_CITY_OWL };
+const char* const PICK_NAMES[] = { "nothing", "house", "fence wall", "fence post", "city house", "city owl" };
+Bvh houseBvh;                  // Boxes of houseCull's spheres, refit when nodes move
+PickKind pickedKind = PICK_NONE;
+int picked = -1;               // Scene node, or city house or owl index
+unsigned picksDone = 0;        // Pick requests handled, compared with the snapshot's
+double pickMilliseconds = 0;
+
+// Procedural city (render thread)
+City city;
+bool cityMode = false;
+OwlModel cityOwl;                 // Drawn once per city owl, each part at instance world * part world
+bool cityMeshesBuilt = false;
+Bvh cityBvh;                      // Over the instances' bounding spheres, in cull set order
+std::vector<int> cityVisible;     // Instances in the frustum, from the BVH
+std::vector<int> cityRoadsVisible;
+int cityHousesDrawn = 0, cityOwlsDrawn = 0;
+
+// Occlusion culling: the house prisms hide the fence, road and terrain behind them
+OcclusionBuffer occlusion;
+Vec3 wallOccluder[8], roofOccluder[8]; // Same shapes DrawCylinder1 draws for walls and roof
+const int PRISM_INDICES[] = {
+    0, 1, 5, 0, 5, 4,  1, 2, 6, 1, 6, 5,  2, 3, 7, 2, 7, 6,  3, 0, 4, 3, 4, 7
+};
+
+// Path tracer (render thread): the scene as of pathFrame, refined while the view stays at pathView
+PtScene pathScene;
+PtRender pathRender;
+PackedMesh pathWalls;           // Walls for the traced floor count, built directly rather than cached
+PtScene pathBase;               // Everything but the house, which is all the sliders change
+int pathBricks = -1;            // pathBase's texture for the walls
+FrameSnapshot pathFrame;        // Slider values pathScene was built for
+Matrix4 pathView;
+bool pathSceneBuilt = false;
+
+// Poster rendering (render thread)
+unsigned postersDone = 0;       // Poster requests handled, compared with the snapshot's
+PosterStats posterStats;
+bool posterWritten = false;
+
+// Walls of every floor count and window repeat, built once for the city and --batch
+PackedMesh wallVariants[CITY_MAX_FLOORS][CITY_WINDOW_REPEATS];
+bool wallVariantsBuilt = false;
+BatchRange batchRanges[3];
+
+// Draw packets of the frame being drawn (render thread)
+DrawQueue drawQueue;
+
+// GPU-driven fence: culled by a compute shader and drawn with one multi-draw (render thread)
+GpuScene fenceScene;
+bool gpuFence = false;
+int gpuFenceVisible = 0;
+
+// Slider panel (layout is fixed after init and read by both threads)
+UiPanel sliderPanel;
+
+// Threading
+SpscQueue<InputEvent, 256> inputEvents; // GLUT thread -> simulation thread
+TripleBuffer<FrameSnapshot> frames;     // Simulation thread -> render thread
+FrameSnapshot frame;                    // Snapshot being drawn (render thread only)
+
+// Camera matrices of the frame being drawn, computed on the CPU
+Matrix4 projection, view, viewProjection;
+
 // --- Function Prototypes ---
 void init();
 void display();
@@ -59,19 +274,86 @@ void idle();
 void specialKeyboard(int key, int x, int y);
 void mouseClick(int button, int state, int x, int y);
 void mouseDrag(int x,int y);
-void setTexture(int texture);
+void simulationTick();
+void publishFrame();
+void handleSpecialKey(int key);
+void handleMouseClick(int button, int state, int x, int y);
+void handleMouseDrag(int x, int y);
+void setTexture(int texture, TextureImage tx);
+void GenerateTextures();
+void GenerateTextureJob(void* data);
 void DrawCylinder1(int num_sides, double topr, double bottomr);
 void DrawFloor();
+void DrawFloorChunk(const DrawPacket& packet);
+void BuildHouse();
+void PlaceRoof(int floors);
+Matrix4 RoofMatrix(int floors);
+int FloorCount(int numFloors);
 void DrawHouse();
+unsigned WallMeshKey(int floors, int windowRepeat);
+void BuildWallMesh(unsigned key, PackedMesh& mesh);
+void DrawWalls(const DrawPacket& packet);
+void BuildFence();
+void AddFenceWall(int parent, const Matrix4& local);
 void DrawFence();
-void DrawFenceWall();
+void DrawFenceWall(const DrawPacket& packet);
+void BuildGpuFence();
+int BuildPrismMesh(GpuScene& scene, int sides, float topr, float bottomr);
+void UpdateGpuFencePick();
 void DrawRoad();
-
-void DrawSliderControl(char* heading, double translated);
-
-void bricksTexture();
-void roadTexture();
-void windowsTexture();
+void DrawRoadGeometry(const DrawPacket& packet);
+void DrawPrism(const DrawPacket& packet);
+void AddBounds(int node, const Vec3& center, float radius);
+void UpdateBounds();
+void BuildHouseBvh();
+void BuildGroundChunks();
+void BuildGroundChunkRows(void* data, int begin, int end);
+void GroundChunkGrid(int ci, int cj, std::vector<Vec3>& positions, std::vector<unsigned>& indices);
+void BuildPrismOccluder(Vec3* vertices, double topr, double bottomr);
+void CullScene();
+void DrawScene();
+void BuildCollision();
+void DrawPathTraced();
+void BuildPathScene();
+void BuildPathBase();
+void AddPathHouse(PtScene& scene, int floors, int windowRepeat, double roofColorOffset, const PackedMesh& walls);
+bool RenderPoster(const char* path, int width, int height);
+void DrawPosterTile(const Matrix4& tileProjection, void* data);
+void SetCollisionFloors(int floors);
+float TerrainHeight(float x, float z);
+void BuildCity(int count);
+void BuildWallVariants();
+void CullCity();
+void DrawCity();
+void DrawCityGround(const DrawPacket& packet);
+void DrawCityRoad(const DrawPacket& packet);
+void DrawCityWalls(const DrawPacket& packet);
+void DrawCityOwlPart(const DrawPacket& packet);
+int CullOccluded();
+bool IsNodeVisible(int node);
+void PickScene();
+PickKind HouseNodeKind(int node);
+bool PickHouseObject(void* data, int object, const Vec3& origin, const Vec3& direction, float* t);
+bool PickCityObject(void* data, int object, const Vec3& origin, const Vec3& direction, float* t);
+bool IsPicked(PickKind kind, int index);
+Vec3 NodeCenter(int node);
+
+void SetupSliders();
+
+void bricksTexture(TextureImage tx);
+void roadTexture(TextureImage tx);
+void windowsTexture(TextureImage tx);
+unsigned HouseAssetKey();
+bool LoadAssets();
+int BakeAssets(const char* path);
+void BenchmarkJobs();
+void BenchmarkVertexFormats();
+void BuildWithoutWindow();
+void BenchmarkPathTracer();
+int RunBatch(const char* directory, int argc, char* argv[]);
+void BuildBatchVariant(int variant, PtScene& scene, char name[BATCH_NAME_LENGTH], void* data);
+int VerifyGpuCulling();
+int BenchmarkCity();
 
 
 // --- Initialization ---
@@ -81,127 +363,202 @@ void init() {
     glClearColor(0.8, 0.9, 1, 0); // Background color
     glEnable(GL_DEPTH_TEST);    // Enable depth testing for 3D rendering
 
-    // setup texture
-    setTexture(1);
-    glBindTexture(GL_TEXTURE_2D, 1); // this is a texture #1 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, TW, TH, 0, GL_RGB, GL_UNSIGNED_BYTE, tx);
-
-
-    setTexture(2);
-    glBindTexture(GL_TEXTURE_2D, 2); // this is a texture #1 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, TW, TH, 0, GL_RGB, GL_UNSIGNED_BYTE, tx);
-
-    setTexture(3);
-    glBindTexture(GL_TEXTURE_2D, 3); // this is a texture #1 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, TW, TH, 0, GL_RGB, GL_UNSIGNED_BYTE, tx);
+    glewInit();     // Load FBO entry points for the cached slider panel and glyph atlases
+    DrawQueueInitRing(); // Per-object uniforms through a mapped ring when supported
+    TextLoadFont(GLUT_BITMAP_HELVETICA_12); // HUD font
+    SetupSliders(); // Slider layout
+    MeshCacheInit(wallMeshes, BuildWallMesh);
+    BuildHouse();   // House and fence scene graph
+    BuildFence();
+    SceneUpdate(houseGraph);
+    UpdateBounds();
+    BuildHouseBvh();
+    BuildGpuFence(); // Needs the fence's world matrices
+    bool baked = LoadAssets();
+    if (baked) printf("Textures and terrain mapped from %s\n", ASSET_PACK_FILE);
+    else BuildGroundChunks();
+    OcclusionInit(occlusion, OCCLUSION_SIZE, OCCLUSION_SIZE);
+    BuildPrismOccluder(wallOccluder, 17, 17);
+    BuildPrismOccluder(roofOccluder, 0, 17);
+
+    // setup textures #1-3
+    if (!baked) {
+        GenerateTextures();
+        for (int i = 0; i < 3; i++)
+            AssetTextureBuildMips(textureImages[i][0][0], TW, TH, textureMipStorage[i], textures[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, i + 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        AssetTextureUpload(textures[i]); // Straight from the mapped pack when baked
+    }
 
+    publishFrame(); // First snapshot, before the simulation thread starts
 }
 void display() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    frame = frames.read(); // Latest simulation state, never waits
+    view = MatLookAt(frame.eye, frame.eye + frame.direction, MakeVec3(0, 1, 0));
+    if (frame.posters != postersDone) // Before the frame's HUD lines, which the tiles' would crowd out
+        RenderPoster(POSTER_FILE, POSTER_WIDTH, POSTER_WIDTH * WINDOW_HEIGHT / WINDOW_WIDTH);
+
+    HudBeginFrame();
+    FrameArenaBeginFrame(); // Transient data from two frames ago is released here
+    HudPrint("frame arena %.1f KB  peak %.1f KB", FrameArenaLastFrameBytes() / 1024.0, FrameArenaPeakBytes() / 1024.0);
+
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    projection = MatFrustum(VIEW_FRUSTUM[0], VIEW_FRUSTUM[1], VIEW_FRUSTUM[2], VIEW_FRUSTUM[3], VIEW_FRUSTUM[4],
+        VIEW_FRUSTUM[5]); // Perspective projection
+    viewProjection = MatMultiply(projection, view);
     glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glFrustum(-1, 1, -1, 1, 1, 300);
+    glLoadMatrixf(projection.m);
 
     glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    gluLookAt(eyeX, eyeY, eyeZ,
-        eyeX + direction[0], eyeY + direction[1], eyeZ + direction[2],
-        0, 1, 0);
+    glLoadMatrixf(view.m);
 
-    DrawFloor();
-    DrawHouse();
-    DrawFence();
-    DrawRoad();
+    if (frame.pathTrace) { // Replaces the rasterized scene
+        DrawPathTraced();
+    } else {
+        DrawScene();
+        if (frame.picks != picksDone) PickScene();
+    }
+    HudPrint("draw packets %d  state changes %d", (int)drawQueue.packets.size(), drawQueue.lastStateChanges);
+    HudPrint("uniform ring %s  stalls %d", DrawQueueUsesRing() ? "on" : "off", DrawQueueRingStalls());
+    HudPrint("wall meshes  hits %d  builds %d  evictions %d%s", wallMeshes.hits, wallMeshes.misses,
+        wallMeshes.evictions, wallMeshes.building >= 0 ? "  building" : "");
+    if (pickedKind != PICK_NONE) HudPrint("picked %s %d  %.3f ms", PICK_NAMES[pickedKind], picked, pickMilliseconds);
+    if (cityMode)
+        HudPrint("city %d houses  %d owls  drawn %d + %d", (int)city.houses.size(), (int)city.owls.size(),
+            cityHousesDrawn, cityOwlsDrawn);
+    if (gpuFence && !frame.pathTrace) HudPrint("gpu fence %d / %d", gpuFenceVisible, (int)fenceScene.objects.size());
+    if (postersDone)
+        HudPrint("poster (F4) %s  %d tiles  %.1f s", posterWritten ? POSTER_FILE : "failed", posterStats.tiles,
+            posterStats.seconds);
 
     // 2D Rendering
-    glViewport(WINDOW_WIDTH / 2 + 150, 0, 150, WINDOW_HEIGHT);
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glOrtho(0, 150, 0, 600, -1, 1); 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
     glDisable(GL_DEPTH_TEST);
 
-    // SLIDER WINDOW BACKGROUND
-    glColor3d(0.6, 0.6, 0.6);
-    glBegin(GL_POLYGON);
-    glVertex2d(0, 0);
-    glVertex2d(0, 600);
-    glVertex2d(150, 600);
-    glVertex2d(150, 0);
-    glEnd();
+    // Draw sliders (the panel is re-rendered only when a value changed)
+    UiSetSliderValue(sliderPanel, 0, frame.roofColorOffset - 0.5);
+    UiSetSliderValue(sliderPanel, 1, frame.numFloors - 2);
+    UiSetSliderValue(sliderPanel, 2, frame.numWindows - 4);
+    UiDraw(sliderPanel);
+    HudDraw(0, 0, WINDOW_WIDTH / 2 + 150, WINDOW_HEIGHT); // Stats over the 3D view, left of the panel
 
-    // Draw sliders
-    glColor3d(1, 1, 1);
-    char text[] = "ROOF";
-    glRasterPos2d(38, 500);
-    DrawSliderControl(text, roofColorOffset-0.5);
-
-    glColor3d(1, 1, 1);
-    char text2[] = "FLOORS";
-    glPushMatrix();
-    glTranslated(0, -200, 0);
-    glRasterPos2d(30, 500);
-    DrawSliderControl(text2, numFloors-2);
-    glPopMatrix();
-
-
-    glColor3d(1, 1, 1);
-    char text3[] = "WINDOWS";
-    glPushMatrix();
-    glTranslated(0, -400, 0);
-    glRasterPos2d(15, 500);
-    DrawSliderControl(text3, numWindows-4);
-    glPopMatrix();
-
-    glPopMatrix(); // Restore original projection
     glEnable(GL_DEPTH_TEST);
 
     glutSwapBuffers();
 }
 
+// The rasterized scene, for the camera in projection, view and viewProjection
+void DrawScene() {
+    CullScene();
+    if (cityMode) CullCity();
+    DrawQueueBegin(drawQueue, projection, view); // The Draw functions below only record packets
+    DrawFloor();
+    DrawHouse();
+    DrawFence();
+    DrawRoad();
+    if (cityMode) DrawCity();
+    DrawQueueSubmit(drawQueue);      // Sorted by material, texture, then front to back
+    if (gpuFence) // Constant number of calls however many objects the fence has
+        gpuFenceVisible = GpuSceneDraw(fenceScene, viewProjection);
+}
+
 // --- Animation and Updates ---
 void idle() {
+    glutPostRedisplay(); // Request a redisplay
+}
+
+// --- Simulation (runs on the simulation thread) ---
+void simulationTick() {
+    InputEvent event;
+    while (inputEvents.pop(event)) {
+        switch (event.type) {
+        case INPUT_SPECIAL_KEY: handleSpecialKey(event.key); break;
+        case INPUT_MOUSE_BUTTON: handleMouseClick(event.button, event.state, event.x, event.y); break;
+        case INPUT_MOUSE_DRAG: handleMouseDrag(event.x, event.y); break;
+        }
+    }
 
     // -------- EGO MOTION ---------
     // Update camera orientation based on angular speed
     sightAngle += angularSpeed;
-    direction[0] = sin(sightAngle); // Update X direction
-    direction[1] = sin(pitch);      // Update Y direction
-    direction[2] = cos(sightAngle); // Update Z direction
-    // Update camera position based on speed and direction
-    eyeX += speed * direction[0];
-    eyeY += speed * direction[1];
-    eyeZ += speed * direction[2];
-
+    direction = MakeVec3(sinf(sightAngle), sinf(pitch), cosf(sightAngle)); // Update direction
+    // Update camera position based on speed and direction, sliding along whatever it runs into
+    SetCollisionFloors(FloorCount(numFloors));
+    eye = CollisionMove(collision, eye, eye + direction * speed, CAMERA_RADIUS);
+    float lowest = TerrainHeight(eye.x, eye.z) + CAMERA_RADIUS;
+    if (eye.y < lowest) eye.y = lowest;
+
+    publishFrame();
+}
 
-    glutPostRedisplay(); // Request a redisplay
+void publishFrame() {
+    FrameSnapshot& out = frames.writeSlot();
+    out.eye = eye;
+    out.direction = direction;
+    out.numFloors = numFloors;
+    out.roofColorOffset = roofColorOffset;
+    out.numWindows = numWindows;
+    out.pickX = pickX;
+    out.pickY = pickY;
+    out.picks = picks;
+    out.pathTrace = pathTrace;
+    out.posters = posters;
+    frames.publish();
 }
 
 
 
 // --- Main function ---
 int main(int argc, char* argv[]) {
+    JobsStart(0); // One worker per core, shared by texture, terrain and culling work
+    atexit(JobsStop);
+
+    bool verifyGpuCulling = false;
+    bool benchmarkCity = false;
+    int cityCount = 0;
+    const char* posterPath = 0;
+    int posterWidth = 0, posterHeight = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench-jobs") == 0) { // Scaling report instead of the window
+            BenchmarkJobs();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bake") == 0) // Write the asset pack instead of opening the window
+            return BakeAssets(i + 1 < argc ? argv[i + 1] : ASSET_PACK_FILE);
+        if (strcmp(argv[i], "--bench-vertex") == 0) { // Terrain rasterized from each vertex format
+            BenchmarkVertexFormats();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-path") == 0) { // Path tracer samples per second, no window
+            BenchmarkPathTracer();
+            return 0;
+        }
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) // Thumbnail per variant, no window
+            return RunBatch(argv[i + 1], argc - i - 2, argv + i + 2);
+        if (strcmp(argv[i], "--verify-gpu-cull") == 0) verifyGpuCulling = true;
+        if (strcmp(argv[i], "--city") == 0 && i + 1 < argc) cityCount = atoi(argv[++i]); // Houses and owls
+        if (strcmp(argv[i], "--bench-city") == 0) benchmarkCity = true; // Frame time per city size
+        if (strcmp(argv[i], "--poster") == 0 && i + 2 < argc) { // Write a poster of the starting view and exit
+            posterPath = argv[++i];
+            posterWidth = atoi(argv[++i]);
+            posterHeight = i + 1 < argc && argv[i + 1][0] != '-' ? atoi(argv[++i])
+                : posterWidth * WINDOW_HEIGHT / WINDOW_WIDTH;
+        }
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH); // Initialize display mode
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);          // Set window size
     glutInitWindowPosition(400, 100);                        // Set window position
     glutCreateWindow("3D Graphics");                         // Create window
+    if (verifyGpuCulling) return VerifyGpuCulling();         // Needs only the GL context
 
     glutDisplayFunc(display);     // Set display function
     glutIdleFunc(idle);           // Set idle function
@@ -209,57 +566,72 @@ int main(int argc, char* argv[]) {
     glutMouseFunc(mouseClick);
     glutMotionFunc(mouseDrag);
     init(); // Initialize the scene
+    if (benchmarkCity) return BenchmarkCity();
+    if (cityCount > 0) BuildCity(cityCount);
+    if (posterPath) {
+        frame = frames.read();
+        view = MatLookAt(frame.eye, frame.eye + frame.direction, MakeVec3(0, 1, 0));
+        return RenderPoster(posterPath, posterWidth, posterHeight) ? 0 : 1;
+    }
+    BuildCollision(); // Everything the camera can run into, city included
+
+    StartSimulation(simulationTick, SIM_TICKS_PER_SECOND); // Input and camera on their own thread
+    atexit(StopSimulation);
 
     glutMainLoop(); // Enter the main loop
     return 0;
 }
 
-void mouseClick(int button, int state, int x, int y)
+// --- Input forwarding (GLUT thread) ---
+// Callbacks only queue the raw event; all handling happens on the simulation thread
+void specialKeyboard(int key, int x, int y) {
+    InputEvent event = { INPUT_SPECIAL_KEY, key, 0, 0, x, y };
+    inputEvents.push(event);
+}
+
+void mouseClick(int button, int state, int x, int y) {
+    InputEvent event = { INPUT_MOUSE_BUTTON, 0, button, state, x, y };
+    inputEvents.push(event);
+}
+
+void mouseDrag(int x, int y) {
+    InputEvent event = { INPUT_MOUSE_DRAG, 0, 0, 0, x, y };
+    inputEvents.push(event);
+}
+
+void handleMouseClick(int button, int state, int x, int y)
 {
     if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
     {
         int clickX = x;
         int clickY = WINDOW_HEIGHT - y;
-        int center = 525;
-
-        int centerRoofInd =  (roofColorOffset-0.5) + center;
-        int centerFloorsInd = (numFloors-2) + center;
-        int centerWindowsInd = (numWindows-4) + center;
-
-        if (clickY <= 431 && clickY >= 408 &&
-            centerRoofInd + 7 >= clickX &&
-            centerRoofInd - 7 <= clickX) 
-            isCaptured = 1;
-        else if (clickY <= 233 && clickY >= 218 && 
-            centerFloorsInd + 7 >= clickX && 
-            centerFloorsInd - 7 <= clickX) 
-            isCaptured = 2;
-        else if (clickY <= 36 && clickY >= 18 &&
-            centerWindowsInd + 7 >= clickX &&
-            centerWindowsInd - 7 <= clickX) 
-            isCaptured = 3;
+
+        // Knob positions as drawn
+        double values[] = { roofColorOffset - 0.5, numFloors - 2.0, numWindows - 4.0 };
+
+        isCaptured = UiHitTest(sliderPanel, values, clickX, clickY) + 1; // 1-3, 0 for none
+        if (isCaptured == 0 && !UiPanelContains(sliderPanel, clickX, clickY)) { // In the 3D view: picked on the render thread
+            pickX = clickX;
+            pickY = clickY;
+            picks++;
+        }
     }
     if (button == GLUT_LEFT_BUTTON && state == GLUT_UP) 
         isCaptured = 0;
 }
 
-void mouseDrag(int x, int y)
+void handleMouseDrag(int x, int y)
 {
-    int lowLimit = 465;
-    int highLimit = 585;
-
-    int diff = x - 525;
+    double diff;
 
-    if (x > highLimit || x < lowLimit) return;
+    if (isCaptured == 0 || !UiSliderDrag(sliderPanel, isCaptured - 1, x, &diff)) return;
 
     if(isCaptured == 1) roofColorOffset = diff;
-    if(isCaptured == 2) numFloors = diff;
-    if(isCaptured == 3) numWindows = diff;
-
-    
+    if(isCaptured == 2) numFloors = (int)diff;
+    if(isCaptured == 3) numWindows = (int)diff;
 }
 
-void specialKeyboard(int key, int x, int y) {
+void handleSpecialKey(int key) {
     switch (key) {
     case GLUT_KEY_LEFT:
         angularSpeed += 0.0001; // Rotate camera left
@@ -279,82 +651,225 @@ void specialKeyboard(int key, int x, int y) {
     case GLUT_KEY_PAGE_DOWN:
         pitch -= 0.01; // Decrease pitch angle
         break;
+    case GLUT_KEY_F3:
+        pathTrace = !pathTrace; // Path traced still or rasterized view
+        break;
+    case GLUT_KEY_F4:
+        posters++; // Poster of the current view, rendered by the render thread
+        break;
     }
 }
 
 
 
 
+// One packet per visible chunk; cell (i, j) belongs to chunk (i / GROUND_CHUNK, j / GROUND_CHUNK)
 void DrawFloor() {
-    for (int i = 1; i < GROUND_SIZE; i++) {
-        for (int j = 1; j < GROUND_SIZE; j++) {
-            glBegin(GL_POLYGON);
-            glColor3d(0.18, 0.42, 0.26);
-            glVertex3d(j - GROUND_SIZE / 2, ground[i][j], i - GROUND_SIZE / 2);
-            glVertex3d(j - GROUND_SIZE / 2, ground[i - 1][j], i - GROUND_SIZE / 2 - 1);
-            glVertex3d(j - GROUND_SIZE / 2 - 1, ground[i - 1][j - 1], i - GROUND_SIZE / 2 - 1);
-            glVertex3d(j - GROUND_SIZE / 2 - 1, ground[i][j - 1], i - GROUND_SIZE / 2);
-            glEnd();
+    for (int ci = 0; ci < GROUND_CHUNKS; ci++) {
+        for (int cj = 0; cj < GROUND_CHUNKS; cj++) {
+            if (!groundChunkVisible[ci][cj]) continue;
+
+            const Aabb& box = groundChunks[ci][cj];
+            DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, (box.min + box.max) * 0.5f, DrawFloorChunk);
+            DrawPacketColor(packet, 0.18, 0.42, 0.26);
+            packet.params[0] = ci;
+            packet.params[1] = cj;
         }
     }
 }
 
-void DrawHouse() {
+void DrawFloorChunk(const DrawPacket& packet) {
+    PackedMeshDraw(groundMeshes[(int)packet.params[0]][(int)packet.params[1]]);
+}
 
-    int temp = ((numFloors + 61) / 30) + 1; // Converting the numFloors to 1-5 range
-   
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 1);
-    glTexEnvf(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_REPLACE);
+// Shared corner vertices of the chunk's cells, two triangles per cell in the
+// order the cell used to be drawn as a polygon
+void GroundChunkGrid(int ci, int cj, std::vector<Vec3>& positions, std::vector<unsigned>& indices) {
+    int firstI = ci == 0 ? 1 : ci * GROUND_CHUNK, lastI = (ci + 1) * GROUND_CHUNK;
+    int firstJ = cj == 0 ? 1 : cj * GROUND_CHUNK, lastJ = (cj + 1) * GROUND_CHUNK;
+    if (lastI > GROUND_SIZE) lastI = GROUND_SIZE;
+    if (lastJ > GROUND_SIZE) lastJ = GROUND_SIZE;
+
+    int columns = lastJ - firstJ + 1;
+    positions.clear();
+    indices.clear();
+    for (int i = firstI - 1; i < lastI; i++)
+        for (int j = firstJ - 1; j < lastJ; j++)
+            positions.push_back(MakeVec3(j - GROUND_SIZE / 2, (float)ground[i][j], i - GROUND_SIZE / 2));
+
+    for (int i = firstI; i < lastI; i++) {
+        for (int j = firstJ; j < lastJ; j++) {
+            unsigned corner = (i - firstI + 1) * columns + (j - firstJ + 1); // Vertex (i, j)
+            unsigned cell[4] = { corner, corner - columns, corner - columns - 1, corner - 1 };
+            unsigned triangles[6] = { cell[0], cell[1], cell[2], cell[0], cell[2], cell[3] };
+            indices.insert(indices.end(), triangles, triangles + 6);
+        }
+    }
+}
+
+// Bounds and packed mesh of every terrain chunk, from the cells' corner heights
+void BuildGroundChunks() {
+    JobParallelFor(GROUND_CHUNKS, 1, BuildGroundChunkRows, 0);
+}
+
+void BuildGroundChunkRows(void*, int begin, int end) {
+    std::vector<Vec3> positions, normals;
+    std::vector<unsigned> indices;
+    for (int ci = begin; ci < end; ci++) {
+        for (int cj = 0; cj < GROUND_CHUNKS; cj++) {
+            // Every corner GroundChunkGrid reads: the cells' triangles reach back one row and column
+            float low = 0, high = 0;
+            int firstI = ci > 0 ? ci * GROUND_CHUNK - 1 : 0, firstJ = cj > 0 ? cj * GROUND_CHUNK - 1 : 0;
+            for (int i = firstI; i <= ci * GROUND_CHUNK + GROUND_CHUNK && i < GROUND_SIZE; i++)
+                for (int j = firstJ; j <= cj * GROUND_CHUNK + GROUND_CHUNK && j < GROUND_SIZE; j++) {
+                    if (ground[i][j] < low) low = (float)ground[i][j];
+                    if (ground[i][j] > high) high = (float)ground[i][j];
+                }
+
+            Aabb& box = groundChunks[ci][cj];
+            box.min = MakeVec3(cj * GROUND_CHUNK - GROUND_SIZE / 2 - 1.0f, low, ci * GROUND_CHUNK - GROUND_SIZE / 2 - 1.0f);
+            box.max = MakeVec3((cj + 1) * GROUND_CHUNK - GROUND_SIZE / 2.0f, high, (ci + 1) * GROUND_CHUNK - GROUND_SIZE / 2.0f);
 
-    // HOUSE WALLS
-    for (int i = 0; i < temp; i++) {
-        glColor3d(1, 0.75, 0.45);
-        glPushMatrix();
-        glScaled(1, 17, 1);
-        glRotated(45, 0, 1, 0);
-        glTranslated(0, i, 0);
-        DrawCylinder1(4, 17, 17);
-        glPopMatrix();
+            GroundChunkGrid(ci, cj, positions, indices);
+            normals.resize(positions.size());
+            ComputeNormals(positions.data(), (int)positions.size(), indices.data(), (int)indices.size(), normals.data());
+            PackMesh(groundMeshes[ci][cj], positions.data(), normals.data(), 0, (int)positions.size(),
+                indices.data(), (int)indices.size());
+        }
     }
+}
+
+void BuildHouse() {
+    Matrix4 m;
+
+    // HOUSE WALLS, one node per floor; only the selected number is drawn
+    for (int i = 0; i < MAX_FLOORS; i++) {
+        m = MatIdentity();
+        MatScale(m, 1, 17, 1);
+        MatRotate(m, 45, 0, 1, 0);
+        MatTranslate(m, 0, i, 0);
+        floorNodes[i] = SceneAddNode(houseGraph, -1, m);
+        AddBounds(floorNodes[i], MakeVec3(0, 0.5f, 0), sqrtf(17 * 17 + 0.25f)); // Square prism of radius 17
+        houseBounds.back().isOccluder = true;
+    }
+
+    // ROOF, moved on top of the walls by PlaceRoof()
+    roofNode = SceneAddNode(houseGraph, -1, MatIdentity());
+    AddBounds(roofNode, MakeVec3(0, 0.5f, 0), sqrtf(17 * 17 + 0.25f));
+    houseBounds.back().isOccluder = true;
+    PlaceRoof(1);
+}
+
+void PlaceRoof(int floors) {
+    SceneSetLocal(houseGraph, roofNode, RoofMatrix(floors));
+    roofFloors = floors;
+}
+
+Matrix4 RoofMatrix(int floors) {
+    Matrix4 m = MatIdentity();
+    MatRotate(m, 45, 0, 1, 0);
+    MatTranslate(m, 0, 17 * floors, 0);
+    MatScale(m, 1, 7, 1);
+    return m;
+}
+
+// The FLOORS slider's value as a floor count, 1 to MAX_FLOORS
+int FloorCount(int numFloors) {
+    int floors = ((numFloors + 61) / 30) + 1;
+    return floors > MAX_FLOORS ? MAX_FLOORS : floors;
+}
 
-    glDisable(GL_TEXTURE_2D);
+void DrawHouse() {
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+
+    // HOUSE WALLS, every floor in one cached mesh placed by the first floor's node
+    bool wallsVisible = false;
+    for (int i = 0; i < roofFloors; i++) wallsVisible = wallsVisible || IsNodeVisible(floorNodes[i]);
+    if (wallsVisible) {
+        DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_TEXTURE, 1, NodeCenter(floorNodes[0]), DrawWalls);
+        DrawPacketColor(packet, 1, 0.75, 0.45);
+        DrawPacketWorld(packet, world[floorNodes[0]]);
+    }
 
     // ROOF
-    glColor3d((roofColorOffset+60)/120.0, cos((roofColorOffset+60)/120.0), fabs(sin(roofColorOffset+60/120.0)));
-    glPushMatrix();
-    glRotated(45, 0, 1, 0);
-    glTranslated(0, 17* temp, 0);
-    glScaled(1, 7, 1);
-    DrawCylinder1(4, 0, 17);
-    glPopMatrix();
+    if (!IsNodeVisible(roofNode)) return;
+    DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, NodeCenter(roofNode), DrawPrism);
+    DrawPacketColor(packet, (frame.roofColorOffset+60)/120.0, cos((frame.roofColorOffset+60)/120.0), fabs(sin(frame.roofColorOffset+60/120.0)));
+    if (pickedKind == PICK_HOUSE) DrawPacketColor(packet, PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2]);
+    DrawPacketWorld(packet, world[roofNode]);
+    packet.params[0] = 4;
+    packet.params[1] = 0;
+    packet.params[2] = 17;
 }
 
-void DrawCylinder1(int num_sides, double topr, double bottomr)
-{
-    double alpha, teta = 2 * PI / num_sides;
-    int temp = ((numWindows + 60) / 30) + 1;
+void DrawWalls(const DrawPacket&) {
+    if (walls) PackedMeshDraw(walls->mesh);
+}
 
-    for (alpha = 0; alpha <= 2 * PI; alpha += teta)
-    {
-        glBegin(GL_POLYGON);
-        glTexCoord2d(0,0); glVertex3d(topr * sin(alpha), 1, topr * cos(alpha));// 1-st vertex
-        glTexCoord2d(temp,0); glVertex3d(topr * sin(alpha + teta), 1, topr * cos(alpha + teta));// 2-nd vertex
-        glTexCoord2d(temp, 1); glVertex3d(bottomr*sin(alpha + teta), 0, bottomr* cos(alpha + teta));// 3-d vertex
-        glTexCoord2d(0, 1); glVertex3d(bottomr * sin(alpha), 0, bottomr * cos(alpha));// 4-th vertex
-        glEnd();
+unsigned WallMeshKey(int floors, int windowRepeat) {
+    return (unsigned)floors << 16 | (unsigned short)windowRepeat;
+}
+
+// Runs on a worker. Floor i is floor 0's prism moved up by i in floor 0's
+// space, the same place its own node puts it. The scratch buffers belong to
+// the worker and, like the cache slot's mesh, are sized for the tallest
+// walls the first time, so later rebuilds do not touch the heap.
+void BuildWallMesh(unsigned key, PackedMesh& mesh) {
+    int floors = key >> 16;
+    float windowRepeat = (short)(key & 0xFFFF);
+    PrimitiveVertex quads[4 * 4];
+    int count = PrimitivePrismVertices(4, 17, 17, windowRepeat, quads);
+    int maxVertices = (MAX_FLOORS > CITY_MAX_FLOORS ? MAX_FLOORS : CITY_MAX_FLOORS) * count;
+
+    static thread_local std::vector<Vec3> positions;
+    static thread_local std::vector<float> uvs;
+    static thread_local std::vector<unsigned> indices;
+    positions.clear();
+    uvs.clear();
+    indices.clear();
+    positions.reserve(maxVertices);
+    uvs.reserve(maxVertices * 2);
+    indices.reserve(maxVertices / 4 * 6);
+    mesh.vertices.reserve(maxVertices);
+    mesh.indices.reserve(maxVertices / 4 * 6);
+    for (int floor = 0; floor < floors; floor++) {
+        for (int i = 0; i < count; i += 4) {
+            unsigned first = (unsigned)positions.size();
+            for (int k = 0; k < 4; k++) {
+                const PrimitiveVertex& v = quads[i + k];
+                positions.push_back(MakeVec3(v.x, v.y + floor, v.z));
+                uvs.push_back(v.u);
+                uvs.push_back(v.v);
+            }
+            unsigned quad[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
     }
+    PackMesh(mesh, positions.data(), 0, uvs.data(), (int)positions.size(), indices.data(), (int)indices.size());
+}
+
+// DrawCylinder1 as a packet: sides, top and bottom radius in params
+void DrawPrism(const DrawPacket& packet) {
+    DrawCylinder1((int)packet.params[0], packet.params[1], packet.params[2]);
+}
+
+// Sides from the compile-time circle tables; the windows slider sets the texture repeat
+void DrawCylinder1(int num_sides, double topr, double bottomr)
+{
+    int temp = ((frame.numWindows + 60) / 30) + 1;
+    PrimitiveDrawPrism(num_sides, topr, bottomr, temp);
 }
 
 void DrawRoad()
 {
-    int i, j;
+    if (!roadVisible) return;
+    DrawQueueAdd(drawQueue, MATERIAL_TEXTURE, 3, (ROAD_BOUNDS.min + ROAD_BOUNDS.max) * 0.5f, DrawRoadGeometry);
+}
 
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 3);
-    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE); // can be GL_MODULATE
+void DrawRoadGeometry(const DrawPacket&)
+{
+    int i;
 
-    
     for (i = 1; i < GROUND_SIZE; i++)
     {
         if ( i > GROUND_SIZE / 2 + 10)
@@ -367,161 +882,692 @@ void DrawRoad()
             glEnd();
         }
     }
+}
 
-    glDisable(GL_TEXTURE_2D);
+void SetupSliders() {
+    UiInitPanel(sliderPanel, UiRect{ WINDOW_WIDTH / 2 + 150, 0, 150, WINDOW_HEIGHT }, 0.6, 0.6, 0.6);
+
+    const char* headings[] = { "ROOF", "FLOORS", "WINDOWS" };
+    int headingX[] = { 38, 30, 15 };
+
+    for (int i = 0; i < 3; i++) {
+        int top = 600 - 200 * i; // Each slider is 200 pixels below the previous one
+
+        UiSlider slider = {};
+        slider.label = headings[i];
+        slider.labelX = headingX[i];
+        slider.labelY = top - 100;
+        slider.box = UiRect{ 0, top - 200, 150, 50 };
+        slider.lineX0 = 15;             // Slider line
+        slider.lineX1 = 135;
+        slider.lineY = top - 175;
+        slider.knobX = 75;              // Indicator
+        slider.knobBottom = top - 183;
+        slider.knobMid = top - 172;
+        slider.knobTop = top - 163;
+        slider.knobHalfWidth = 6;
+        slider.minValue = -60;          // Drag range, the length of the line
+        slider.maxValue = 60;
+        UiAddSlider(sliderPanel, slider);
+    }
 }
 
-void DrawSliderControl(char* heading,double translated) {
-    
-    
-    for (int i = 0; i < strlen(heading); i++)
-        glutBitmapCharacter(GLUT_BITMAP_TIMES_ROMAN_24, heading[i]);
 
-    glColor3d(0.4, 0.4, 0.4);
-    glBegin(GL_POLYGON);
-    glVertex2d(0, 450);   // top-left x and y
-    glVertex2d(150, 450);  // top-right x and y
-    glVertex2d(150, 400);   // bottom-right x and y
-    glVertex2d(0, 400);   // bottom-left x and y
-    glEnd();
+// Builds the fence nodes once; group nodes mirror the matrix stack nesting
+void BuildFence() {
+    Matrix4 m = MatIdentity();
+    MatTranslate(m, 0, 2, 0);
+    int fence = SceneAddNode(houseGraph, -1, m);
+
+    // Front walls, left and right of the gate
+    double frontX[] = { -1.25, 0.25 };
+    for (int i = 0; i < 2; i++) {
+        m = MatIdentity();
+        MatScale(m, 20, 0.5, 10);
+        MatTranslate(m, frontX[i], 1, 2);
+        AddFenceWall(fence, m);
+    }
+
+    // Side walls and back wall
+    double sideAngle[] = { 90, 90, 0 };
+    double sideX[] = { 5, 5, 0 };
+    double sideZ[] = { 5, -45, -50 };
+    for (int i = 0; i < 3; i++) {
+        m = MatIdentity();
+        MatRotate(m, sideAngle[i], 0, 1, 0);
+        MatTranslate(m, sideX[i], 0, sideZ[i]);
+        int side = SceneAddNode(houseGraph, fence, m);
+
+        m = MatIdentity();
+        MatScale(m, 50, 0.5, 10);
+        MatTranslate(m, -0.5, 1, 2);
+        AddFenceWall(side, m);
+    }
+
+    // Posts
+    double postX[] = { -5, 5, 25, -25, -25, 25 };
+    double postZ[] = { 20, 20, 18, 18, -28, -30 };
+    double postHeight[] = { 10, 10, 7, 7, 7, 7 };
+    for (int i = 0; i < 6; i++) {
+        m = MatIdentity();
+        MatTranslate(m, postX[i], 0, postZ[i]);
+        MatScale(m, 1, postHeight[i], 1);
+        fencePostNodes.push_back(SceneAddNode(houseGraph, -1, m));
+        AddBounds(fencePostNodes.back(), MakeVec3(0, 0.5f, 0), sqrtf(0.7f * 0.7f + 0.25f));
+    }
+}
+
+// A wall is a lower rail plus an upper rail 2 units above it
+void AddFenceWall(int parent, const Matrix4& local) {
+    int wall = SceneAddNode(houseGraph, parent, local);
+    fenceWallNodes.push_back(wall);
+
+    Matrix4 m = MatIdentity();
+    MatTranslate(m, 0, 2, 0);
+    fenceWallNodes.push_back(SceneAddNode(houseGraph, wall, m));
+
+    // Both rails are the unit quad
+    AddBounds(wall, MakeVec3(0.5f, 0.5f, 0), sqrtf(0.5f));
+    AddBounds(fenceWallNodes.back(), MakeVec3(0.5f, 0.5f, 0), sqrtf(0.5f));
+}
+
+// Records the fence, placed by the flat array of cached world matrices
+void DrawFence() {
+    if (gpuFence) return; // Culled and drawn on the GPU after the queue
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+
+    for (size_t i = 0; i < fenceWallNodes.size(); i++) {
+        if (!IsNodeVisible(fenceWallNodes[i])) continue;
+        DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, NodeCenter(fenceWallNodes[i]), DrawFenceWall);
+        DrawPacketColor(packet, 0.55, 0.47, 0.40);
+        if (IsPicked(PICK_FENCE_WALL, fenceWallNodes[i]))
+            DrawPacketColor(packet, PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2]);
+        DrawPacketWorld(packet, world[fenceWallNodes[i]]);
+    }
+
+    for (size_t i = 0; i < fencePostNodes.size(); i++) {
+        if (!IsNodeVisible(fencePostNodes[i])) continue;
+        DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, NodeCenter(fencePostNodes[i]), DrawPrism);
+        DrawPacketColor(packet, 0.55, 0.47, 0.40);
+        if (IsPicked(PICK_FENCE_POST, fencePostNodes[i]))
+            DrawPacketColor(packet, PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2]);
+        DrawPacketWorld(packet, world[fencePostNodes[i]]);
+        packet.params[0] = 7;
+        packet.params[1] = 0.7;
+        packet.params[2] = 0.7;
+    }
+}
+
+// --- Culling ---
+// Local bounding sphere of a drawn node, added when the node is built
+void AddBounds(int node, const Vec3& center, float radius) {
+    NodeBounds bounds = { node, center, radius, false };
+    if ((int)nodeCullIndex.size() <= node) nodeCullIndex.resize(node + 1, -1);
+    nodeCullIndex[node] = CullSetAdd(houseCull);
+    houseBounds.push_back(bounds);
+}
+
+// World spheres follow only the nodes moved by the last SceneUpdate
+void UpdateBounds() {
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+
+    for (size_t i = 0; i < houseBounds.size(); i++) {
+        const NodeBounds& b = houseBounds[i];
+        if (!houseGraph.changed[b.node]) continue;
+
+        Vec3 center;
+        float radius;
+        TransformSphere(world[b.node], b.center, b.radius, &center, &radius);
+        CullSetSphere(houseCull, (int)i, center, radius);
+        if (!houseBvh.nodes.empty()) BvhMove(houseBvh, (int)i, SphereAabb(center, radius));
+    }
+    BvhRefit(houseBvh);
+}
+
+void BuildHouseBvh() {
+    std::vector<Aabb> bounds(houseBounds.size());
+    for (size_t i = 0; i < bounds.size(); i++)
+        bounds[i] = SphereAabb(MakeVec3(houseCull.x[i], houseCull.y[i], houseCull.z[i]), houseCull.radius[i]);
+    BvhBuild(houseBvh, bounds.data(), (int)bounds.size());
+}
+
+// Brings the scene graph up to date and tests everything against the view
+void CullScene() {
+    int floors = FloorCount(frame.numFloors);
+    int windowRepeat = ((frame.numWindows + 60) / 30) + 1; // As DrawCylinder1 computes it
+    walls = MeshCacheGet(wallMeshes, WallMeshKey(floors, windowRepeat));
+    floors = walls->key >> 16; // The roof follows the walls being drawn, which may lag the slider
+
+    if (floors != roofFloors) { // Only the roof node changes with the floor count
+        PlaceRoof(floors);
+        SceneUpdate(houseGraph);
+        UpdateBounds();
+    }
+
+    Frustum frustum = FrustumFromMatrix(viewProjection);
+    int visible = CullSetRun(houseCull, frustum);
+
+    int chunks = 0;
+    for (int ci = 0; ci < GROUND_CHUNKS; ci++)
+        for (int cj = 0; cj < GROUND_CHUNKS; cj++) {
+            groundChunkVisible[ci][cj] = FrustumTestAabb(frustum, groundChunks[ci][cj]);
+            chunks += groundChunkVisible[ci][cj];
+        }
+
+    roadVisible = FrustumTestAabb(frustum, ROAD_BOUNDS);
+
+    int occluded = CullOccluded();
+    HudPrint("objects in view %d / %d", visible, (int)houseBounds.size());
+    HudPrint("terrain chunks %d / %d", chunks, GROUND_CHUNKS * GROUND_CHUNKS);
+    HudPrint("occluded %d", occluded); // Objects and chunks in view but hidden by the house
+}
 
-    // Slider line
-    glColor3d(0, 0, 0);
-    glLineWidth(2);
-    glBegin(GL_LINES);
-    glVertex2d(15, 425);
-    glVertex2d(135, 425);
+// Side faces of a 4-sided DrawCylinder1 prism, indexed by PRISM_INDICES
+void BuildPrismOccluder(Vec3* vertices, double topr, double bottomr) {
+    const UnitCircle<4>& circle = CircleTable<4>::value;
+    for (int k = 0; k < 4; k++) {
+        vertices[k] = MakeVec3((float)topr * circle.sin[k], 1, (float)topr * circle.cos[k]);
+        vertices[k + 4] = MakeVec3((float)bottomr * circle.sin[k], 0, (float)bottomr * circle.cos[k]);
+    }
+}
+
+// Rasterizes the visible house prisms, then rejects whatever they hide.
+// Runs after the frustum test and updates the same visibility flags.
+int CullOccluded() {
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+    const int numIndices = sizeof(PRISM_INDICES) / sizeof(PRISM_INDICES[0]);
+
+    OcclusionBegin(occlusion, viewProjection);
+    for (int i = 0; i < roofFloors; i++)
+        if (IsNodeVisible(floorNodes[i]))
+            OcclusionRasterize(occlusion, world[floorNodes[i]], wallOccluder, PRISM_INDICES, numIndices);
+    if (IsNodeVisible(roofNode))
+        OcclusionRasterize(occlusion, world[roofNode], roofOccluder, PRISM_INDICES, numIndices);
+    OcclusionBuildPyramid(occlusion);
+
+    int occluded = 0;
+    for (size_t i = 0; i < houseBounds.size(); i++) {
+        if (!houseCull.visible[i] || houseBounds[i].isOccluder) continue;
+        if (!OcclusionTestSphere(occlusion, MakeVec3(houseCull.x[i], houseCull.y[i], houseCull.z[i]), houseCull.radius[i])) {
+            houseCull.visible[i] = 0;
+            occluded++;
+        }
+    }
+
+    for (int ci = 0; ci < GROUND_CHUNKS; ci++)
+        for (int cj = 0; cj < GROUND_CHUNKS; cj++)
+            if (groundChunkVisible[ci][cj] && !OcclusionTestAabb(occlusion, groundChunks[ci][cj])) {
+                groundChunkVisible[ci][cj] = false;
+                occluded++;
+            }
+
+    if (roadVisible && !OcclusionTestAabb(occlusion, ROAD_BOUNDS)) {
+        roadVisible = false;
+        occluded++;
+    }
+    return occluded;
+}
+
+bool IsNodeVisible(int node) {
+    return houseCull.visible[nodeCullIndex[node]] != 0;
+}
+
+// World bounding sphere center, used as the node's depth for sorting
+Vec3 NodeCenter(int node) {
+    int i = nodeCullIndex[node];
+    return MakeVec3(houseCull.x[i], houseCull.y[i], houseCull.z[i]);
+}
+
+// --- Procedural city (--city N) ---
+// Houses and owls around the house, see city.h. Every house variant and the
+// owl's part meshes are built once; instances only differ by world matrix.
+void BuildCity(int count) {
+    if (!cityMeshesBuilt) {
+        OwlModelBuild(cityOwl);
+        OwlModelBuildMeshes(cityOwl);
+        BuildWallVariants();
+        cityMeshesBuilt = true;
+    }
+    CityGenerate(city, cityOwl, count, CITY_SEED, CITY_CLEAR);
+
+    std::vector<Aabb> bounds(city.cull.x.size());
+    for (size_t i = 0; i < bounds.size(); i++)
+        bounds[i] = SphereAabb(MakeVec3(city.cull.x[i], city.cull.y[i], city.cull.z[i]), city.cull.radius[i]);
+    BvhBuild(cityBvh, bounds.data(), (int)bounds.size());
+    cityMode = true;
+}
+
+void BuildWallVariants() {
+    if (wallVariantsBuilt) return;
+    for (int floors = 1; floors <= CITY_MAX_FLOORS; floors++)
+        for (int repeat = 1; repeat <= CITY_WINDOW_REPEATS; repeat++)
+            BuildWallMesh(WallMeshKey(floors, repeat), wallVariants[floors - 1][repeat - 1]);
+    wallVariantsBuilt = true;
+}
+
+// Only the BVH nodes near the view are visited, however large the city
+void CullCity() {
+    Frustum frustum = FrustumFromMatrix(viewProjection);
+    cityVisible.clear();
+    BvhQueryFrustum(cityBvh, frustum, cityVisible);
+    cityRoadsVisible.clear();
+    for (size_t i = 0; i < city.roads.size(); i++)
+        if (FrustumTestAabb(frustum, city.roads[i])) cityRoadsVisible.push_back((int)i);
+}
+
+void DrawCity() {
+    DrawPacket& ground = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, MakeVec3(0, 0, 0), DrawCityGround);
+    DrawPacketColor(ground, 0.18, 0.42, 0.26);
+
+    for (size_t i = 0; i < cityRoadsVisible.size(); i++) {
+        const Aabb& road = city.roads[cityRoadsVisible[i]];
+        DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_TEXTURE, 3, (road.min + road.max) * 0.5f, DrawCityRoad);
+        packet.params[0] = cityRoadsVisible[i];
+    }
+
+    // Houses come first in the cull set, then owls
+    const Matrix4* partWorld = SceneWorldMatrices(cityOwl.graph);
+    int numHouses = (int)city.houses.size();
+    cityHousesDrawn = cityOwlsDrawn = 0;
+    for (size_t v = 0; v < cityVisible.size(); v++) {
+        int i = cityVisible[v];
+        Vec3 center = MakeVec3(city.cull.x[i], city.cull.y[i], city.cull.z[i]);
+
+        if (i < numHouses) {
+            const CityHouse& house = city.houses[i];
+            DrawPacket& walls = DrawQueueAdd(drawQueue, MATERIAL_TEXTURE, 1, center, DrawCityWalls);
+            DrawPacketWorld(walls, house.world);
+            walls.params[0] = house.floors - 1;
+            walls.params[1] = house.windowRepeat - 1;
+
+            DrawPacket& roof = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, center, DrawPrism);
+            DrawPacketColor(roof, house.roofColor[0], house.roofColor[1], house.roofColor[2]);
+            if (IsPicked(PICK_CITY_HOUSE, i)) DrawPacketColor(roof, PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2]);
+            DrawPacketWorld(roof, house.roofWorld);
+            roof.params[0] = 4;
+            roof.params[1] = 0;
+            roof.params[2] = 17;
+            cityHousesDrawn++;
+            continue;
+        }
+
+        const CityOwl& owl = city.owls[i - numHouses];
+        bool owlPicked = IsPicked(PICK_CITY_OWL, i - numHouses);
+        for (int p = 0; p < cityOwl.numParts; p++) {
+            const OwlPart& part = cityOwl.parts[p];
+            DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, center, DrawCityOwlPart);
+            DrawPacketColor(packet, part.color[0], part.color[1], part.color[2]);
+            if (owlPicked) DrawPacketColor(packet, PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2]);
+            DrawPacketWorld(packet, MatMultiply(owl.world, partWorld[part.node]));
+            packet.params[0] = p;
+        }
+        cityOwlsDrawn++;
+    }
+}
+
+// Flat ground out to the city's edge, around the house's terrain
+void DrawCityGround(const DrawPacket&) {
+    float inner = GROUND_SIZE / 2.0f, outer = city.size;
+    float x[4][2] = { { -outer, outer }, { -outer, outer }, { -outer, -inner }, { inner, outer } };
+    float z[4][2] = { { -outer, -inner }, { inner, outer }, { -inner, inner }, { -inner, inner } };
+
+    glNormal3f(0, 1, 0);
+    glBegin(GL_QUADS);
+    for (int i = 0; i < 4; i++) {
+        glVertex3f(x[i][0], 0, z[i][1]);
+        glVertex3f(x[i][1], 0, z[i][1]);
+        glVertex3f(x[i][1], 0, z[i][0]);
+        glVertex3f(x[i][0], 0, z[i][0]);
+    }
     glEnd();
+}
 
-    // Indicator
-    glPushMatrix();
-    glColor3d(1, 0, 0);
-    glTranslated(translated, 0, 0);
-    glBegin(GL_POLYGON);
-    glVertex2d(75,437); // top point
-    glVertex2d(81,428); // right mid point
-    glVertex2d(81,417); // bottom right point
-    glVertex2d(69,417); // bottom left point
-    glVertex2d(69,428); // left mid point
+// The road texture runs across the strip once and repeats every unit along it
+void DrawCityRoad(const DrawPacket& packet) {
+    const Aabb& road = city.roads[(int)packet.params[0]];
+    bool alongZ = road.max.z - road.min.z > road.max.x - road.min.x;
+    float length = alongZ ? road.max.z - road.min.z : road.max.x - road.min.x;
+
+    glBegin(GL_QUADS);
+    if (alongZ) {
+        glTexCoord2f(1, 0);      glVertex3f(road.min.x, road.min.y, road.min.z);
+        glTexCoord2f(1, length); glVertex3f(road.min.x, road.min.y, road.max.z);
+        glTexCoord2f(0, length); glVertex3f(road.max.x, road.min.y, road.max.z);
+        glTexCoord2f(0, 0);      glVertex3f(road.max.x, road.min.y, road.min.z);
+    }
+    else {
+        glTexCoord2f(0, 0);      glVertex3f(road.min.x, road.min.y, road.min.z);
+        glTexCoord2f(1, 0);      glVertex3f(road.min.x, road.min.y, road.max.z);
+        glTexCoord2f(1, length); glVertex3f(road.max.x, road.min.y, road.max.z);
+        glTexCoord2f(0, length); glVertex3f(road.max.x, road.min.y, road.min.z);
+    }
     glEnd();
-    glPopMatrix();
+}
 
+void DrawCityWalls(const DrawPacket& packet) {
+    PackedMeshDraw(wallVariants[(int)packet.params[0]][(int)packet.params[1]]);
 }
 
+void DrawCityOwlPart(const DrawPacket& packet) {
+    PackedMeshDraw(cityOwl.meshes[(int)packet.params[0]]);
+}
 
-void DrawFence() {
+// --- Camera collision ---
+// Colliders for the house at every floor count, the fence and the city,
+// placed like the objects they stand for. The house's walls are one prism
+// per floor count, stretched over all its floors.
+void BuildCollision() {
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+    CollisionMeshPrism(wallCollisionMesh, 4, 17, 17);
+    CollisionMeshPrism(roofCollisionMesh, 4, 0, 17);
+    CollisionMeshPrism(postCollisionMesh, 7, 0.7f, 0.7f);
+    CollisionMeshQuad(fenceCollisionMesh);
+
+    for (int floors = 1; floors <= MAX_FLOORS; floors++) {
+        Matrix4 walls = world[floorNodes[0]];
+        MatScale(walls, 1, floors, 1);
+        wallColliders[floors - 1] = CollisionAdd(collision, wallCollisionMesh, walls);
+        roofColliders[floors - 1] = CollisionAdd(collision, roofCollisionMesh, RoofMatrix(floors));
+    }
+    for (size_t i = 0; i < fenceWallNodes.size(); i++)
+        CollisionAdd(collision, fenceCollisionMesh, world[fenceWallNodes[i]]);
+    for (size_t i = 0; i < fencePostNodes.size(); i++)
+        CollisionAdd(collision, postCollisionMesh, world[fencePostNodes[i]]);
+
+    if (cityMode) {
+        const Matrix4* partWorld = SceneWorldMatrices(cityOwl.graph);
+        for (int p = 0; p < cityOwl.numParts; p++) // All parts in the owl's own space
+            CollisionMeshAddPacked(owlCollisionMesh, cityOwl.meshes[p], partWorld[cityOwl.parts[p].node]);
+        for (size_t i = 0; i < city.houses.size(); i++) {
+            Matrix4 walls = city.houses[i].world;
+            MatScale(walls, 1, city.houses[i].floors, 1);
+            CollisionAdd(collision, wallCollisionMesh, walls);
+            CollisionAdd(collision, roofCollisionMesh, city.houses[i].roofWorld);
+        }
+        for (size_t i = 0; i < city.owls.size(); i++) CollisionAdd(collision, owlCollisionMesh, city.owls[i].world);
+    }
+
+    CollisionBuild(collision);
+    collisionFloors = 0;
+    SetCollisionFloors(1);
+}
+
+// Runs on the simulation thread, which owns the slider the floor count comes from
+void SetCollisionFloors(int floors) {
+    if (floors == collisionFloors) return;
+    for (int i = 0; i < MAX_FLOORS; i++) {
+        collision.colliders[wallColliders[i]].enabled = i == floors - 1;
+        collision.colliders[roofColliders[i]].enabled = i == floors - 1;
+    }
+    collisionFloors = floors;
+}
+
+// Bilinear over the height map, which is drawn with cell (i, j) at (j - GROUND_SIZE / 2, i - GROUND_SIZE / 2);
+// the city's flat ground around it is at 0
+float TerrainHeight(float x, float z) {
+    float fx = x + GROUND_SIZE / 2, fz = z + GROUND_SIZE / 2;
+    int j = (int)floorf(fx), i = (int)floorf(fz);
+    if (i < 0 || j < 0 || i >= GROUND_SIZE - 1 || j >= GROUND_SIZE - 1) return 0;
+    float u = fx - j, v = fz - i;
+    double nearRow = ground[i][j] * (1 - u) + ground[i][j + 1] * u;
+    double farRow = ground[i + 1][j] * (1 - u) + ground[i + 1][j + 1] * u;
+    return (float)(nearRow * (1 - v) + farRow * v);
+}
+
+// --- Path tracer ---
+// Everything DrawHouse, DrawFence, DrawRoad and DrawFloor draw, at the
+// frame's slider values, as triangles for the path tracer. The city is left
+// out: it would be millions of triangles without instancing.
+void BuildPathScene() {
+    if (pathBricks < 0) BuildPathBase();
+    int floors = FloorCount(frame.numFloors);
+    int windowRepeat = ((frame.numWindows + 60) / 30) + 1; // As DrawCylinder1 computes it
+    BuildWallMesh(WallMeshKey(floors, windowRepeat), pathWalls);
+
+    pathScene = pathBase;
+    AddPathHouse(pathScene, floors, windowRepeat, frame.roofColorOffset, pathWalls);
+    PtSceneBuild(pathScene);
+    pathFrame = frame;
+    pathSceneBuilt = true;
+}
+
+// Fence, road and terrain, which no slider changes, and the textures
+void BuildPathBase() {
+    PtSceneBegin(pathBase, PATH_SKY, PATH_SUN_DIRECTION, PATH_SUN);
+    pathBricks = PtSceneAddTexture(pathBase, textures[0].level[0], textures[0].width, textures[0].height);
+    int asphalt = PtSceneAddTexture(pathBase, textures[2].level[0], textures[2].width, textures[2].height);
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+    PrimitiveVertex quads[MAX_PRIMITIVE_SIDES * 4];
+
+    // Fence
+    int fence = PtSceneAddMaterial(pathBase, 0.55, 0.47, 0.40, -1);
+    const PrimitiveVertex rail[4] = { { 0, 0, 0, 0, 0 }, { 0, 1, 0, 1, 0 }, { 1, 1, 1, 1, 0 }, { 1, 0, 1, 0, 0 } };
+    for (size_t i = 0; i < fenceWallNodes.size(); i++)
+        PtSceneAddQuads(pathBase, world[fenceWallNodes[i]], rail, 4, fence);
+    int count = PrimitivePrismVertices(7, 0.7f, 0.7f, 1, quads); // Untextured, so any repeat
+    for (size_t i = 0; i < fencePostNodes.size(); i++)
+        PtSceneAddQuads(pathBase, world[fencePostNodes[i]], quads, count, fence);
+
+    // Road, the strips DrawRoadGeometry draws
+    int road = PtSceneAddMaterial(pathBase, 1, 1, 1, asphalt);
+    for (int i = GROUND_SIZE / 2 + 11; i < GROUND_SIZE; i++) {
+        float z = i - GROUND_SIZE / 2.0f;
+        const PrimitiveVertex strip[4] = { { 1, 0, -4, 0.1f, z - 1 }, { 0, 0, -4, 0.1f, z }, { 0, 1, 4, 0.1f, z },
+            { 1, 1, 4, 0.1f, z - 1 } };
+        PtSceneAddQuads(pathBase, MatIdentity(), strip, 4, road);
+    }
+
+    // Terrain
+    int grass = PtSceneAddMaterial(pathBase, 0.18, 0.42, 0.26, -1);
+    for (int ci = 0; ci < GROUND_CHUNKS; ci++)
+        for (int cj = 0; cj < GROUND_CHUNKS; cj++)
+            PtSceneAddMesh(pathBase, MatIdentity(), groundMeshes[ci][cj], grass, true);
+}
+
+// Walls and roof, on top of a copy of pathBase. Only reads shared state, so
+// --batch runs it on a worker.
+void AddPathHouse(PtScene& scene, int floors, int windowRepeat, double roofColorOffset, const PackedMesh& walls) {
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+    PtSceneAddMesh(scene, world[floorNodes[0]], walls, PtSceneAddMaterial(scene, 1, 1, 1, pathBricks), false);
+    int roof = PtSceneAddMaterial(scene, (roofColorOffset+60)/120.0, cos((roofColorOffset+60)/120.0),
+        fabs(sin(roofColorOffset+60/120.0)), -1);
+    PrimitiveVertex quads[MAX_PRIMITIVE_SIDES * 4];
+    int count = PrimitivePrismVertices(4, 0, 17, windowRepeat, quads);
+    PtSceneAddQuads(scene, RoofMatrix(floors), quads, count, roof);
+}
+
+// One more pass per frame while the view and sliders stay put; any change starts over
+void DrawPathTraced() {
+    bool sceneChanged = !pathSceneBuilt || FloorCount(frame.numFloors) != FloorCount(pathFrame.numFloors) ||
+        frame.numWindows != pathFrame.numWindows || frame.roofColorOffset != pathFrame.roofColorOffset;
+    if (sceneChanged) BuildPathScene();
+    if (sceneChanged || memcmp(viewProjection.m, pathView.m, sizeof(pathView.m)) != 0) {
+        PtRenderReset(pathRender, WINDOW_WIDTH, WINDOW_HEIGHT, viewProjection, frame.eye);
+        pathView = viewProjection;
+    }
+    PtRenderPass(pathRender, pathScene);
+
+    glWindowPos2i(0, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glDrawPixels(pathRender.width, pathRender.height, GL_RGB, GL_UNSIGNED_BYTE, pathRender.pixels.data());
+    HudPrint("path tracer (F3)  %d triangles  %d samples/pixel", (int)pathScene.triangles.size(), pathRender.samples);
+    HudPrint("%.2f M samples/s  %.2f M rays/s  %.0f ms/pass", pathRender.samplesPerSecond / 1e6,
+        pathRender.raysPerSecond / 1e6, pathRender.passMilliseconds);
+}
+
+// --- Poster (F4, --poster FILE W [H]) ---
+// The rasterized view at any size, tile by tile (see poster.h), from the
+// camera in view. Each tile gets its own projection and is culled and drawn
+// as DrawScene() does, all within the one frame. The band buffers and writer
+// thread are the poster's own, so that frame is not held to the arena's
+// steady-state check.
+bool RenderPoster(const char* path, int width, int height) {
+    postersDone = frame.posters;
+    FrameArenaSkipCheck();
+    posterWritten = width > 0 && height > 0 &&
+        PosterRender(path, width, height, VIEW_FRUSTUM, DrawPosterTile, 0, &posterStats);
+    if (posterWritten)
+        printf("Poster %s: %d x %d, %d tiles in %d bands, %.1f s, %.1f MB of band buffers\n", path, width, height,
+            posterStats.tiles, posterStats.bands, posterStats.seconds, posterStats.peakBytes / 1048576.0);
+    else
+        printf("Poster %s: %d x %d could not be rendered or written\n", path, width, height);
+    return posterWritten;
+}
+
+void DrawPosterTile(const Matrix4& tileProjection, void*) {
+    projection = tileProjection;
+    viewProjection = MatMultiply(projection, view);
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(projection.m);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(view.m);
+    DrawScene();
+}
+
+// --- Picking ---
+// The click's ray is run through the house BVH and, in city mode, the city
+// BVH; only objects whose box the ray enters are tested against the
+// triangles they are drawn with. Clicking empty space clears the selection.
+void PickScene() {
+    picksDone = frame.picks;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PickRay ray = PickRayFromWindow(viewProjection, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, frame.pickX, frame.pickY);
+
+    float t, cityT;
+    int object = BvhRaycast(houseBvh, ray.origin, ray.direction, PICK_DISTANCE, PickHouseObject, 0, &t);
+    pickedKind = object >= 0 ? HouseNodeKind(houseBounds[object].node) : PICK_NONE;
+    picked = object >= 0 ? houseBounds[object].node : -1;
+
+    if (cityMode) { // Only closer than what the house BVH hit
+        object = BvhRaycast(cityBvh, ray.origin, ray.direction, t, PickCityObject, 0, &cityT);
+        int numHouses = (int)city.houses.size();
+        if (object >= 0) {
+            pickedKind = object < numHouses ? PICK_CITY_HOUSE : PICK_CITY_OWL;
+            picked = object < numHouses ? object : object - numHouses;
+        }
+    }
+    UpdateGpuFencePick();
+    pickMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+PickKind HouseNodeKind(int node) {
+    if (node == roofNode) return PICK_HOUSE;
+    for (int i = 0; i < MAX_FLOORS; i++)
+        if (node == floorNodes[i]) return PICK_HOUSE;
+    for (size_t i = 0; i < fencePostNodes.size(); i++)
+        if (node == fencePostNodes[i]) return PICK_FENCE_POST;
+    return PICK_FENCE_WALL;
+}
+
+bool PickHouseObject(void*, int object, const Vec3& origin, const Vec3& direction, float* t) {
+    PickRay ray = { origin, direction };
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+    int node = houseBounds[object].node;
+    PrimitiveVertex quads[7 * 4];
+
+    switch (HouseNodeKind(node)) {
+    case PICK_HOUSE:
+        if (node == roofNode) return PickQuads(ray, world[node], quads, PrimitivePrismVertices(4, 0, 17, 1, quads), t);
+        for (int i = 0; i < roofFloors; i++) // Every floor is in the walls mesh, placed by the first floor
+            if (node == floorNodes[i]) return walls && PickMesh(ray, world[floorNodes[0]], walls->mesh, t);
+        return false; // A floor above the current count
+    case PICK_FENCE_POST:
+        return PickQuads(ray, world[node], quads, PrimitivePrismVertices(7, 0.7f, 0.7f, 1, quads), t);
+    default: { // The unit quad DrawFenceWall draws
+        Matrix4 m = world[node];
+        Vec3 a = MatTransformPoint(m, MakeVec3(0, 0, 0)), b = MatTransformPoint(m, MakeVec3(0, 1, 0));
+        Vec3 c = MatTransformPoint(m, MakeVec3(1, 1, 0)), d = MatTransformPoint(m, MakeVec3(1, 0, 0));
+        bool hit = PickTriangle(ray, a, b, c, t);
+        return PickTriangle(ray, a, c, d, t) || hit;
+    }
+    }
+}
 
-    glColor3d(0.55, 0.47, 0.40);
-
-    glPushMatrix();
-    glTranslated(0, 2, 0);
-    glPushMatrix();
-    glScaled(20, 0.5, 10);
-    glTranslated(-1.25, 1, 2);
-    DrawFenceWall();
-    glPushMatrix();
-    glTranslated(0, 2, 0);
-    DrawFenceWall();
-    glPopMatrix();
-    glPopMatrix();
-
-
-    glPushMatrix();
-    glScaled(20, 0.5, 10);
-    glTranslated(0.25, 1, 2);
-    DrawFenceWall();
-    glPushMatrix();
-    glTranslated(0, 2, 0);
-    DrawFenceWall();
-    glPopMatrix();
-    glPopMatrix();
-
-    glPushMatrix();
-    glRotated(90,0,1,0);
-    glTranslated(5, 0, 5);
-    glPushMatrix();
-    glScaled(50, 0.5, 10);
-    glTranslated(-0.5, 1, 2);
-    DrawFenceWall();
-    glPushMatrix();
-    glTranslated(0, 2, 0);
-    DrawFenceWall();
-    glPopMatrix();
-    glPopMatrix();
-    glPopMatrix();
-
-    glPushMatrix();
-    glRotated(90, 0, 1, 0);
-    glTranslated(5, 0, -45);
-    glPushMatrix();
-    glScaled(50, 0.5, 10);
-    glTranslated(-0.5, 1, 2);
-    DrawFenceWall();
-    glPushMatrix();
-    glTranslated(0, 2, 0);
-    DrawFenceWall();
-    glPopMatrix();
-    glPopMatrix();
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(0, 0, -50);
-    glPushMatrix();
-    glScaled(50, 0.5, 10);
-    glTranslated(-0.5, 1, 2);
-    DrawFenceWall();
-    glPushMatrix();
-    glTranslated(0, 2, 0);
-    DrawFenceWall();
-    glPopMatrix();
-    glPopMatrix();
-    glPopMatrix();
-
-    glPopMatrix();
-
-
-
-
-    glPushMatrix();
-    glTranslated(-5,0,20);
-    glScaled(1, 10, 1);
-    DrawCylinder1(7, 0.7, 0.7);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(5, 0, 20);
-    glScaled(1, 10, 1);
-    DrawCylinder1(7, 0.7, 0.7);
-    glPopMatrix();
-
-
-    glPushMatrix();
-    glTranslated(25, 0, 18);
-    glScaled(1, 7, 1);
-    DrawCylinder1(7, 0.7, 0.7);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-25, 0, 18);
-    glScaled(1, 7, 1);
-    DrawCylinder1(7, 0.7, 0.7);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-25, 0, -28);
-    glScaled(1, 7, 1);
-    DrawCylinder1(7, 0.7, 0.7);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(25, 0, -30);
-    glScaled(1, 7, 1);
-    DrawCylinder1(7, 0.7, 0.7);
-    glPopMatrix();
-
-}
-
-void DrawFenceWall() {
+bool PickCityObject(void*, int object, const Vec3& origin, const Vec3& direction, float* t) {
+    PickRay ray = { origin, direction };
+    int numHouses = (int)city.houses.size();
+    if (object < numHouses) {
+        const CityHouse& house = city.houses[object];
+        PrimitiveVertex quads[4 * 4];
+        bool hit = PickMesh(ray, house.world, wallVariants[house.floors - 1][house.windowRepeat - 1], t);
+        return PickQuads(ray, house.roofWorld, quads, PrimitivePrismVertices(4, 0, 17, 1, quads), t) || hit;
+    }
+
+    const Matrix4* partWorld = SceneWorldMatrices(cityOwl.graph);
+    const CityOwl& owl = city.owls[object - numHouses];
+    bool hit = false;
+    for (int p = 0; p < cityOwl.numParts; p++) {
+        const OwlPart& part = cityOwl.parts[p];
+        Matrix4 world = MatMultiply(owl.world, partWorld[part.node]);
+        Vec3 center;
+        float radius;
+        TransformSphere(world, part.boundCenter, part.boundRadius, &center, &radius);
+        if (!PickSphere(ray, center, radius, *t)) continue; // Most parts are nowhere near the ray
+        hit = PickMesh(ray, world, cityOwl.meshes[p], t) || hit;
+    }
+    return hit;
+}
+
+bool IsPicked(PickKind kind, int index) {
+    return pickedKind == kind && picked == index;
+}
+
+// --- GPU-driven fence ---
+// The fence is static, so its rails and posts are uploaded once as objects
+// of a GpuScene. Occlusion culling stays on the CPU path only.
+void BuildGpuFence() {
+    if (!GpuSceneSupported()) return;
+    GpuSceneInit(fenceScene);
+
+    const float quad[] = { 0, 0, 0,  0, 1, 0,  1, 1, 0,  1, 0, 0 }; // DrawFenceWall
+    const unsigned quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+    int rail = GpuSceneAddMesh(fenceScene, quad, 4, quadIndices, 6);
+    int post = BuildPrismMesh(fenceScene, 7, 0.7f, 0.7f);
+
+    const Matrix4* world = SceneWorldMatrices(houseGraph);
+    for (size_t i = 0; i < fenceWallNodes.size(); i++)
+        GpuSceneAddObject(fenceScene, rail, world[fenceWallNodes[i]], 0.55f, 0.47f, 0.40f);
+    for (size_t i = 0; i < fencePostNodes.size(); i++)
+        GpuSceneAddObject(fenceScene, post, world[fencePostNodes[i]], 0.55f, 0.47f, 0.40f);
+    gpuFence = true;
+    UpdateGpuFencePick();
+}
+
+// The picked rail or post is highlighted in the object buffer, as DrawFence
+// does for its packets; the buffer is sent again only when a color changes
+void UpdateGpuFencePick() {
+    if (!gpuFence) return;
+    int numWalls = (int)fenceWallNodes.size();
+    for (int i = 0; i < (int)fenceScene.objects.size(); i++) {
+        bool wall = i < numWalls;
+        bool highlighted = wall ? IsPicked(PICK_FENCE_WALL, fenceWallNodes[i]) :
+            IsPicked(PICK_FENCE_POST, fencePostNodes[i - numWalls]);
+        if (highlighted) GpuSceneSetColor(fenceScene, i, PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2]);
+        else GpuSceneSetColor(fenceScene, i, 0.55f, 0.47f, 0.40f);
+    }
+}
+
+// Indexed triangles for the sides DrawCylinder1 draws, from y = 0 to 1
+int BuildPrismMesh(GpuScene& scene, int sides, float topr, float bottomr) {
+    PrimitiveVertex quads[MAX_PRIMITIVE_SIDES * 4];
+    PrimitivePrismVertices(sides, topr, bottomr, 1, quads);
+
+    std::vector<float> positions;
+    std::vector<unsigned> indices;
+    for (int i = 0; i < sides; i++) {
+        const PrimitiveVertex& top = quads[i * 4];        // First vertex of side i
+        const PrimitiveVertex& bottom = quads[i * 4 + 3]; // Last vertex of side i
+        float ring[] = { top.x, top.y, top.z, bottom.x, bottom.y, bottom.z };
+        positions.insert(positions.end(), ring, ring + 6);
+
+        unsigned t0 = i * 2, b0 = t0 + 1, t1 = (i + 1) % sides * 2, b1 = t1 + 1;
+        unsigned quad[] = { t0, t1, b1, t0, b1, b0 };
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+    return GpuSceneAddMesh(scene, positions.data(), sides * 2, indices.data(), (int)indices.size());
+}
+
+void DrawFenceWall(const DrawPacket&) {
     glBegin(GL_POLYGON);
     glVertex3d(0,0,0);
     glVertex3d(0,1,0);
@@ -531,23 +1577,37 @@ void DrawFenceWall() {
 }
 
 
-void setTexture(int texture) {
+void setTexture(int texture, TextureImage tx) {
 
     switch (texture) {
     case 1:
-        bricksTexture();
+        bricksTexture(tx);
         break;
     case 2:
-        windowsTexture();
+        bricksTexture(tx); // Windows are drawn over the bricks
         break;
     case 3:
-        roadTexture();
+        roadTexture(tx);
         break;
     }
 }
 
+// One job per texture, each filling its own image
+void GenerateTextures() {
+    static const int textures[3] = { 1, 2, 3 };
+    JobCounter remaining(0);
+
+    for (int i = 0; i < 3; i++) JobRun(JobCreate(GenerateTextureJob, (void*)&textures[i], &remaining));
+    JobWait(remaining);
+}
+
+void GenerateTextureJob(void* data) {
+    int texture = *(const int*)data;
+    setTexture(texture, textureImages[texture - 1]);
+}
+
 
-void bricksTexture() {
+void bricksTexture(TextureImage tx) {
 
     int firstThird = TH / 3;
     int secondThird = 2 * firstThird;
@@ -626,15 +1686,14 @@ void bricksTexture() {
             }
         }
     }
-    windowsTexture();
+    windowsTexture(tx);
 }
 
-void windowsTexture() {
+void windowsTexture(TextureImage tx) {
 
     int firstThird = TH / 3;
     int secondThird = 2 * firstThird;
-        
-    glBindTexture(GL_TEXTURE_2D, 2);
+
     for (int i = firstThird; i < secondThird; i++) {
         for (int j = 0; j < TW; j++) {
             if (j < TW / 3 || j > 2 * TW / 3) {
@@ -653,7 +1712,7 @@ void windowsTexture() {
 
 
 
-void roadTexture() {
+void roadTexture(TextureImage tx) {
     int i, j;
     int rnd;
     for (i = 0; i < TH; i++)
@@ -674,3 +1733,362 @@ void roadTexture() {
             }
         }
 }
+
+// --- Asset pack ---
+// Texture and terrain sizes, the height map and the generator revision. The
+// textures are random, so a pack keeps the ones it was baked with.
+unsigned HouseAssetKey() {
+    int sizes[5] = { TW, TH, GROUND_SIZE, GROUND_CHUNK, (int)sizeof(PackedVertex) };
+    unsigned key = AssetHash(ASSET_HASH_SEED, &HOUSE_ASSET_REVISION, sizeof(HOUSE_ASSET_REVISION));
+    key = AssetHash(key, sizes, sizeof(sizes));
+    return AssetHash(key, ground, sizeof(ground));
+}
+
+// Textures and terrain meshes stay in the mapped file; false leaves the pack closed
+bool LoadAssets() {
+    if (!AssetPackOpen(assets, ASSET_PACK_FILE, HouseAssetKey())) return false;
+
+    size_t size;
+    const void* bounds = AssetPackFind(assets, "terrain/bounds", &size);
+    bool found = bounds && size == sizeof(groundChunks);
+    for (int i = 0; i < 3 && found; i++) {
+        char name[ASSET_NAME_LENGTH];
+        snprintf(name, sizeof(name), "texture/%d", i + 1);
+        found = AssetPackFindTexture(assets, name, textures[i]) && textures[i].width == TW && textures[i].height == TH;
+    }
+    for (int ci = 0; ci < GROUND_CHUNKS && found; ci++) {
+        for (int cj = 0; cj < GROUND_CHUNKS && found; cj++) {
+            char name[ASSET_NAME_LENGTH];
+            snprintf(name, sizeof(name), "terrain/%d_%d", ci, cj);
+            found = AssetPackFindMesh(assets, name, groundMeshes[ci][cj]);
+        }
+    }
+    if (!found) {
+        AssetPackClose(assets);
+        return false;
+    }
+    memcpy(groundChunks, bounds, sizeof(groundChunks)); // A few KB the culling code indexes directly
+    return true;
+}
+
+// --bake [file]: generates textures and terrain procedurally and writes them out
+int BakeAssets(const char* path) {
+    GenerateTextures();
+    BuildGroundChunks();
+
+    AssetPackWriter writer;
+    AssetPackWriterInit(writer, HouseAssetKey());
+    for (int i = 0; i < 3; i++) {
+        char name[ASSET_NAME_LENGTH];
+        snprintf(name, sizeof(name), "texture/%d", i + 1);
+        AssetTextureBuildMips(textureImages[i][0][0], TW, TH, textureMipStorage[i], textures[i]);
+        AssetPackAddTexture(writer, name, textures[i]);
+    }
+    AssetPackAdd(writer, "terrain/bounds", groundChunks, sizeof(groundChunks));
+    for (int ci = 0; ci < GROUND_CHUNKS; ci++) {
+        for (int cj = 0; cj < GROUND_CHUNKS; cj++) {
+            char name[ASSET_NAME_LENGTH];
+            snprintf(name, sizeof(name), "terrain/%d_%d", ci, cj);
+            AssetPackAddMesh(writer, name, groundMeshes[ci][cj]);
+        }
+    }
+
+    if (!AssetPackWrite(writer, path)) {
+        printf("Could not write %s\n", path);
+        return 1;
+    }
+    printf("Baked 3 textures and %d terrain chunks into %s\n", GROUND_CHUNKS * GROUND_CHUNKS, path);
+    return 0;
+}
+
+// --- Job system scaling benchmark (--bench-jobs) ---
+// Init-time texture and terrain work plus culling a large synthetic sphere set
+void BenchmarkJobs() {
+    static CullSet spheres;
+    if (spheres.x.empty()) {
+        for (int i = 0; i < BENCHMARK_SPHERES; i++) {
+            int index = CullSetAdd(spheres);
+            Vec3 center = MakeVec3(rand() % 400 - 200.0f, rand() % 100 - 50.0f, rand() % 400 - 200.0f);
+            CullSetSphere(spheres, index, center, 1 + rand() % 5);
+        }
+    }
+
+    Matrix4 camera = MatLookAt(MakeVec3(INITIAL_EYE_X, INITIAL_EYE_Y, INITIAL_EYE_Z),
+        MakeVec3(INITIAL_EYE_X, INITIAL_EYE_Y, INITIAL_EYE_Z - 1), MakeVec3(0, 1, 0));
+    viewProjection = MatMultiply(MatFrustum(-1, 1, -1, 1, 1, 300), camera);
+
+    JobsBenchmark("textures + terrain", [] { GenerateTextures(); BuildGroundChunks(); }, 20);
+    JobsBenchmark("culling", [] { CullSetRun(spheres, FrustumFromMatrix(viewProjection)); }, 20);
+
+    // The same spheres as boxes in a BVH: built in parallel, then culled by visiting only nodes near the view
+    static std::vector<Aabb> boxes(BENCHMARK_SPHERES);
+    for (int i = 0; i < BENCHMARK_SPHERES; i++)
+        boxes[i] = SphereAabb(MakeVec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]);
+    static Bvh bvh;
+    JobsBenchmark("bvh build", [] { BvhBuild(bvh, boxes.data(), BENCHMARK_SPHERES); }, 5);
+
+    using namespace std::chrono;
+    static std::vector<int> visible;
+    steady_clock::time_point start = steady_clock::now();
+    for (int i = 0; i < 20; i++) {
+        visible.clear();
+        BvhQueryFrustum(bvh, FrustumFromMatrix(viewProjection), visible);
+    }
+    printf("bvh culling: %8.2f ms  %d visible\n", duration<double, std::milli>(steady_clock::now() - start).count() / 20,
+        (int)visible.size());
+
+    start = steady_clock::now();
+    for (int i = 0; i < BENCHMARK_SPHERES / 100; i++) { // 1% of the objects moved, then refit
+        Aabb box = boxes[i * 100];
+        box.min.y += 1;
+        box.max.y += 1;
+        BvhMove(bvh, i * 100, box);
+    }
+    BvhRefit(bvh);
+    printf("bvh refit of %d moved: %8.2f ms\n", BENCHMARK_SPHERES / 100,
+        duration<double, std::milli>(steady_clock::now() - start).count());
+}
+
+// --- Vertex format benchmark (--bench-vertex) ---
+// The whole terrain rasterized by the occlusion rasterizer from vertices
+// stored as immediate mode sends them, as floats and packed. The rasterizer
+// reads every vertex of every triangle, so the bytes it streams shrink with
+// the vertex size while the pixels it fills stay the same. The double and
+// float copies are made from the chunks' source grid, not from the packed
+// meshes, so the depth error shows what packing loses.
+void BenchmarkVertexFormats() {
+    BuildGroundChunks();
+
+    std::vector<DoubleVertex> doubles[GROUND_CHUNKS][GROUND_CHUNKS];
+    std::vector<FloatVertex> floats[GROUND_CHUNKS][GROUND_CHUNKS];
+    std::vector<Vec3> positions, normals;
+    std::vector<unsigned> grid;
+    int vertices = 0, vertexReads = 0;
+    for (int ci = 0; ci < GROUND_CHUNKS; ci++) {
+        for (int cj = 0; cj < GROUND_CHUNKS; cj++) {
+            const PackedMesh& mesh = groundMeshes[ci][cj];
+            GroundChunkGrid(ci, cj, positions, grid); // What BuildGroundChunkRows packed, in the same order
+            normals.resize(positions.size());
+            ComputeNormals(positions.data(), (int)positions.size(), grid.data(), (int)grid.size(), normals.data());
+            for (size_t i = 0; i < positions.size(); i++) {
+                Vec3 p = positions[i], n = normals[i];
+                DoubleVertex d = { { p.x, p.y, p.z }, { n.x, n.y, n.z }, { 0, 0 } }; // The terrain has no UVs
+                FloatVertex f = { { p.x, p.y, p.z }, { n.x, n.y, n.z }, { 0, 0 } };
+                doubles[ci][cj].push_back(d);
+                floats[ci][cj].push_back(f);
+            }
+            vertices += mesh.vertexCount;
+            vertexReads += mesh.indexCount;
+        }
+    }
+
+    Matrix4 camera = MatLookAt(MakeVec3(INITIAL_EYE_X, INITIAL_EYE_Y, INITIAL_EYE_Z),
+        MakeVec3(INITIAL_EYE_X, INITIAL_EYE_Y - 0.5f, INITIAL_EYE_Z - 1), MakeVec3(0, 1, 0));
+    Matrix4 cameraProjection = MatMultiply(MatFrustum(-1, 1, -1, 1, 1, 300), camera);
+    static OcclusionBuffer buffers[3];
+    const char* names[3] = { "double", "float", "packed" };
+    int sizes[3] = { (int)sizeof(DoubleVertex), (int)sizeof(FloatVertex), (int)sizeof(PackedVertex) };
+    printf("terrain: %d vertices, %d triangles\n", vertices, vertexReads / 3);
+
+    for (int format = 0; format < 3; format++) {
+        OcclusionBuffer& buffer = buffers[format];
+        OcclusionInit(buffer, WINDOW_WIDTH, WINDOW_HEIGHT);
+        Matrix4 world = MatIdentity();
+        double ms = 0;
+        for (int pass = 0; pass <= BENCHMARK_VERTEX_PASSES; pass++) { // Pass 0 warms up
+            OcclusionBegin(buffer, cameraProjection);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int ci = 0; ci < GROUND_CHUNKS; ci++) {
+                for (int cj = 0; cj < GROUND_CHUNKS; cj++) {
+                    const PackedMesh& mesh = groundMeshes[ci][cj];
+                    const unsigned short* indices = mesh.indexData;
+                    int numIndices = mesh.indexCount;
+                    if (format == 0) OcclusionRasterize(buffer, world, &doubles[ci][cj][0], indices, numIndices);
+                    if (format == 1) OcclusionRasterize(buffer, world, &floats[ci][cj][0], indices, numIndices);
+                    if (format == 2) OcclusionRasterize(buffer, world, mesh);
+                }
+            }
+            if (pass > 0) ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        ms /= BENCHMARK_VERTEX_PASSES;
+
+        float maxError = 0; // Depth difference from the double-precision pass
+        for (size_t i = 0; i < buffer.levels[0].size(); i++)
+            maxError = fmaxf(maxError, fabsf(buffer.levels[0][i] - buffers[0].levels[0][i]));
+        printf("%-6s %2d bytes/vertex  %6.2f MB stored  %7.2f MB read/pass  %7.3f ms/pass  depth error %g\n",
+            names[format], sizes[format], vertices * sizes[format] / 1e6, (double)vertexReads * sizes[format] / 1e6,
+            ms, maxError);
+    }
+}
+
+// --- Runs without a window ---
+// The scene graph, textures and terrain the path tracer reads, with the
+// starting camera and sliders in frame; nothing that needs a GL context
+void BuildWithoutWindow() {
+    BuildHouse();
+    BuildFence();
+    SceneUpdate(houseGraph);
+    GenerateTextures();
+    for (int i = 0; i < 3; i++) AssetTextureBuildMips(textureImages[i][0][0], TW, TH, textureMipStorage[i], textures[i]);
+    BuildGroundChunks();
+    publishFrame();
+    frame = frames.read();
+}
+
+// --- Path tracer benchmark (--bench-path) ---
+// The house from the starting view, traced without a window: one pass with
+// 1 to N workers for the scaling, then progressive passes with all of them
+void BenchmarkPathTracer() {
+    BuildWithoutWindow();
+    BuildPathScene();
+
+    viewProjection = MatMultiply(MatFrustum(-1, 1, -1, 1, 1, 300),
+        MatLookAt(frame.eye, frame.eye + frame.direction, MakeVec3(0, 1, 0)));
+    PtRenderReset(pathRender, WINDOW_WIDTH, WINDOW_HEIGHT, viewProjection, frame.eye);
+    printf("path tracer: %d triangles, %dx%d pixels, %d bounces\n", (int)pathScene.triangles.size(), WINDOW_WIDTH,
+        WINDOW_HEIGHT, PT_MAX_BOUNCES);
+    JobsBenchmark("path tracer pass", [] { PtRenderPass(pathRender, pathScene); }, BENCHMARK_PATH_PASSES);
+
+    PtRenderReset(pathRender, WINDOW_WIDTH, WINDOW_HEIGHT, viewProjection, frame.eye);
+    double ms = 0, rays = 0;
+    for (int pass = 0; pass < BENCHMARK_PATH_PASSES; pass++) {
+        PtRenderPass(pathRender, pathScene);
+        ms += pathRender.passMilliseconds;
+        rays += pathRender.raysPerSecond * pathRender.passMilliseconds / 1000;
+    }
+    printf("%d samples/pixel with %d workers: %.2f M samples/s  %.2f M rays/s\n", pathRender.samples,
+        JobsWorkerCount(), (double)WINDOW_WIDTH * WINDOW_HEIGHT * pathRender.samples / ms / 1000, rays / ms / 1000);
+}
+
+// --- Thumbnail batch (--batch DIR [floors=A:B[:N]] [windows=A:B[:N]] [roof=A:B[:N]] [size=N] [samples=N]) ---
+// A path traced thumbnail of the starting view per combination of floor
+// count, window repeat and roof color. The fence, road, terrain, textures
+// and every wall mesh are built once; a variant only adds its walls and roof.
+int RunBatch(const char* directory, int argc, char* argv[]) {
+    BatchSettings settings;
+    settings.directory = directory;
+    settings.width = BATCH_SIZE;
+    settings.samples = BATCH_SAMPLES;
+    for (int i = 0; i < 3; i++) batchRanges[i] = BATCH_RANGES[i];
+    if (!BatchParseArgs(argc, argv, batchRanges, 3, settings)) return 1;
+    settings.height = settings.width * WINDOW_HEIGHT / WINDOW_WIDTH;
+
+    BuildWithoutWindow();
+    BuildWallVariants();
+    BuildPathBase();
+    settings.viewProjection = MatMultiply(MatFrustum(VIEW_FRUSTUM[0], VIEW_FRUSTUM[1], VIEW_FRUSTUM[2],
+        VIEW_FRUSTUM[3], VIEW_FRUSTUM[4], VIEW_FRUSTUM[5]), MatLookAt(frame.eye, frame.eye + frame.direction,
+        MakeVec3(0, 1, 0)));
+    settings.eye = frame.eye;
+
+    int variants = BatchVariantCount(batchRanges, 3);
+    printf("batch: %d variants, %dx%d at %d samples/pixel, %d workers\n", variants, settings.width,
+        settings.height, settings.samples, JobsWorkerCount());
+    BatchStats stats;
+    bool written = BatchRender(variants, BuildBatchVariant, 0, settings, &stats);
+    printf("batch: %d images in %.2f s, %.2f images/s  (scene %.1f ms, render %.1f ms per image)\n", stats.images,
+        stats.seconds, stats.images / stats.seconds, stats.buildMilliseconds, stats.renderMilliseconds);
+    return written ? 0 : 1;
+}
+
+// Runs on a worker, while the previous variant renders
+void BuildBatchVariant(int variant, PtScene& scene, char name[BATCH_NAME_LENGTH], void*) {
+    int floors = (int)(BatchValue(batchRanges, 3, variant, 0) + 0.5);
+    int windowRepeat = (int)(BatchValue(batchRanges, 3, variant, 1) + 0.5);
+    double roofColorOffset = BatchValue(batchRanges, 3, variant, 2);
+    floors = floors < 1 ? 1 : floors > CITY_MAX_FLOORS ? CITY_MAX_FLOORS : floors;
+    windowRepeat = windowRepeat < 1 ? 1 : windowRepeat > CITY_WINDOW_REPEATS ? CITY_WINDOW_REPEATS : windowRepeat;
+
+    scene = pathBase;
+    AddPathHouse(scene, floors, windowRepeat, roofColorOffset, wallVariants[floors - 1][windowRepeat - 1]);
+    PtSceneBuild(scene);
+    snprintf(name, BATCH_NAME_LENGTH, "house_f%d_w%d_r%+.1f", floors, windowRepeat, roofColorOffset);
+}
+
+// --- GPU culling check (--verify-gpu-cull) ---
+// Culls a large synthetic scene on the GPU and compares every object with
+// FrustumTestSphere. Runs on llvmpipe (LIBGL_ALWAYS_SOFTWARE=1) without a GPU.
+int VerifyGpuCulling() {
+    glewInit();
+    if (!GpuSceneSupported()) {
+        printf("GPU culling needs OpenGL 4.3\n");
+        return 1;
+    }
+
+    static GpuScene scene;
+    GpuSceneInit(scene);
+    int post = BuildPrismMesh(scene, 7, 0.7f, 0.7f);
+    for (int i = 0; i < VERIFY_GPU_OBJECTS; i++) {
+        Matrix4 m = MatIdentity();
+        MatTranslate(m, rand() % 400 - 200.0, rand() % 40 - 20.0, rand() % 400 - 200.0);
+        MatScale(m, 1, 1 + rand() % 10, 1);
+        GpuSceneAddObject(scene, post, m, 1, 1, 1);
+    }
+    const GpuMesh& mesh = scene.meshes[post];
+
+    int failures = 0;
+    std::vector<unsigned char> visible;
+    Vec3 eye = MakeVec3(INITIAL_EYE_X, INITIAL_EYE_Y, INITIAL_EYE_Z);
+    for (int turn = 0; turn < 8; turn++) { // Camera turned in 45 degree steps
+        float angle = turn * PI / 4;
+        Matrix4 camera = MatLookAt(eye, eye + MakeVec3(sinf(angle), 0, -cosf(angle)), MakeVec3(0, 1, 0));
+        Matrix4 cameraProjection = MatMultiply(MatFrustum(-1, 1, -1, 1, 1, 300), camera);
+        Frustum frustum = FrustumFromMatrix(cameraProjection);
+        GpuSceneReadVisibility(scene, cameraProjection, visible);
+
+        int count = 0, mismatches = 0;
+        for (int i = 0; i < VERIFY_GPU_OBJECTS; i++) {
+            Matrix4 world;
+            memcpy(world.m, scene.objects[i].world, sizeof(world.m));
+            Vec3 center;
+            float radius;
+            TransformSphere(world, mesh.center, mesh.radius, &center, &radius);
+
+            // Spheres touching a plane within float precision may go either way
+            bool inside = FrustumTestSphere(frustum, center, radius * 0.999f);
+            bool touching = FrustumTestSphere(frustum, center, radius * 1.001f);
+            if (visible[i]) count++;
+            if (inside == touching && inside != (visible[i] != 0)) mismatches++;
+        }
+        printf("view %d: %d / %d visible, %d mismatches\n", turn, count, VERIFY_GPU_OBJECTS, mismatches);
+        failures += mismatches;
+    }
+
+    GpuSceneRelease(scene);
+    printf(failures ? "GPU culling FAILED\n" : "GPU culling OK\n");
+    return failures ? 1 : 0;
+}
+
+// --- City scaling benchmark (--bench-city) ---
+// Renders the city at each size along the same camera path, a circle just
+// outside the house's terrain looking out and slightly down, and reports the
+// mean frame time with the GPU finished every frame. The far plane bounds
+// what is drawn, so growth past a few thousand objects is culling and
+// bookkeeping cost.
+int BenchmarkCity() {
+    printf("%8s %8s %8s %10s %10s %10s\n", "objects", "houses", "owls", "drawn", "packets", "ms/frame");
+    for (int c = 0; c < (int)(sizeof(BENCHMARK_CITY_COUNTS) / sizeof(BENCHMARK_CITY_COUNTS[0])); c++) {
+        BuildCity(BENCHMARK_CITY_COUNTS[c]);
+
+        double ms = 0;
+        long long drawn = 0, packets = 0;
+        for (int f = 0; f < BENCHMARK_CITY_WARMUP + BENCHMARK_CITY_FRAMES; f++) {
+            float angle = 2 * PI * f / BENCHMARK_CITY_FRAMES;
+            eye = MakeVec3(80 * cosf(angle), 40, 80 * sinf(angle)); // No simulation thread yet, so set it here
+            direction = Normalize(MakeVec3(cosf(angle), -0.2f, sinf(angle)));
+            publishFrame();
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            display();
+            glFinish();
+            if (f < BENCHMARK_CITY_WARMUP) continue;
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            drawn += cityHousesDrawn + cityOwlsDrawn;
+            packets += drawQueue.packets.size();
+        }
+        printf("%8d %8d %8d %10.1f %10.1f %10.3f\n", BENCHMARK_CITY_COUNTS[c], (int)city.houses.size(),
+            (int)city.owls.size(), (double)drawn / BENCHMARK_CITY_FRAMES, (double)packets / BENCHMARK_CITY_FRAMES,
+            ms / BENCHMARK_CITY_FRAMES);
+    }
+    return 0;
+}
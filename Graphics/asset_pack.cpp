@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "glew.h"
+#include "glut.h"
+#include "asset_pack.h"
+
+// Blob layouts; vertex and level data follow the header directly
+struct MeshBlob {
+    VertexQuantization quantization;
+    int vertexCount, indexCount;
+};
+
+struct TextureBlob {
+    int width, height, levels, pad;
+};
+
+// --- Mapping ---
+static void unmapFile(AssetPack& pack) {
+#ifdef _WIN32
+    if (pack.data) UnmapViewOfFile(pack.data);
+    if (pack.mapping) CloseHandle((HANDLE)pack.mapping);
+    if (pack.file) CloseHandle((HANDLE)pack.file);
+#else
+    if (pack.data) munmap((void*)pack.data, pack.size);
+#endif
+    memset(&pack, 0, sizeof(pack));
+}
+
+static bool mapFile(AssetPack& pack, const char* path) {
+    memset(&pack, 0, sizeof(pack));
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    pack.file = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        unmapFile(pack);
+        return false;
+    }
+    pack.size = (size_t)size.QuadPart;
+    pack.mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (pack.mapping) pack.data = (const unsigned char*)MapViewOfFile((HANDLE)pack.mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) return false;
+    struct stat info;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        void* data = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED) {
+            pack.data = (const unsigned char*)data;
+            pack.size = (size_t)info.st_size;
+        }
+    }
+    close(file); // The mapping keeps the file alive
+#endif
+    if (!pack.data) {
+        unmapFile(pack);
+        return false;
+    }
+    return true;
+}
+
+// --- Reading ---
+bool AssetPackOpen(AssetPack& pack, const char* path, unsigned sourceKey) {
+    if (!mapFile(pack, path)) return false;
+
+    const AssetPackHeader* header = (const AssetPackHeader*)pack.data;
+    bool valid = pack.size >= sizeof(AssetPackHeader) && header->magic == ASSET_PACK_MAGIC &&
+        header->version == ASSET_PACK_VERSION && header->sourceKey == sourceKey && header->fileSize == pack.size &&
+        sizeof(AssetPackHeader) + (unsigned long long)header->numEntries * sizeof(AssetEntry) <= pack.size;
+    if (valid) {
+        pack.entries = (const AssetEntry*)(header + 1);
+        pack.numEntries = (int)header->numEntries;
+        for (int i = 0; i < pack.numEntries && valid; i++) {
+            const AssetEntry& entry = pack.entries[i];
+            valid = entry.offset % ASSET_PACK_ALIGNMENT == 0 && entry.offset <= pack.size &&
+                entry.size <= pack.size - entry.offset && memchr(entry.name, 0, ASSET_NAME_LENGTH);
+        }
+    }
+    if (!valid) AssetPackClose(pack);
+    return valid;
+}
+
+void AssetPackClose(AssetPack& pack) {
+    unmapFile(pack);
+}
+
+const void* AssetPackFind(const AssetPack& pack, const char* name, size_t* size) {
+    for (int i = 0; i < pack.numEntries; i++) {
+        if (strcmp(pack.entries[i].name, name) != 0) continue;
+        if (size) *size = (size_t)pack.entries[i].size;
+        return pack.data + pack.entries[i].offset;
+    }
+    return 0;
+}
+
+bool AssetPackFindMesh(const AssetPack& pack, const char* name, PackedMesh& mesh) {
+    size_t size;
+    const MeshBlob* blob = (const MeshBlob*)AssetPackFind(pack, name, &size);
+    if (!blob || size < sizeof(MeshBlob)) return false;
+    if (size != sizeof(MeshBlob) + blob->vertexCount * sizeof(PackedVertex) + blob->indexCount * sizeof(unsigned short))
+        return false;
+
+    const PackedVertex* vertices = (const PackedVertex*)(blob + 1);
+    const unsigned short* indices = (const unsigned short*)(vertices + blob->vertexCount);
+    PackedMeshMap(mesh, vertices, blob->vertexCount, indices, blob->indexCount, blob->quantization);
+    return true;
+}
+
+bool AssetPackFindTexture(const AssetPack& pack, const char* name, AssetTexture& texture) {
+    size_t size;
+    const TextureBlob* blob = (const TextureBlob*)AssetPackFind(pack, name, &size);
+    if (!blob || size < sizeof(TextureBlob) || blob->levels < 1 || blob->levels > ASSET_MAX_MIP_LEVELS) return false;
+
+    texture.width = blob->width;
+    texture.height = blob->height;
+    texture.levels = blob->levels;
+    size_t offset = sizeof(TextureBlob);
+    for (int i = 0, w = blob->width, h = blob->height; i < blob->levels; i++) {
+        texture.level[i] = (const unsigned char*)blob + offset;
+        offset += (size_t)w * h * 3;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    return offset == size;
+}
+
+// --- Writing ---
+void AssetPackWriterInit(AssetPackWriter& writer, unsigned sourceKey) {
+    writer.sourceKey = sourceKey;
+    writer.entries.clear();
+    writer.blobs.clear();
+}
+
+// Reserves an aligned blob and returns where its bytes go
+static unsigned char* addBlob(AssetPackWriter& writer, const char* name, size_t size) {
+    size_t offset = (writer.blobs.size() + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+    writer.blobs.resize(offset + size);
+
+    AssetEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    snprintf(entry.name, ASSET_NAME_LENGTH, "%s", name);
+    entry.offset = offset;
+    entry.size = size;
+    writer.entries.push_back(entry);
+    return &writer.blobs[offset];
+}
+
+void AssetPackAdd(AssetPackWriter& writer, const char* name, const void* data, size_t size) {
+    unsigned char* out = addBlob(writer, name, size);
+    if (size) memcpy(out, data, size);
+}
+
+void AssetPackAddMesh(AssetPackWriter& writer, const char* name, const PackedMesh& mesh) {
+    size_t vertexBytes = mesh.vertexCount * sizeof(PackedVertex), indexBytes = mesh.indexCount * sizeof(unsigned short);
+    unsigned char* out = addBlob(writer, name, sizeof(MeshBlob) + vertexBytes + indexBytes);
+
+    MeshBlob blob = { mesh.quantization, mesh.vertexCount, mesh.indexCount };
+    memcpy(out, &blob, sizeof(blob));
+    if (vertexBytes) memcpy(out + sizeof(blob), mesh.vertexData, vertexBytes);
+    if (indexBytes) memcpy(out + sizeof(blob) + vertexBytes, mesh.indexData, indexBytes);
+}
+
+void AssetPackAddTexture(AssetPackWriter& writer, const char* name, const AssetTexture& texture) {
+    size_t size = sizeof(TextureBlob);
+    for (int i = 0, w = texture.width, h = texture.height; i < texture.levels; i++) {
+        size += (size_t)w * h * 3;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    unsigned char* out = addBlob(writer, name, size);
+
+    TextureBlob blob = { texture.width, texture.height, texture.levels, 0 };
+    memcpy(out, &blob, sizeof(blob));
+    out += sizeof(blob);
+    for (int i = 0, w = texture.width, h = texture.height; i < texture.levels; i++) {
+        memcpy(out, texture.level[i], (size_t)w * h * 3);
+        out += (size_t)w * h * 3;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+}
+
+bool AssetPackWrite(const AssetPackWriter& writer, const char* path) {
+    size_t tableEnd = sizeof(AssetPackHeader) + writer.entries.size() * sizeof(AssetEntry);
+    size_t blobStart = (tableEnd + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+
+    AssetPackHeader header = { ASSET_PACK_MAGIC, ASSET_PACK_VERSION, writer.sourceKey,
+        (unsigned)writer.entries.size(), blobStart + writer.blobs.size() };
+    std::vector<AssetEntry> entries = writer.entries;
+    for (size_t i = 0; i < entries.size(); i++) entries[i].offset += blobStart;
+    static const unsigned char padding[ASSET_PACK_ALIGNMENT] = { 0 };
+
+    FILE* file = 0;
+#ifdef _MSC_VER
+    fopen_s(&file, path, "wb"); // fopen is deprecated under /sdl
+#else
+    file = fopen(path, "wb");
+#endif
+    if (!file) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && !entries.empty()) ok = fwrite(&entries[0], sizeof(AssetEntry), entries.size(), file) == entries.size();
+    if (ok && blobStart > tableEnd) ok = fwrite(padding, blobStart - tableEnd, 1, file) == 1;
+    if (ok && !writer.blobs.empty()) ok = fwrite(&writer.blobs[0], writer.blobs.size(), 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
+
+// --- Textures ---
+// Power-of-two sizes halve exactly; other sizes drop their last row or column
+void AssetTextureBuildMips(const unsigned char* rgb, int width, int height, std::vector<unsigned char>& storage,
+    AssetTexture& texture) {
+    size_t size = 0;
+    int levels = 0;
+    for (int w = width, h = height; levels < ASSET_MAX_MIP_LEVELS; levels++) {
+        size += (size_t)w * h * 3;
+        if (w == 1 && h == 1) {
+            levels++;
+            break;
+        }
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    storage.resize(size);
+    memcpy(&storage[0], rgb, (size_t)width * height * 3);
+
+    texture.width = width;
+    texture.height = height;
+    texture.levels = levels;
+    texture.level[0] = &storage[0];
+    size_t offset = (size_t)width * height * 3;
+    for (int i = 1, w = width, h = height; i < levels; i++) {
+        const unsigned char* src = texture.level[i - 1];
+        int srcWidth = w, srcHeight = h;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        unsigned char* dst = &storage[offset];
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                // 2x2 block below, or a pair once one side is down to a single texel
+                int x0 = x * 2, y0 = y * 2;
+                int x1 = srcWidth > 1 ? x0 + 1 : x0, y1 = srcHeight > 1 ? y0 + 1 : y0;
+                for (int c = 0; c < 3; c++) {
+                    int sum = src[(y0 * srcWidth + x0) * 3 + c] + src[(y0 * srcWidth + x1) * 3 + c] +
+                        src[(y1 * srcWidth + x0) * 3 + c] + src[(y1 * srcWidth + x1) * 3 + c];
+                    dst[(y * w + x) * 3 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        texture.level[i] = dst;
+        offset += (size_t)w * h * 3;
+    }
+}
+
+void AssetTextureUpload(const AssetTexture& texture) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Small levels have rows of 3 or 6 bytes
+    for (int i = 0, w = texture.width, h = texture.height; i < texture.levels; i++) {
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, texture.level[i]);
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+unsigned AssetHash(unsigned hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
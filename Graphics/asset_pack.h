@@ -0,0 +1,80 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "vertex_format.h"
+
+// --- Binary asset pack ---
+// Meshes, textures and terrain baked offline (--bake) into one file that is
+// memory-mapped at start and used in place: a blob is stored exactly as it
+// is drawn or uploaded, so loading does no parsing and no copying.
+//
+//   header   magic, version, source key, entry count, file size
+//   entries  name, offset and size of every blob
+//   blobs    each starting on an ASSET_PACK_ALIGNMENT boundary
+//
+// The source key is chosen by the scene from everything its generators
+// depend on. A pack with another version or key is stale and ignored, and
+// the scene falls back to building its assets procedurally.
+
+const unsigned ASSET_PACK_MAGIC = 0x4B415047; // "GPAK"
+const unsigned ASSET_PACK_VERSION = 1;        // Bump when the layout of any blob changes
+const int ASSET_PACK_ALIGNMENT = 64;
+const int ASSET_NAME_LENGTH = 32;
+const int ASSET_MAX_MIP_LEVELS = 16;
+
+struct AssetPackHeader {
+    unsigned magic, version;
+    unsigned sourceKey;
+    unsigned numEntries;
+    unsigned long long fileSize;
+};
+
+struct AssetEntry {
+    char name[ASSET_NAME_LENGTH];
+    unsigned long long offset, size;
+};
+
+struct AssetPack {
+    const unsigned char* data; // Whole file, read-only; null when not open
+    size_t size;
+    const AssetEntry* entries;
+    int numEntries;
+    void* file;                // Platform handles
+    void* mapping;
+};
+
+// RGB, 8 bits per channel, level 0 first; each level halves until 1x1
+struct AssetTexture {
+    int width, height, levels;
+    const unsigned char* level[ASSET_MAX_MIP_LEVELS];
+};
+
+// Built in memory, then written in one go
+struct AssetPackWriter {
+    unsigned sourceKey;
+    std::vector<AssetEntry> entries;
+    std::vector<unsigned char> blobs; // Offsets relative to the first blob until written
+};
+
+// False when the file is missing, truncated, of another version or stale
+bool AssetPackOpen(AssetPack& pack, const char* path, unsigned sourceKey);
+void AssetPackClose(AssetPack& pack);
+const void* AssetPackFind(const AssetPack& pack, const char* name, size_t* size); // Null when absent
+bool AssetPackFindMesh(const AssetPack& pack, const char* name, PackedMesh& mesh);  // Maps in place
+bool AssetPackFindTexture(const AssetPack& pack, const char* name, AssetTexture& texture);
+
+void AssetPackWriterInit(AssetPackWriter& writer, unsigned sourceKey);
+void AssetPackAdd(AssetPackWriter& writer, const char* name, const void* data, size_t size);
+void AssetPackAddMesh(AssetPackWriter& writer, const char* name, const PackedMesh& mesh);
+void AssetPackAddTexture(AssetPackWriter& writer, const char* name, const AssetTexture& texture);
+bool AssetPackWrite(const AssetPackWriter& writer, const char* path);
+
+// --- Textures ---
+// Box-filtered mip chain of an RGB image; texture points into storage
+void AssetTextureBuildMips(const unsigned char* rgb, int width, int height, std::vector<unsigned char>& storage,
+    AssetTexture& texture);
+void AssetTextureUpload(const AssetTexture& texture); // Every level into the bound GL_TEXTURE_2D
+
+// FNV-1a, for building source keys
+unsigned AssetHash(unsigned hash, const void* data, size_t size);
+const unsigned ASSET_HASH_SEED = 2166136261u;
@@ -0,0 +1,146 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "image_writer.h"
+#include "jobs.h"
+
+// --- Arguments ---
+bool BatchParseArgs(int argc, char* argv[], BatchRange* ranges, int numRanges, BatchSettings& settings) {
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = strchr(arg, '=');
+        if (!value) {
+            printf("batch: expected name=value, got %s\n", arg);
+            return false;
+        }
+        size_t length = value - arg;
+        value++;
+
+        if (length == 4 && strncmp(arg, "size", 4) == 0) {
+            settings.width = atoi(value);
+            if (settings.width < 1) settings.width = 1;
+            continue;
+        }
+        if (length == 7 && strncmp(arg, "samples", 7) == 0) {
+            settings.samples = atoi(value);
+            if (settings.samples < 1) settings.samples = 1;
+            continue;
+        }
+
+        BatchRange* range = 0;
+        for (int r = 0; r < numRanges; r++)
+            if (strlen(ranges[r].name) == length && strncmp(arg, ranges[r].name, length) == 0) range = &ranges[r];
+        // first:last[:count], parsed by hand since sscanf is deprecated under /sdl
+        char* end = (char*)value;
+        double first = range ? strtod(value, &end) : 0;
+        bool valid = range && end != value && *end == ':';
+        const char* next = end + 1;
+        double last = valid ? strtod(next, &end) : 0;
+        valid = valid && end != next;
+        long count = valid ? abs((int)(last - first)) + 1 : 0;
+        if (valid && *end == ':') {
+            next = end + 1;
+            count = strtol(next, &end, 10);
+            valid = end != next && count >= 1;
+        }
+        if (!valid || *end != 0) {
+            printf("batch: cannot read %s\n", arg);
+            return false;
+        }
+        range->first = first;
+        range->last = last;
+        range->count = (int)count;
+    }
+    return true;
+}
+
+int BatchVariantCount(const BatchRange* ranges, int numRanges) {
+    int count = 1;
+    for (int r = 0; r < numRanges; r++) count *= ranges[r].count;
+    return count;
+}
+
+double BatchValue(const BatchRange* ranges, int numRanges, int variant, int range) {
+    for (int r = numRanges - 1; r > range; r--) variant /= ranges[r].count;
+    const BatchRange& values = ranges[range];
+    int step = variant % values.count;
+    return values.count > 1 ? values.first + (values.last - values.first) * step / (values.count - 1) : values.first;
+}
+
+// --- Rendering ---
+struct BatchSlot {
+    PtScene scene;
+    char name[BATCH_NAME_LENGTH];
+    int variant;
+    double milliseconds; // Building the scene
+    BatchBuildFunction build;
+    void* data;
+    JobCounter building; // The build job, until it has finished
+};
+
+static void buildSlot(void* data) {
+    BatchSlot& slot = *(BatchSlot*)data;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    slot.build(slot.variant, slot.scene, slot.name, slot.data);
+    slot.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void startBuild(BatchSlot& slot, int variant) {
+    slot.variant = variant;
+    JobRun(JobCreate(buildSlot, &slot, &slot.building));
+}
+
+// PtRender keeps the bottom row first, as glDrawPixels wants it
+static bool writeImage(const PtRender& render, const char* directory, const char* name) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.png", directory, name);
+    ImageWriter writer;
+    if (!ImageWriterOpen(writer, path, render.width, render.height)) {
+        ImageWriterClose(writer);
+        printf("batch: cannot write %s\n", path);
+        return false;
+    }
+    for (int y = render.height - 1; y >= 0; y--) ImageWriterRow(writer, &render.pixels[(size_t)y * render.width * 3]);
+    return ImageWriterClose(writer);
+}
+
+bool BatchRender(int variants, BatchBuildFunction build, void* data, const BatchSettings& settings, BatchStats* stats) {
+    using namespace std::chrono;
+    steady_clock::time_point start = steady_clock::now();
+    BatchSlot slots[2];
+    for (int i = 0; i < 2; i++) {
+        slots[i].build = build;
+        slots[i].data = data;
+        slots[i].building.store(0);
+    }
+    PtRender render;
+    if (variants > 0) startBuild(slots[0], 0);
+    double buildMilliseconds = 0, renderMilliseconds = 0;
+    bool written = true;
+
+    for (int variant = 0; variant < variants; variant++) {
+        BatchSlot& slot = slots[variant % 2];
+        JobWait(slot.building);
+        buildMilliseconds += slot.milliseconds;
+        // The other slot's variant has been written, so its scene is free for the next one
+        if (variant + 1 < variants) startBuild(slots[(variant + 1) % 2], variant + 1);
+
+        steady_clock::time_point renderStart = steady_clock::now();
+        PtRenderReset(render, settings.width, settings.height, settings.viewProjection, settings.eye);
+        for (int sample = 0; sample < settings.samples; sample++) PtRenderPass(render, slot.scene);
+        renderMilliseconds += duration<double, std::milli>(steady_clock::now() - renderStart).count();
+
+        written = writeImage(render, settings.directory, slot.name) && written;
+        printf("batch: %d / %d %s\n", variant + 1, variants, slot.name);
+    }
+
+    if (stats) {
+        stats->images = variants;
+        stats->seconds = duration<double>(steady_clock::now() - start).count();
+        stats->buildMilliseconds = variants > 0 ? buildMilliseconds / variants : 0;
+        stats->renderMilliseconds = variants > 0 ? renderMilliseconds / variants : 0;
+    }
+    return written;
+}
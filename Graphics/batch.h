@@ -0,0 +1,52 @@
+#pragma once
+#include "pathtracer.h"
+
+// --- Parameter sweep ---
+// Renders one image per combination of parameter values, without a window:
+// the path tracer needs no GL context. Each variant's scene is built by the
+// caller's function, on a job, while the previous variant renders, so the
+// scene build hides behind the render. Two scene slots take turns. Every
+// image is spread over all workers by PtRenderPass.
+//
+// The caller keeps whatever does not change between variants (meshes,
+// textures, a base scene) and only adds what does.
+
+const int BATCH_MAX_RANGES = 4;
+const int BATCH_NAME_LENGTH = 64;
+
+// Parameter values first to last in count even steps
+struct BatchRange {
+    const char* name;
+    double first, last;
+    int count;
+};
+
+struct BatchSettings {
+    const char* directory;  // Images are written here, as <name>.png
+    int width, height;
+    int samples;            // Per pixel
+    Matrix4 viewProjection; // Camera, as for PtRenderReset
+    Vec3 eye;
+};
+
+struct BatchStats {
+    int images;
+    double seconds;
+    double buildMilliseconds, renderMilliseconds; // Per image, on average
+};
+
+// Builds the variant's scene (PtSceneBuild included) and names its image,
+// without the extension. Runs on a worker, one at a time.
+typedef void (*BatchBuildFunction)(int variant, PtScene& scene, char name[BATCH_NAME_LENGTH], void* data);
+
+// Reads name=first:last[:count] for the given ranges, size=N and samples=N.
+// ranges and settings hold the defaults. Without count, the range steps by
+// one. False, with a message, on an unknown or malformed argument.
+bool BatchParseArgs(int argc, char* argv[], BatchRange* ranges, int numRanges, BatchSettings& settings);
+
+int BatchVariantCount(const BatchRange* ranges, int numRanges);
+// Value of ranges[range] in a variant; the last range varies fastest
+double BatchValue(const BatchRange* ranges, int numRanges, int variant, int range);
+
+// Every variant, in order. False if an image could not be written.
+bool BatchRender(int variants, BatchBuildFunction build, void* data, const BatchSettings& settings, BatchStats* stats);
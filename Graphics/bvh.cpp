@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include "bvh.h"
+#include "jobs.h"
+
+// Deeper nodes become leaves whatever their size, which bounds the traversal stacks
+static const int BVH_MAX_DEPTH = 48;
+static const int BVH_STACK_SIZE = 64;
+
+// Objects are partitioned as records holding everything the build reads,
+// so each node's objects are contiguous in memory
+struct BvhBuildItem {
+    Aabb box;
+    Vec3 centroid;
+    int object;
+};
+
+struct BvhBuildContext {
+    Bvh* bvh;
+    std::vector<BvhBuildItem> items;
+    std::atomic<int> nodeCount;
+};
+
+struct BvhBuildTask {
+    BvhBuildContext* context;
+    int node, first, count, depth;
+};
+
+static void buildNode(BvhBuildContext& context, int index, int first, int count, int depth);
+
+static void buildJob(void* data) {
+    BvhBuildTask& task = *(BvhBuildTask*)data;
+    buildNode(*task.context, task.node, task.first, task.count, task.depth);
+}
+
+static float surfaceArea(const Aabb& box) {
+    Vec3 d = box.max - box.min;
+    return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static void grow(Aabb& box, const Aabb& other) {
+    box.min = Min(box.min, other.min);
+    box.max = Max(box.max, other.max);
+}
+
+static float axisOf(const Vec3& v, int axis) {
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static void makeLeaf(BvhBuildContext& context, int index) {
+    Bvh& bvh = *context.bvh;
+    const BvhNode& node = bvh.nodes[index];
+    for (int i = node.first; i < node.first + node.count; i++) {
+        bvh.items[i] = context.items[i].object;
+        bvh.leafOf[context.items[i].object] = index;
+    }
+}
+
+// --- Build ---
+// Binned SAH: the centroids' extent along their widest axis is cut into
+// BVH_BINS equal bins, and the cheapest of the planes between bins wins
+static void buildNode(BvhBuildContext& context, int index, int first, int count, int depth) {
+    Bvh& bvh = *context.bvh;
+    BvhBuildItem* items = &context.items[first];
+
+    BvhNode& node = bvh.nodes[index]; // Preallocated, so other tasks never move it
+    node.box = items[0].box;
+    Aabb centroidBox = { items[0].centroid, items[0].centroid };
+    for (int i = 1; i < count; i++) {
+        grow(node.box, items[i].box);
+        centroidBox.min = Min(centroidBox.min, items[i].centroid);
+        centroidBox.max = Max(centroidBox.max, items[i].centroid);
+    }
+    node.first = first;
+    node.count = count;
+    node.left = -1;
+    if (count <= BVH_LEAF_ITEMS || depth >= BVH_MAX_DEPTH) {
+        makeLeaf(context, index);
+        return;
+    }
+
+    Vec3 extents = centroidBox.max - centroidBox.min;
+    int axis = extents.x >= extents.y && extents.x >= extents.z ? 0 : extents.y >= extents.z ? 1 : 2;
+    float low = axisOf(centroidBox.min, axis), extent = axisOf(extents, axis);
+    float scale = extent > 0 ? BVH_BINS * 0.9999f / extent : 0;
+
+    int bestSplit = -1;
+    float bestCost = FLT_MAX;
+    if (extent > 0) {
+        Aabb binBox[BVH_BINS];
+        int binCount[BVH_BINS] = { 0 };
+        for (int i = 0; i < count; i++) {
+            int bin = (int)((axisOf(items[i].centroid, axis) - low) * scale);
+            if (binCount[bin]++ == 0) binBox[bin] = items[i].box;
+            else grow(binBox[bin], items[i].box);
+        }
+
+        // Right side areas swept from the last bin, then the left side from the first
+        float rightArea[BVH_BINS];
+        int rightCount[BVH_BINS];
+        Aabb side;
+        int sideCount = 0;
+        for (int b = BVH_BINS - 1; b > 0; b--) {
+            if (binCount[b]) {
+                if (sideCount == 0) side = binBox[b];
+                else grow(side, binBox[b]);
+                sideCount += binCount[b];
+            }
+            rightArea[b] = sideCount ? surfaceArea(side) : 0;
+            rightCount[b] = sideCount;
+        }
+        sideCount = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            if (binCount[b]) {
+                if (sideCount == 0) side = binBox[b];
+                else grow(side, binBox[b]);
+                sideCount += binCount[b];
+            }
+            if (sideCount == 0 || rightCount[b + 1] == 0) continue;
+            float cost = sideCount * surfaceArea(side) + rightCount[b + 1] * rightArea[b + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+    }
+
+    // One traversal step plus testing both children, against testing every object here
+    float area = surfaceArea(node.box);
+    if (count <= BVH_MAX_LEAF_ITEMS && (bestSplit < 0 || area + bestCost >= count * area)) {
+        makeLeaf(context, index);
+        return;
+    }
+
+    int middle = count / 2; // Also when every centroid is the same point
+    if (bestSplit >= 0) {
+        BvhBuildItem* split = std::partition(items, items + count, [&](const BvhBuildItem& item) {
+            return (int)((axisOf(item.centroid, axis) - low) * scale) <= bestSplit;
+        });
+        middle = (int)(split - items);
+        if (middle == 0 || middle == count) middle = count / 2;
+    }
+
+    int left = context.nodeCount.fetch_add(2);
+    node.left = left;
+    bvh.nodes[left].parent = bvh.nodes[left + 1].parent = index;
+
+    if (count > BVH_PARALLEL_ITEMS && JobsWorkerCount() > 1) {
+        BvhBuildTask task = { &context, left, first, middle, depth + 1 };
+        JobCounter leftDone(0);
+        JobRun(JobCreate(buildJob, &task, &leftDone));
+        buildNode(context, left + 1, first + middle, count - middle, depth + 1);
+        JobWait(leftDone);
+    }
+    else {
+        buildNode(context, left, first, middle, depth + 1);
+        buildNode(context, left + 1, first + middle, count - middle, depth + 1);
+    }
+}
+
+void BvhBuild(Bvh& bvh, const Aabb* bounds, int count) {
+    bvh.bounds.assign(bounds, bounds + count);
+    bvh.items.resize(count);
+    bvh.leafOf.assign(count, -1);
+    bvh.nodes.assign(count > 0 ? 2 * count - 1 : 0, BvhNode()); // Most a binary tree with count leaves can have
+    bvh.dirtyNodes.clear();
+    if (count == 0) {
+        bvh.dirty.clear();
+        return;
+    }
+
+    BvhBuildContext context;
+    context.bvh = &bvh;
+    context.items.resize(count);
+    context.nodeCount.store(1);
+    for (int i = 0; i < count; i++) {
+        BvhBuildItem& item = context.items[i];
+        item.box = bounds[i];
+        item.centroid = (bounds[i].min + bounds[i].max) * 0.5f;
+        item.object = i;
+    }
+    bvh.nodes[0].parent = -1;
+    buildNode(context, 0, 0, count, 0);
+
+    bvh.nodes.resize(context.nodeCount.load());
+    bvh.dirty.assign(bvh.nodes.size(), 0);
+}
+
+// --- Refit ---
+void BvhMove(Bvh& bvh, int object, const Aabb& box) {
+    bvh.bounds[object] = box;
+    for (int node = bvh.leafOf[object]; node >= 0 && !bvh.dirty[node]; node = bvh.nodes[node].parent) {
+        bvh.dirty[node] = 1; // Its ancestors are marked already when it is
+        bvh.dirtyNodes.push_back(node);
+    }
+}
+
+// Children have higher indices than their parent, so going down the
+// indices finishes every child before its parent
+void BvhRefit(Bvh& bvh) {
+    std::sort(bvh.dirtyNodes.begin(), bvh.dirtyNodes.end(), [](int a, int b) { return a > b; });
+    for (size_t i = 0; i < bvh.dirtyNodes.size(); i++) {
+        BvhNode& node = bvh.nodes[bvh.dirtyNodes[i]];
+        if (node.left < 0) {
+            node.box = bvh.bounds[bvh.items[node.first]];
+            for (int k = node.first + 1; k < node.first + node.count; k++) grow(node.box, bvh.bounds[bvh.items[k]]);
+        }
+        else {
+            node.box = bvh.nodes[node.left].box;
+            grow(node.box, bvh.nodes[node.left + 1].box);
+        }
+        bvh.dirty[bvh.dirtyNodes[i]] = 0;
+    }
+    bvh.dirtyNodes.clear();
+}
+
+// --- Queries ---
+// Clears the bit of every plane the box is entirely inside; false when it is outside one
+static bool clipPlanes(const Frustum& frustum, const Aabb& box, int& planes) {
+    for (int i = 0; i < 6; i++) {
+        if (!(planes & (1 << i))) continue;
+        const Vec4& p = frustum.planes[i];
+        float px = p.x >= 0 ? box.max.x : box.min.x, nx = p.x >= 0 ? box.min.x : box.max.x;
+        float py = p.y >= 0 ? box.max.y : box.min.y, ny = p.y >= 0 ? box.min.y : box.max.y;
+        float pz = p.z >= 0 ? box.max.z : box.min.z, nz = p.z >= 0 ? box.min.z : box.max.z;
+        if (p.x * px + p.y * py + p.z * pz + p.w < 0) return false;
+        if (p.x * nx + p.y * ny + p.z * nz + p.w >= 0) planes &= ~(1 << i);
+    }
+    return true;
+}
+
+int BvhQueryFrustum(const Bvh& bvh, const Frustum& frustum, std::vector<int>& objects) {
+    if (bvh.nodes.empty()) return 0;
+    size_t start = objects.size();
+    int stack[BVH_STACK_SIZE], stackPlanes[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top] = 0;
+    stackPlanes[top++] = 0x3F;
+
+    while (top > 0) {
+        top--;
+        const BvhNode& node = bvh.nodes[stack[top]];
+        int planes = stackPlanes[top];
+        if (!clipPlanes(frustum, node.box, planes)) continue;
+
+        if (planes == 0) { // Entirely inside: the whole range, untested
+            objects.insert(objects.end(), bvh.items.begin() + node.first, bvh.items.begin() + node.first + node.count);
+        }
+        else if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                int objectPlanes = planes;
+                if (clipPlanes(frustum, bvh.bounds[bvh.items[i]], objectPlanes)) objects.push_back(bvh.items[i]);
+            }
+        }
+        else {
+            stack[top] = node.left;
+            stackPlanes[top++] = planes;
+            stack[top] = node.left + 1;
+            stackPlanes[top++] = planes;
+        }
+    }
+    return (int)(objects.size() - start);
+}
+
+static bool overlaps(const Aabb& a, const Aabb& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y &&
+        a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+int BvhQueryBox(const Bvh& bvh, const Aabb& box, std::vector<int>& objects) {
+    if (bvh.nodes.empty()) return 0;
+    size_t start = objects.size();
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        if (!overlaps(node.box, box)) continue;
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                if (overlaps(bvh.bounds[bvh.items[i]], box)) objects.push_back(bvh.items[i]);
+            continue;
+        }
+        stack[top++] = node.left;
+        stack[top++] = node.left + 1;
+    }
+    return (int)(objects.size() - start);
+}
+
+// Distance along the ray to where it enters the box, FLT_MAX when it misses within maxT
+static float rayEnter(const Aabb& box, const Vec3& origin, const Vec3& inverse, float maxT) {
+    float t0 = (box.min.x - origin.x) * inverse.x, t1 = (box.max.x - origin.x) * inverse.x;
+    float enter = fminf(t0, t1), leave = fmaxf(t0, t1);
+    t0 = (box.min.y - origin.y) * inverse.y;
+    t1 = (box.max.y - origin.y) * inverse.y;
+    enter = fmaxf(enter, fminf(t0, t1));
+    leave = fminf(leave, fmaxf(t0, t1));
+    t0 = (box.min.z - origin.z) * inverse.z;
+    t1 = (box.max.z - origin.z) * inverse.z;
+    enter = fmaxf(enter, fminf(t0, t1));
+    leave = fminf(leave, fmaxf(t0, t1));
+    if (enter < 0) enter = 0; // Starts inside
+    return enter <= leave && enter < maxT ? enter : FLT_MAX;
+}
+
+int BvhRaycast(const Bvh& bvh, const Vec3& origin, const Vec3& direction, float maxT, BvhRayTest test, void* data,
+    float* t) {
+    *t = maxT;
+    if (bvh.nodes.empty()) return -1;
+    Vec3 inverse = MakeVec3(1 / direction.x, 1 / direction.y, 1 / direction.z); // Infinite on axis-parallel rays
+    int hit = -1;
+    int stack[BVH_STACK_SIZE];
+    float stackEnter[BVH_STACK_SIZE];
+    int top = 0;
+    stackEnter[top] = rayEnter(bvh.nodes[0].box, origin, inverse, maxT);
+    stack[top++] = 0;
+
+    while (top > 0) {
+        top--;
+        if (stackEnter[top] >= *t) continue; // Something closer was hit since it was pushed
+        const BvhNode& node = bvh.nodes[stack[top]];
+
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                int object = bvh.items[i];
+                float enter = rayEnter(bvh.bounds[object], origin, inverse, *t);
+                if (enter == FLT_MAX) continue;
+                if (test ? test(data, object, origin, direction, t) : (*t = enter, true)) hit = object;
+            }
+            continue;
+        }
+
+        // Nearer child on top, so it is searched first and can prune the other
+        float enterLeft = rayEnter(bvh.nodes[node.left].box, origin, inverse, *t);
+        float enterRight = rayEnter(bvh.nodes[node.left + 1].box, origin, inverse, *t);
+        int nearChild = enterLeft <= enterRight ? node.left : node.left + 1;
+        float nearEnter = fminf(enterLeft, enterRight), farEnter = fmaxf(enterLeft, enterRight);
+        if (farEnter != FLT_MAX) {
+            stack[top] = nearChild == node.left ? node.left + 1 : node.left;
+            stackEnter[top++] = farEnter;
+        }
+        if (nearEnter != FLT_MAX) {
+            stack[top] = nearChild;
+            stackEnter[top++] = nearEnter;
+        }
+    }
+    return hit;
+}
+
+static float boxDistance(const Aabb& box, const Vec3& point) {
+    Vec3 d = Max(Max(box.min - point, point - box.max), MakeVec3(0, 0, 0));
+    return Length(d);
+}
+
+int BvhNearest(const Bvh& bvh, const Vec3& point, float maxDistance, float* distance) {
+    *distance = maxDistance;
+    if (bvh.nodes.empty()) return -1;
+    int nearest = -1;
+    int stack[BVH_STACK_SIZE];
+    float stackDistance[BVH_STACK_SIZE];
+    int top = 0;
+    stackDistance[top] = boxDistance(bvh.nodes[0].box, point);
+    stack[top++] = 0;
+
+    while (top > 0) {
+        top--;
+        if (stackDistance[top] >= *distance) continue;
+        const BvhNode& node = bvh.nodes[stack[top]];
+
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                float d = boxDistance(bvh.bounds[bvh.items[i]], point);
+                if (d < *distance) {
+                    *distance = d;
+                    nearest = bvh.items[i];
+                }
+            }
+            continue;
+        }
+
+        float dLeft = boxDistance(bvh.nodes[node.left].box, point);
+        float dRight = boxDistance(bvh.nodes[node.left + 1].box, point);
+        bool leftFirst = dLeft <= dRight;
+        stack[top] = leftFirst ? node.left + 1 : node.left;
+        stackDistance[top++] = leftFirst ? dRight : dLeft;
+        stack[top] = leftFirst ? node.left : node.left + 1;
+        stackDistance[top++] = leftFirst ? dLeft : dRight;
+    }
+    return nearest;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include "culling.h"
+
+// --- Bounding volume hierarchy ---
+// Binary tree over the bounding boxes of a set of objects, for queries that
+// would otherwise scan every object: frustum culling, ray casts and nearest
+// object lookups.
+//
+// The build splits top-down with the surface area heuristic, evaluated at
+// BVH_BINS positions per axis. Each node's objects are a contiguous range of
+// the items array, so a subtree entirely inside the frustum is accepted
+// without visiting it. Subtrees above BVH_PARALLEL_ITEMS objects are built
+// as jobs.
+//
+// Moved objects are refit instead of rebuilt: BvhMove marks the object's
+// leaf and its ancestors, and BvhRefit recomputes only the marked nodes.
+// The topology stays the same, so after large movements a rebuild gives
+// tighter trees.
+
+const int BVH_BINS = 16;
+const int BVH_LEAF_ITEMS = 4;       // Nodes this small are never split
+const int BVH_MAX_LEAF_ITEMS = 16;  // Larger nodes are always split
+const int BVH_PARALLEL_ITEMS = 4096;
+
+struct BvhNode {
+    Aabb box;
+    int first, count; // Range of items below this node
+    int left;         // First child, the second follows it; -1 for a leaf
+    int parent;       // -1 for the root
+};
+
+struct Bvh {
+    std::vector<BvhNode> nodes;     // Root first; children come after their parent
+    std::vector<int> items;         // Object indices, grouped by leaf
+    std::vector<Aabb> bounds;       // Per object
+    std::vector<int> leafOf;        // Object -> leaf node
+    std::vector<unsigned char> dirty; // Per node, marked by BvhMove
+    std::vector<int> dirtyNodes;
+};
+
+void BvhBuild(Bvh& bvh, const Aabb* bounds, int count);
+void BvhMove(Bvh& bvh, int object, const Aabb& box); // Takes effect at the next BvhRefit
+void BvhRefit(Bvh& bvh);                             // Cost grows with the number of moved objects
+
+// Appends the objects whose box touches the frustum, returns how many
+int BvhQueryFrustum(const Bvh& bvh, const Frustum& frustum, std::vector<int>& objects);
+
+// Appends the objects whose box overlaps box, returns how many
+int BvhQueryBox(const Bvh& bvh, const Aabb& box, std::vector<int>& objects);
+
+// Exact test of a ray against an object whose box the ray enters before
+// *t. Returns true and lowers *t when the object is hit closer.
+typedef bool (*BvhRayTest)(void* data, int object, const Vec3& origin, const Vec3& direction, float* t);
+
+// Closest object along the ray within maxT, -1 for none. Without a test,
+// objects are hit where the ray enters their box. direction need not be
+// normalized; t is in units of its length.
+int BvhRaycast(const Bvh& bvh, const Vec3& origin, const Vec3& direction, float maxT, BvhRayTest test, void* data,
+    float* t);
+
+// Object whose box is closest to point within maxDistance, -1 for none
+int BvhNearest(const Bvh& bvh, const Vec3& point, float maxDistance, float* distance);
@@ -0,0 +1,132 @@
+#include <math.h>
+#include <stdlib.h>
+#include "city.h"
+
+// Small LCG so the layout is the same on every platform and run
+static unsigned nextRandom(unsigned& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static float randomRange(unsigned& state, float low, float high) {
+    return low + (high - low) * (nextRandom(state) & 0xFFFF) / 65535.0f;
+}
+
+// Box around the world spheres of every part, in the model's own space
+static Aabb owlBounds(const OwlModel& owl) {
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+    Aabb box;
+    for (int i = 0; i < owl.numParts; i++) {
+        Vec3 center;
+        float radius;
+        TransformSphere(world[owl.parts[i].node], owl.parts[i].boundCenter, owl.parts[i].boundRadius, &center, &radius);
+        Vec3 extent = MakeVec3(radius, radius, radius);
+        box.min = i == 0 ? center - extent : Min(box.min, center - extent);
+        box.max = i == 0 ? center + extent : Max(box.max, center + extent);
+    }
+    return box;
+}
+
+static void addHouse(City& city, unsigned& state, float x, float z) {
+    CityHouse house;
+    house.floors = 1 + nextRandom(state) % CITY_MAX_FLOORS;
+    house.windowRepeat = 1 + nextRandom(state) % CITY_WINDOW_REPEATS;
+    for (int c = 0; c < 3; c++) house.roofColor[c] = randomRange(state, 0.2f, 0.9f);
+    float angle = (float)(nextRandom(state) % 4) * 90 + 45; // Walls parallel to the roads
+
+    // Same transforms as the house's first floor and roof nodes
+    house.world = MatIdentity();
+    MatTranslate(house.world, x, 0, z);
+    MatScale(house.world, 1, 17, 1);
+    MatRotate(house.world, angle, 0, 1, 0);
+
+    house.roofWorld = MatIdentity();
+    MatTranslate(house.roofWorld, x, 17 * house.floors, z);
+    MatRotate(house.roofWorld, angle, 0, 1, 0);
+    MatScale(house.roofWorld, 1, 7, 1);
+    city.houses.push_back(house);
+
+    float halfHeight = (17 * house.floors + 7) * 0.5f;
+    int index = CullSetAdd(city.cull);
+    CullSetSphere(city.cull, index, MakeVec3(x, halfHeight, z), sqrtf(17 * 17 + halfHeight * halfHeight));
+}
+
+// Standing on the ground, scaled so its bounding box has CITY_OWL_RADIUS as half diagonal
+static void addOwl(City& city, unsigned& state, const Aabb& bounds, float x, float z) {
+    Vec3 center = (bounds.min + bounds.max) * 0.5f;
+    float scale = CITY_OWL_RADIUS / Length(bounds.max - center);
+
+    CityOwl owl;
+    owl.world = MatIdentity();
+    MatTranslate(owl.world, x, (center.y - bounds.min.y) * scale, z);
+    MatRotate(owl.world, randomRange(state, 0, 360), 0, 1, 0);
+    MatScale(owl.world, scale, scale, scale);
+    MatTranslate(owl.world, -center.x, -center.y, -center.z);
+    city.owls.push_back(owl);
+}
+
+// A road along x (or z when alongZ) at the given offset, cut where it crosses the clear square
+static void addRoad(City& city, float offset, bool alongZ, float clear) {
+    float half = CITY_ROAD_WIDTH * 0.5f;
+    float spans[2][2] = { { -city.size, city.size }, { 0, 0 } };
+    int count = 1;
+    if (fabsf(offset) < clear) {
+        spans[0][1] = -clear;
+        spans[1][0] = clear;
+        spans[1][1] = city.size;
+        count = 2;
+    }
+    for (int i = 0; i < count; i++) {
+        Aabb road;
+        road.min = alongZ ? MakeVec3(offset - half, 0.1f, spans[i][0]) : MakeVec3(spans[i][0], 0.1f, offset - half);
+        road.max = alongZ ? MakeVec3(offset + half, 0.1f, spans[i][1]) : MakeVec3(spans[i][1], 0.1f, offset + half);
+        city.roads.push_back(road);
+    }
+}
+
+void CityGenerate(City& city, const OwlModel& owl, int count, unsigned seed, float clear) {
+    // Smallest odd grid with count blocks outside the clear square
+    int reserved = 2 * (int)ceilf((clear - CITY_BLOCK * 0.5f) / CITY_BLOCK) + 1;
+    if (reserved < 1) reserved = 1;
+    int blocks = reserved;
+    while (blocks * blocks - reserved * reserved < count) blocks += 2;
+
+    city.blocks = blocks;
+    city.size = blocks * CITY_BLOCK * 0.5f;
+    city.houses.clear();
+    city.owls.clear();
+    city.roads.clear();
+    city.cull = CullSet();
+
+    unsigned state = seed;
+    Aabb bounds = owlBounds(owl);
+    std::vector<Vec3> owlCenters; // Owl spheres go after every house's
+    int placed = 0;
+    for (int i = 0; i < blocks && placed < count; i++) {
+        for (int j = 0; j < blocks && placed < count; j++) {
+            int bi = i - blocks / 2, bj = j - blocks / 2;
+            if (abs(bi) <= reserved / 2 && abs(bj) <= reserved / 2) continue;
+
+            float jitter = (CITY_BLOCK - CITY_ROAD_WIDTH) * 0.5f - 20; // Keeps the largest footprint off the road
+            float x = bj * CITY_BLOCK + randomRange(state, -jitter, jitter);
+            float z = bi * CITY_BLOCK + randomRange(state, -jitter, jitter);
+            if (nextRandom(state) % CITY_OWL_EVERY == 0) {
+                addOwl(city, state, bounds, x, z);
+                owlCenters.push_back(MatTransformPoint(city.owls.back().world, (bounds.min + bounds.max) * 0.5f));
+            }
+            else addHouse(city, state, x, z);
+            placed++;
+        }
+    }
+    for (size_t i = 0; i < owlCenters.size(); i++) {
+        int index = CullSetAdd(city.cull);
+        CullSetSphere(city.cull, index, owlCenters[i], CITY_OWL_RADIUS);
+    }
+
+    // Block edges lie halfway between block centers
+    for (int k = 0; k <= blocks; k++) {
+        float offset = (k - blocks * 0.5f) * CITY_BLOCK;
+        addRoad(city, offset, false, clear);
+        addRoad(city, offset, true, clear);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include "culling.h"
+#include "owl_model.h"
+
+// --- Procedural city ---
+// A stress scene for seeing how frame time scales with object count: houses
+// and owls on a square grid of blocks, one per block, with a road along
+// every block edge. Houses get a random floor count, window repeat and roof
+// color; owls a random heading. A square around the origin is left empty
+// for the scene already there. The layout depends only on count and seed.
+
+const float CITY_BLOCK = 64;        // Distance between block centers, road included
+const float CITY_ROAD_WIDTH = 8;
+const float CITY_OWL_RADIUS = 15;   // Owls are scaled to about a two-floor house
+const int CITY_OWL_EVERY = 4;       // On average one block in this many holds an owl
+const int CITY_WINDOW_REPEATS = 5;  // Window repeats 1 to this, like the house slider
+const int CITY_MAX_FLOORS = 5;
+
+struct CityHouse {
+    Matrix4 world;      // Of the walls' first floor, like the house's floor node
+    Matrix4 roofWorld;
+    int floors;
+    int windowRepeat;
+    float roofColor[3];
+};
+
+struct CityOwl {
+    Matrix4 world;      // Applied on top of every part's world matrix
+};
+
+struct City {
+    int blocks;                    // Per side, odd so a block is centered on the origin
+    float size;                    // Half the side length
+    std::vector<CityHouse> houses;
+    std::vector<CityOwl> owls;
+    std::vector<Aabb> roads;       // Flat strips at road height
+    CullSet cull;                  // World spheres: every house, then every owl
+};
+
+// clear is the half size of the empty square around the origin
+void CityGenerate(City& city, const OwlModel& owl, int count, unsigned seed, float clear);
@@ -0,0 +1,172 @@
+#include <math.h>
+#include "collision.h"
+
+static void updateBounds(CollisionMesh& mesh) {
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+        mesh.bounds.min = i == 0 ? mesh.positions[i] : Min(mesh.bounds.min, mesh.positions[i]);
+        mesh.bounds.max = i == 0 ? mesh.positions[i] : Max(mesh.bounds.max, mesh.positions[i]);
+    }
+}
+
+// --- Meshes ---
+void CollisionMeshPrism(CollisionMesh& mesh, int sides, float topr, float bottomr) {
+    PrimitiveVertex quads[MAX_PRIMITIVE_SIDES * 4];
+    int count = PrimitivePrismVertices(sides, topr, bottomr, 1, quads);
+    mesh.positions.clear();
+    mesh.indices.clear();
+    mesh.positions.push_back(MakeVec3(0, 1, 0)); // Cap centers
+    mesh.positions.push_back(MakeVec3(0, 0, 0));
+
+    for (int i = 0; i < count; i += 4) {
+        int first = (int)mesh.positions.size();
+        int ring[2][2], top = 0, bottom = 0; // The quad's two top and two bottom corners
+        for (int k = 0; k < 4; k++) {
+            mesh.positions.push_back(MakeVec3(quads[i + k].x, quads[i + k].y, quads[i + k].z));
+            if (quads[i + k].y > 0.5f) ring[0][top++] = first + k;
+            else ring[1][bottom++] = first + k;
+        }
+        int side[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+        mesh.indices.insert(mesh.indices.end(), side, side + 6);
+        if (topr > 0 && top == 2) {
+            int cap[3] = { 0, ring[0][0], ring[0][1] };
+            mesh.indices.insert(mesh.indices.end(), cap, cap + 3);
+        }
+        if (bottomr > 0 && bottom == 2) {
+            int cap[3] = { 1, ring[1][0], ring[1][1] };
+            mesh.indices.insert(mesh.indices.end(), cap, cap + 3);
+        }
+    }
+    updateBounds(mesh);
+}
+
+void CollisionMeshQuad(CollisionMesh& mesh) {
+    Vec3 corners[4] = { { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 } };
+    int triangles[6] = { 0, 1, 2, 0, 2, 3 };
+    mesh.positions.assign(corners, corners + 4);
+    mesh.indices.assign(triangles, triangles + 6);
+    updateBounds(mesh);
+}
+
+void CollisionMeshAddPacked(CollisionMesh& mesh, const PackedMesh& packed, const Matrix4& transform) {
+    Matrix4 toMesh = MatMultiply(transform, QuantizationMatrix(packed.quantization));
+    int first = (int)mesh.positions.size();
+    for (int i = 0; i < packed.vertexCount; i++) {
+        const short* p = packed.vertexData[i].position;
+        mesh.positions.push_back(MatTransformPoint(toMesh, MakeVec3(p[0], p[1], p[2])));
+    }
+    for (int i = 0; i < packed.indexCount; i++) mesh.indices.push_back(first + packed.indexData[i]);
+    updateBounds(mesh);
+}
+
+// --- World ---
+int CollisionAdd(CollisionWorld& world, const CollisionMesh& mesh, const Matrix4& placement) {
+    Collider collider;
+    collider.world = placement;
+    collider.inverse = MatInverse(placement);
+    collider.mesh = &mesh;
+    collider.enabled = true;
+    world.colliders.push_back(collider);
+    return (int)world.colliders.size() - 1;
+}
+
+void CollisionBuild(CollisionWorld& world) {
+    std::vector<Aabb> bounds(world.colliders.size());
+    for (size_t i = 0; i < bounds.size(); i++)
+        bounds[i] = TransformAabb(world.colliders[i].world, world.colliders[i].mesh->bounds);
+    BvhBuild(world.bvh, bounds.data(), (int)bounds.size());
+    world.lastContacts = 0;
+}
+
+// --- Narrowphase ---
+// Closest point on triangle abc to p, by the Voronoi region p lies in (Ericson)
+static Vec3 closestOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c) {
+    Vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0) return a;
+
+    Vec3 bp = p - b;
+    float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+    Vec3 cp = p - c;
+    float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denominator = 1 / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+static bool overlaps(const Aabb& a, const Aabb& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y &&
+        a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// Deepest penetration of the sphere into one collider; only triangles whose
+// local bounds meet the sphere's local bounds are taken to world space
+static void deepestContact(const Collider& collider, const Vec3& center, float radius, float* depth, Vec3* push) {
+    const CollisionMesh& mesh = *collider.mesh;
+    Aabb local = TransformAabb(collider.inverse, SphereAabb(center, radius));
+
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const Vec3& a = mesh.positions[mesh.indices[i]];
+        const Vec3& b = mesh.positions[mesh.indices[i + 1]];
+        const Vec3& c = mesh.positions[mesh.indices[i + 2]];
+        Aabb triangle = { Min(Min(a, b), c), Max(Max(a, b), c) };
+        if (!overlaps(triangle, local)) continue;
+
+        Vec3 wa = MatTransformPoint(collider.world, a), wb = MatTransformPoint(collider.world, b);
+        Vec3 wc = MatTransformPoint(collider.world, c);
+        Vec3 closest = closestOnTriangle(center, wa, wb, wc);
+        Vec3 away = center - closest;
+        float distance = Length(away);
+        if (distance >= radius || radius - distance <= *depth) continue;
+
+        // Centered on the surface: out along the face normal, towards the side it came from
+        Vec3 normal = distance > 1e-6f ? away * (1 / distance) : Normalize(Cross(wb - wa, wc - wa));
+        *depth = radius - distance;
+        *push = normal * *depth;
+    }
+}
+
+static Vec3 resolve(CollisionWorld& world, Vec3 center, float radius) {
+    for (int iteration = 0; iteration < COLLISION_ITERATIONS; iteration++) {
+        world.candidates.clear();
+        BvhQueryBox(world.bvh, SphereAabb(center, radius), world.candidates);
+
+        float depth = 0;
+        Vec3 push = MakeVec3(0, 0, 0);
+        for (size_t i = 0; i < world.candidates.size(); i++) {
+            const Collider& collider = world.colliders[world.candidates[i]];
+            if (collider.enabled) deepestContact(collider, center, radius, &depth, &push);
+        }
+        if (depth <= 0) break;
+        center = center + push * 1.001f; // Just clear of the surface
+        world.lastContacts++;
+    }
+    return center;
+}
+
+Vec3 CollisionMove(CollisionWorld& world, const Vec3& from, const Vec3& to, float radius) {
+    world.lastContacts = 0;
+    Vec3 move = to - from;
+    float length = Length(move), step = radius * 0.5f;
+    if (length > step * COLLISION_MAX_STEPS) { // Cut short rather than take steps that could tunnel
+        move = move * (step * COLLISION_MAX_STEPS / length);
+        length = step * COLLISION_MAX_STEPS;
+    }
+    int steps = (int)ceilf(length / step);
+    if (steps < 1) steps = 1;
+
+    Vec3 center = from;
+    for (int i = 0; i < steps; i++) center = resolve(world, center + move * (1.0f / steps), radius);
+    return center;
+}
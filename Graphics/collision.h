@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include "bvh.h"
+#include "primitives.h"
+#include "vertex_format.h"
+
+// --- Camera collision ---
+// The camera is a sphere moved against the triangles the scene draws. A
+// BVH over every collider's world bounds finds the few colliders near the
+// sphere, so the cost per move does not grow with the scene. Each of
+// those is tested exactly, triangle by triangle, using the closest point
+// on each triangle.
+//
+// A move is cut into steps of half the radius so walls are not skipped,
+// and at most COLLISION_MAX_STEPS of them bound the cost. After each step
+// the sphere is pushed out along the deepest contact's normal a few times.
+// What remains of the move runs along the surface, so the camera slides
+// along walls instead of stopping.
+//
+// Colliders share meshes in local space and are placed by an invertible
+// world matrix. Parts flattened to zero thickness are baked into a world
+// space mesh with an identity world instead.
+
+const int COLLISION_ITERATIONS = 4;  // Push-outs per step, enough for corners
+const int COLLISION_MAX_STEPS = 16;  // Steps per move; longer moves are cut short
+
+struct CollisionMesh {
+    std::vector<Vec3> positions;
+    std::vector<int> indices;  // Triangles
+    Aabb bounds;
+};
+
+struct Collider {
+    Matrix4 world, inverse;
+    const CollisionMesh* mesh;
+    bool enabled;              // Switched by the owner, e.g. floors above the current count
+};
+
+struct CollisionWorld {
+    std::vector<Collider> colliders;
+    Bvh bvh;                   // Over the colliders' world bounds, built by CollisionBuild
+    std::vector<int> candidates;
+    int lastContacts;          // Push-outs during the last CollisionMove
+};
+
+// DrawCylinder1's prism from y = 0 to 1, closed with caps
+void CollisionMeshPrism(CollisionMesh& mesh, int sides, float topr, float bottomr);
+void CollisionMeshQuad(CollisionMesh& mesh); // The unit quad in z = 0
+// Appends a packed mesh's triangles, moved by transform
+void CollisionMeshAddPacked(CollisionMesh& mesh, const PackedMesh& packed, const Matrix4& transform);
+
+int CollisionAdd(CollisionWorld& world, const CollisionMesh& mesh, const Matrix4& placement); // Returns the index
+void CollisionBuild(CollisionWorld& world); // After every CollisionAdd
+
+// Where a sphere moving from from to to ends up
+Vec3 CollisionMove(CollisionWorld& world, const Vec3& from, const Vec3& to, float radius);
@@ -0,0 +1,149 @@
+#include <atomic>
+#include "culling.h"
+#include "jobs.h"
+
+// Fewest spheres per job; a multiple of four keeps every range on the SIMD path
+static const int CULL_GRAIN = 1024;
+static const int CULL_JOBS_PER_WORKER = 4; // Large sets are cut into this many ranges per worker
+
+struct CullTask {
+    const Frustum* frustum;
+    CullSet* set;
+    std::atomic<int> visible;
+};
+
+static void cullRange(void* data, int begin, int end) {
+    CullTask* task = (CullTask*)data;
+    CullSet& set = *task->set;
+    task->visible += CullSpheres(*task->frustum, &set.x[begin], &set.y[begin], &set.z[begin], &set.radius[begin],
+        end - begin, &set.visible[begin]);
+}
+
+// --- Frustum ---
+Frustum FrustumFromMatrix(const Matrix4& viewProjection) {
+    const float* m = viewProjection.m;
+    Frustum f;
+
+    // Rows of the column-major matrix combined (Gribb & Hartmann)
+    for (int i = 0; i < 3; i++) {
+        f.planes[i * 2 + 0] = MakeVec4(m[3] + m[i], m[7] + m[4 + i], m[11] + m[8 + i], m[15] + m[12 + i]);
+        f.planes[i * 2 + 1] = MakeVec4(m[3] - m[i], m[7] - m[4 + i], m[11] - m[8 + i], m[15] - m[12 + i]);
+    }
+    for (int i = 0; i < 6; i++) {
+        Vec4& p = f.planes[i];
+        float len = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        p.x /= len; p.y /= len; p.z /= len; p.w /= len;
+    }
+    return f;
+}
+
+bool FrustumTestSphere(const Frustum& frustum, const Vec3& center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        const Vec4& p = frustum.planes[i];
+        if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) return false;
+    }
+    return true;
+}
+
+bool FrustumTestAabb(const Frustum& frustum, const Aabb& box) {
+    for (int i = 0; i < 6; i++) {
+        const Vec4& p = frustum.planes[i];
+        // Corner furthest along the plane normal
+        float x = p.x >= 0 ? box.max.x : box.min.x;
+        float y = p.y >= 0 ? box.max.y : box.min.y;
+        float z = p.z >= 0 ? box.max.z : box.min.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0) return false;
+    }
+    return true;
+}
+
+// --- Bounds ---
+void TransformSphere(const Matrix4& world, const Vec3& center, float radius, Vec3* outCenter, float* outRadius) {
+    const float* m = world.m;
+    float sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    float sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+    float sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+    float maxScale = sx > sy ? (sx > sz ? sx : sz) : (sy > sz ? sy : sz);
+
+    *outCenter = MatTransformPoint(world, center);
+    *outRadius = radius * sqrtf(maxScale);
+}
+
+Aabb TransformAabb(const Matrix4& world, const Aabb& box) {
+    Vec3 center = MatTransformPoint(world, (box.min + box.max) * 0.5f);
+    Vec3 half = (box.max - box.min) * 0.5f;
+    const float* m = world.m;
+    Vec3 extent = MakeVec3(
+        fabsf(m[0]) * half.x + fabsf(m[4]) * half.y + fabsf(m[8]) * half.z,
+        fabsf(m[1]) * half.x + fabsf(m[5]) * half.y + fabsf(m[9]) * half.z,
+        fabsf(m[2]) * half.x + fabsf(m[6]) * half.y + fabsf(m[10]) * half.z);
+    Aabb r = { center - extent, center + extent };
+    return r;
+}
+
+// --- Batched sphere culling ---
+int CullSetAdd(CullSet& set) {
+    set.x.push_back(0);
+    set.y.push_back(0);
+    set.z.push_back(0);
+    set.radius.push_back(0);
+    set.visible.push_back(1);
+    return (int)set.x.size() - 1;
+}
+
+void CullSetSphere(CullSet& set, int index, const Vec3& center, float radius) {
+    set.x[index] = center.x;
+    set.y[index] = center.y;
+    set.z[index] = center.z;
+    set.radius[index] = radius;
+}
+
+// Large sets are split across the job system
+int CullSetRun(CullSet& set, const Frustum& frustum) {
+    CullTask task;
+    task.frustum = &frustum;
+    task.set = &set;
+    task.visible = 0;
+    int count = (int)set.x.size();
+    int grain = count / (JobsWorkerCount() * CULL_JOBS_PER_WORKER) / 4 * 4;
+    JobParallelFor(count, grain > CULL_GRAIN ? grain : CULL_GRAIN, cullRange, &task);
+    return task.visible;
+}
+
+int CullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+    int count, unsigned char* visible) {
+    int numVisible = 0, i = 0;
+
+#ifdef VECMATH_SSE
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    for (; i + 4 <= count; i += 4) { // Four spheres against all planes at once
+        __m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+                                  _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++) {
+            visible[i + k] = (mask >> k) & 1;
+            numVisible += visible[i + k];
+        }
+    }
+#endif
+    for (; i < count; i++) { // Remainder
+        visible[i] = FrustumTestSphere(frustum, MakeVec3(x[i], y[i], z[i]), radius[i]);
+        numVisible += visible[i];
+    }
+    return numVisible;
+}
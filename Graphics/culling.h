@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include "vecmath.h"
+
+// --- Frustum culling ---
+// Planes are extracted from a view-projection matrix; a point p is inside
+// when dot(plane.xyz, p) + plane.w >= 0 for all six planes.
+
+struct Frustum {
+    Vec4 planes[6]; // Left, right, bottom, top, near, far (normalized)
+};
+
+// Axis-aligned bounding box
+struct Aabb {
+    Vec3 min, max;
+};
+
+inline Aabb SphereAabb(const Vec3& center, float radius) {
+    Aabb box = { center - MakeVec3(radius, radius, radius), center + MakeVec3(radius, radius, radius) };
+    return box;
+}
+
+// Bounding spheres of a set of objects, stored as arrays so they can be
+// tested four at a time
+struct CullSet {
+    std::vector<float> x, y, z, radius;
+    std::vector<unsigned char> visible; // Result of the last CullSetRun
+};
+
+Frustum FrustumFromMatrix(const Matrix4& viewProjection);
+bool FrustumTestSphere(const Frustum& frustum, const Vec3& center, float radius);
+bool FrustumTestAabb(const Frustum& frustum, const Aabb& box);
+
+// World-space sphere of a local sphere under a (possibly non-uniformly scaled) transform
+void TransformSphere(const Matrix4& world, const Vec3& center, float radius, Vec3* outCenter, float* outRadius);
+Aabb TransformAabb(const Matrix4& world, const Aabb& box);
+
+int CullSetAdd(CullSet& set); // Returns the new object's index
+void CullSetSphere(CullSet& set, int index, const Vec3& center, float radius);
+int CullSetRun(CullSet& set, const Frustum& frustum); // Returns how many are visible
+int CullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+    int count, unsigned char* visible); // Batched test, returns how many are visible
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <string.h>
+#include "glew.h"
+#include "glut.h"
+#include "draw_queue.h"
+#include "gpu_ring.h"
+
+// Packets per frame the uniform ring is sized for; busier frames use the fixed-function path
+static const int RING_MAX_PACKETS = 4096;
+
+// std140 blocks shared with the shader below
+struct FrameBlock {
+    float viewProjection[16];
+};
+
+struct ObjectBlock {
+    float world[16];
+    float color[4];
+    float flags[4]; // x: sample the bound texture instead of color
+};
+
+static const char* VERTEX_SHADER =
+    "#version 130\n"
+    "#extension GL_ARB_uniform_buffer_object : require\n"
+    "layout(std140) uniform Frame { mat4 viewProjection; };\n"
+    "layout(std140) uniform Object { mat4 world; vec4 color; vec4 flags; };\n"
+    "out vec2 texCoord;\n"
+    "void main() {\n"
+    "    // The modelview stack only holds transforms the geometry itself pushes\n"
+    "    gl_Position = viewProjection * world * gl_ModelViewMatrix * gl_Vertex;\n"
+    "    texCoord = gl_MultiTexCoord0.xy;\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER =
+    "#version 130\n"
+    "#extension GL_ARB_uniform_buffer_object : require\n"
+    "layout(std140) uniform Object { mat4 world; vec4 color; vec4 flags; };\n"
+    "uniform sampler2D image;\n"
+    "in vec2 texCoord;\n"
+    "void main() {\n"
+    "    gl_FragColor = flags.x > 0.5 ? texture(image, texCoord) : color;\n"
+    "}\n";
+
+static GpuRing uniformRing;
+static GLuint program = 0;
+static GLsizeiptr objectStride = 0; // sizeof(ObjectBlock) rounded up to the binding alignment
+static bool ringReady = false;
+
+// Key layout, high to low: material (8 bits), texture (16 bits), depth (32 bits)
+static unsigned long long makeKey(DrawMaterial material, unsigned texture, float depth) {
+    if (!(depth > 0)) depth = 0;  // Also catches NaN
+    unsigned depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits)); // Positive floats order like their bit patterns
+
+    return ((unsigned long long)material << 48) | ((unsigned long long)(texture & 0xFFFF) << 32) | depthBits;
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool DrawQueueInitRing() {
+    if (!GLEW_ARB_uniform_buffer_object || !GLEW_VERSION_3_0) return false;
+
+    GLuint vertex = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+    GLuint fragment = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    if (vertex && fragment) {
+        program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (vertex) glDeleteShader(vertex);
+    if (fragment) glDeleteShader(fragment);
+    if (!program) return false;
+
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Frame"), 0);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Object"), 1);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "image"), 0);
+    glUseProgram(0);
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    objectStride = (sizeof(ObjectBlock) + alignment - 1) / alignment * alignment;
+
+    ringReady = GpuRingInit(uniformRing, GL_UNIFORM_BUFFER, objectStride * (RING_MAX_PACKETS + 1), alignment);
+    if (!ringReady) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    return ringReady;
+}
+
+bool DrawQueueUsesRing() {
+    return ringReady;
+}
+
+int DrawQueueRingStalls() {
+    return ringReady ? uniformRing.stalls : 0;
+}
+
+struct KeyLess {
+    const DrawPacket* packets;
+    bool operator()(int a, int b) const { return packets[a].key < packets[b].key; }
+};
+
+void DrawQueueBegin(DrawQueue& queue, const Matrix4& projection, const Matrix4& view) {
+    queue.view = view;
+    queue.viewProjection = MatMultiply(projection, view);
+    queue.packets.reset(); // Last frame's packets stay in the other arena
+    queue.order = 0;
+}
+
+DrawPacket& DrawQueueAdd(DrawQueue& queue, DrawMaterial material, unsigned texture, const Vec3& position,
+    DrawGeometry geometry) {
+    queue.packets.push_back(DrawPacket());
+    DrawPacket& packet = queue.packets.back();
+
+    float depth = -MatTransformPoint(queue.view, position).z; // Distance in front of the eye
+    packet.key = makeKey(material, material == MATERIAL_TEXTURE ? texture : 0, depth);
+    packet.material = material;
+    packet.texture = texture;
+    packet.color[0] = packet.color[1] = packet.color[2] = 1;
+    packet.hasWorld = false;
+    packet.world = MatIdentity();
+    packet.geometry = geometry;
+    packet.params[0] = packet.params[1] = packet.params[2] = packet.params[3] = 0;
+    return packet;
+}
+
+void DrawQueueSubmit(DrawQueue& queue) {
+    int count = queue.packets.size();
+    queue.order = FrameAllocArray<int>(count);
+    for (int i = 0; i < count; i++) queue.order[i] = i;
+
+    KeyLess less = { queue.packets.data };
+    std::sort(queue.order, queue.order + count, less);
+
+    // Camera for the whole frame, written once into the ring
+    bool useRing = ringReady && count <= RING_MAX_PACKETS;
+    if (useRing) {
+        GpuRingBeginFrame(uniformRing);
+        GLintptr offset;
+        FrameBlock* block = (FrameBlock*)GpuRingAlloc(uniformRing, sizeof(FrameBlock), &offset);
+        memcpy(block->viewProjection, queue.viewProjection.m, sizeof(block->viewProjection));
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, uniformRing.buffer, offset, sizeof(FrameBlock));
+
+        glUseProgram(program);
+        glPushMatrix(); // World matrices come from the ring; the stack starts empty for the geometry
+        glLoadIdentity();
+    }
+
+    int material = -1;
+    unsigned texture = 0;
+    float color[3] = { -1, -1, -1 };
+    int changes = 0;
+
+    for (int i = 0; i < count; i++) {
+        const DrawPacket& packet = queue.packets[queue.order[i]];
+
+        if (packet.material != material) {
+            if (packet.material == MATERIAL_TEXTURE) {
+                glEnable(GL_TEXTURE_2D);
+                glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+            }
+            else {
+                glDisable(GL_TEXTURE_2D);
+            }
+            material = packet.material;
+            texture = 0; // Rebind after a material switch
+            changes++;
+        }
+        if (material == MATERIAL_TEXTURE && packet.texture != texture) {
+            glBindTexture(GL_TEXTURE_2D, packet.texture);
+            texture = packet.texture;
+            changes++;
+        }
+
+        if (useRing) { // Per-object data goes straight into mapped memory
+            GLintptr offset;
+            ObjectBlock* block = (ObjectBlock*)GpuRingAlloc(uniformRing, sizeof(ObjectBlock), &offset);
+            memcpy(block->world, packet.world.m, sizeof(block->world));
+            block->color[0] = packet.color[0];
+            block->color[1] = packet.color[1];
+            block->color[2] = packet.color[2];
+            block->color[3] = 1;
+            block->flags[0] = packet.material == MATERIAL_TEXTURE ? 1.0f : 0.0f;
+            glBindBufferRange(GL_UNIFORM_BUFFER, 1, uniformRing.buffer, offset, sizeof(ObjectBlock));
+            packet.geometry(packet);
+            continue;
+        }
+
+        if (memcmp(color, packet.color, sizeof(color)) != 0) {
+            glColor3fv(packet.color);
+            memcpy(color, packet.color, sizeof(color));
+            changes++;
+        }
+
+        if (packet.hasWorld) {
+            glPushMatrix();
+            glMultMatrixf(packet.world.m);
+        }
+        packet.geometry(packet);
+        if (packet.hasWorld) glPopMatrix();
+    }
+
+    if (useRing) {
+        glPopMatrix();
+        glUseProgram(0);
+        GpuRingEndFrame(uniformRing);
+    }
+    glDisable(GL_TEXTURE_2D); // Scene code outside the queue expects texturing off
+    queue.lastStateChanges = changes;
+}
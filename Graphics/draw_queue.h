@@ -0,0 +1,63 @@
+#pragma once
+#include "frame_arena.h"
+#include "vecmath.h"
+
+// --- Draw command queue ---
+// Scene code records one packet per object instead of drawing directly.
+// Submission sorts the packets by a key of (material, texture, depth), so
+// each material and texture is set up once and opaque objects within it go
+// front to back for early depth rejection. GL state is only touched when it
+// actually differs from the previous packet.
+//
+// With ARB_buffer_storage, the camera and each packet's world matrix and
+// color are written straight into a persistently mapped uniform ring and
+// read by a small shader; otherwise packets go through the fixed-function
+// matrix stack as before.
+
+enum DrawMaterial {
+    MATERIAL_COLOR,   // Flat color, no texture
+    MATERIAL_TEXTURE  // Texture replaces the color
+};
+
+struct DrawPacket;
+typedef void (*DrawGeometry)(const DrawPacket& packet); // Issues the vertices, state is already set
+
+struct DrawPacket {
+    unsigned long long key;
+    DrawMaterial material;
+    unsigned texture;     // Bound for MATERIAL_TEXTURE
+    float color[3];
+    bool hasWorld;        // Geometry is in local space, placed by world
+    Matrix4 world;
+    DrawGeometry geometry;
+    double params[4];     // Free for the geometry callback
+};
+
+// Packets and the sort order live in the per-frame arena
+struct DrawQueue {
+    Matrix4 view;                    // Of the frame being recorded, for depth
+    Matrix4 viewProjection;
+    FrameArray<DrawPacket> packets;
+    int* order;                      // Sorted packet indices
+    int lastStateChanges;            // Material, texture and color changes of the last submit
+};
+
+bool DrawQueueInitRing(); // After glewInit; false keeps the fixed-function path
+bool DrawQueueUsesRing();
+int DrawQueueRingStalls(); // Frames that waited on the GPU for ring space
+void DrawQueueBegin(DrawQueue& queue, const Matrix4& projection, const Matrix4& view); // After FrameArenaBeginFrame
+// position is a world-space point of the object (its bounds center) used for depth sorting
+DrawPacket& DrawQueueAdd(DrawQueue& queue, DrawMaterial material, unsigned texture, const Vec3& position,
+    DrawGeometry geometry);
+void DrawQueueSubmit(DrawQueue& queue); // Sorts and draws everything recorded since DrawQueueBegin
+
+inline void DrawPacketColor(DrawPacket& packet, double r, double g, double b) {
+    packet.color[0] = (float)r;
+    packet.color[1] = (float)g;
+    packet.color[2] = (float)b;
+}
+
+inline void DrawPacketWorld(DrawPacket& packet, const Matrix4& world) {
+    packet.world = world;
+    packet.hasWorld = true;
+}
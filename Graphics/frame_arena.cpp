@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stdlib.h>
+#if defined(_DEBUG) && defined(_MSC_VER)
+#include <crtdbg.h>
+#endif
+#include "frame_arena.h"
+
+static const int MAX_ARENA_THREADS = 64;
+static const int SHARED_SLOT = MAX_ARENA_THREADS - 1; // Taken in turns by threads beyond the others
+static const size_t SUB_ARENA_BYTES = 256 * 1024; // Initial size of each thread's block
+
+// Blocks borrowed when a sub-arena runs out, freed when it is recycled
+struct OverflowBlock {
+    OverflowBlock* next;
+    size_t capacity, used; // Bytes after the header
+};
+
+struct SubArena {
+    char* base;
+    size_t capacity, used;
+    OverflowBlock* overflow; // Newest first
+    size_t overflowBytes;    // Allocated from overflow blocks this frame
+};
+
+static SubArena arenas[2][MAX_ARENA_THREADS]; // [frame parity][thread slot]
+static std::atomic<int> current(0);
+static std::atomic<bool> slotTaken[SHARED_SLOT];
+static std::mutex sharedSlotLock;
+
+// A thread's slot, given back when the thread exits so pools that are
+// restarted (JobsBenchmark) do not use up the slots. The sub-arenas keep
+// their contents; the next owner just continues after them.
+struct ThreadSlot {
+    int index;
+    ThreadSlot() : index(-1) {}
+    ~ThreadSlot() {
+        if (index >= 0 && index < SHARED_SLOT) slotTaken[index].store(false, std::memory_order_release);
+    }
+};
+static thread_local ThreadSlot slot;
+
+static size_t lastFrameBytes = 0;
+static size_t peakBytes = 0;
+static bool checkSkipped = false;
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Offset of the next free, aligned byte after an overflow block's header
+static size_t overflowOffset(const OverflowBlock* block, size_t alignment) {
+    size_t data = (size_t)(block + 1);
+    return alignUp(data + block->used, alignment) - data;
+}
+
+#ifdef _DEBUG
+// Debug builds count heap allocations for the steady-state check: heap
+// allocations per thread, since only the render thread's frame loop is
+// held to it, and the arenas' own blocks from every thread
+static thread_local unsigned long heapAllocations = 0;
+static std::atomic<unsigned long> arenaAllocations(0);
+
+#ifdef _MSC_VER
+// The debug CRT reports every malloc, calloc and realloc, operator new's included
+static int countAllocation(int type, void*, size_t, int, long, const unsigned char*, int) {
+    if (type == _HOOK_ALLOC || type == _HOOK_REALLOC) heapAllocations++;
+    return 1; // Let the allocation go ahead
+}
+
+static const _CRT_ALLOC_HOOK previousHook = _CrtSetAllocHook(countAllocation);
+#else
+// Elsewhere only operator new can be replaced portably, so C allocations go uncounted
+void* operator new(size_t size) {
+    heapAllocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+#endif
+#endif
+
+static void* arenaMalloc(size_t bytes) {
+#ifdef _DEBUG
+    arenaAllocations.fetch_add(1, std::memory_order_relaxed);
+#endif
+    return malloc(bytes);
+}
+
+static int takeSlot() {
+    for (int i = 0; i < SHARED_SLOT; i++) {
+        bool expected = false;
+        if (!slotTaken[i].load(std::memory_order_relaxed) && slotTaken[i].compare_exchange_strong(expected, true))
+            return i;
+    }
+    return SHARED_SLOT;
+}
+
+// Frees the overflow blocks and grows the main block to hold everything the frame needed
+static void recycle(SubArena& arena) {
+    size_t total = arena.used + arena.overflowBytes;
+
+    while (arena.overflow) {
+        OverflowBlock* next = arena.overflow->next;
+        free(arena.overflow);
+        arena.overflow = next;
+    }
+    if (arena.overflowBytes > 0) {
+        free(arena.base);
+        arena.capacity = alignUp(total * 2, SUB_ARENA_BYTES);
+        arena.base = (char*)arenaMalloc(arena.capacity);
+    }
+    arena.used = 0;
+    arena.overflowBytes = 0;
+}
+
+void FrameArenaBeginFrame() {
+    int previous = current.load(std::memory_order_relaxed);
+    int next = 1 - previous;
+
+    size_t bytes = 0;
+    for (int i = 0; i < MAX_ARENA_THREADS; i++) {
+        const SubArena& arena = arenas[previous][i];
+        bytes += arena.used + arena.overflowBytes;
+    }
+    lastFrameBytes = bytes;
+    if (bytes > peakBytes) peakBytes = bytes;
+
+    // Everything from two frames ago goes
+    for (int i = 0; i < MAX_ARENA_THREADS; i++) recycle(arenas[next][i]);
+    current.store(next, std::memory_order_release);
+
+#ifdef _DEBUG
+    static unsigned long heapAtFrameStart = 0, arenaAtFrameStart = 0;
+    static int frameNumber = 0;
+    const int WARM_UP_FRAMES = 120; // Caches, vectors and the arenas settle first
+
+    // Steady state: a whole frame on this (the render) thread must not have
+    // allocated from the C++ heap, nor any thread's arena have needed a block
+    unsigned long heap = heapAllocations, arena = arenaAllocations.load();
+    assert((frameNumber < WARM_UP_FRAMES || checkSkipped || (heap == heapAtFrameStart && arena == arenaAtFrameStart)) &&
+        "heap allocation during a steady-state frame");
+    heapAtFrameStart = heap;
+    arenaAtFrameStart = arena;
+    frameNumber++;
+#endif
+    checkSkipped = false;
+}
+
+void FrameArenaSkipCheck() {
+    checkSkipped = true;
+}
+
+void* FrameAlloc(size_t bytes, size_t alignment) {
+    if (slot.index < 0) slot.index = takeSlot();
+    std::unique_lock<std::mutex> shared;
+    if (slot.index == SHARED_SLOT) shared = std::unique_lock<std::mutex>(sharedSlotLock);
+    SubArena& arena = arenas[current.load(std::memory_order_acquire)][slot.index];
+
+    if (!arena.base) { // First use of this slot
+        arena.capacity = SUB_ARENA_BYTES;
+        arena.base = (char*)arenaMalloc(arena.capacity);
+    }
+
+    size_t offset = alignUp(arena.used, alignment);
+    if (offset + bytes <= arena.capacity) {
+        arena.used = offset + bytes;
+        return arena.base + offset;
+    }
+
+    // Out of room: continue in an overflow block until the arena is recycled
+    OverflowBlock* block = arena.overflow;
+    size_t start = block ? overflowOffset(block, alignment) : 0;
+    if (!block || start + bytes > block->capacity) {
+        size_t capacity = bytes + alignment > arena.capacity ? bytes + alignment : arena.capacity;
+        block = (OverflowBlock*)arenaMalloc(sizeof(OverflowBlock) + capacity);
+        block->next = arena.overflow;
+        block->capacity = capacity;
+        block->used = 0;
+        arena.overflow = block;
+        start = overflowOffset(block, alignment);
+    }
+    arena.overflowBytes += start + bytes - block->used;
+    block->used = start + bytes;
+    return (char*)(block + 1) + start;
+}
+
+size_t FrameArenaLastFrameBytes() {
+    return lastFrameBytes;
+}
+
+size_t FrameArenaPeakBytes() {
+    return peakBytes;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <stddef.h>
+#include <string.h>
+
+// --- Per-frame arena ---
+// Transient render data (draw packets, sort keys, staging) is bump-allocated
+// from a linear arena and never freed individually. There are two arenas,
+// used on alternate frames, so data written in one frame stays valid
+// through the next. Each thread, job workers included, allocates from its
+// own sub-arena without locking. A sub-arena that runs out borrows an
+// overflow block for the rest of the frame and is resized when it is
+// recycled, so after a few frames the arenas fit the scene and steady-state
+// frames touch neither malloc nor the C++ heap. Debug builds assert that for
+// the render thread's heap allocations and every thread's arena blocks. With
+// MSVC's debug CRT every malloc, realloc and new is counted; elsewhere only
+// operator new is. Release builds do not check.
+
+void FrameArenaBeginFrame(); // Render thread, once per frame while no jobs are running
+void FrameArenaSkipCheck();  // The next frame is not held to the steady-state check (a poster ran in it)
+void* FrameAlloc(size_t bytes, size_t alignment = 16);
+
+size_t FrameArenaLastFrameBytes(); // Used by the previous frame, all threads together
+size_t FrameArenaPeakBytes();      // Most any frame has used so far
+
+template <typename T>
+T* FrameAllocArray(int count) {
+    return (T*)FrameAlloc(sizeof(T) * count, alignof(T));
+}
+
+// Growable list in frame memory for per-frame data of unknown size. Elements
+// are moved with memcpy, so T must be trivially copyable. The storage is
+// gone two frames later; reset() the list before reusing it.
+template <typename T>
+struct FrameArray {
+    T* data;
+    int count, capacity;
+
+    FrameArray() : data(0), count(0), capacity(0) {}
+
+    void reset() { data = 0; count = capacity = 0; } // The arena reclaims the old storage
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](int i) { return data[i]; }
+    const T& operator[](int i) const { return data[i]; }
+    T& back() { return data[count - 1]; }
+
+    void push_back(const T& item) {
+        if (count == capacity) {
+            int grown = capacity ? capacity * 2 : 64;
+            T* bigger = FrameAllocArray<T>(grown);
+            if (count) memcpy(bigger, data, sizeof(T) * count);
+            data = bigger;
+            capacity = grown;
+        }
+        data[count++] = item;
+    }
+};
@@ -0,0 +1,77 @@
+#include "gpu_ring.h"
+
+// Longest wait for a region before giving up on the fence, in nanoseconds
+static const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+bool GpuRingInit(GpuRing& ring, GLenum target, GLsizeiptr bytesPerFrame, GLint alignment) {
+    ring.buffer = 0;
+    ring.mapped = 0;
+    if (!GLEW_ARB_buffer_storage || !(GLEW_ARB_sync || GLEW_VERSION_3_2)) return false;
+
+    ring.target = target;
+    ring.alignment = alignment > 0 ? alignment : 1;
+    ring.regionSize = (bytesPerFrame + ring.alignment - 1) / ring.alignment * ring.alignment;
+    ring.head = 0;
+    ring.region = 0;
+    ring.stalls = 0;
+    for (int i = 0; i < GPU_RING_FRAMES; i++) ring.fences[i] = 0;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &ring.buffer);
+    glBindBuffer(target, ring.buffer);
+    glBufferStorage(target, ring.regionSize * GPU_RING_FRAMES, 0, flags);
+    ring.mapped = (unsigned char*)glMapBufferRange(target, 0, ring.regionSize * GPU_RING_FRAMES, flags);
+    glBindBuffer(target, 0);
+
+    if (!ring.mapped) {
+        GpuRingRelease(ring);
+        return false;
+    }
+    return true;
+}
+
+void GpuRingBeginFrame(GpuRing& ring) {
+    ring.region = (ring.region + 1) % GPU_RING_FRAMES;
+    ring.head = 0;
+
+    GLsync fence = ring.fences[ring.region];
+    if (!fence) return;
+
+    // Usually signaled long ago; only block when the GPU is a full ring behind
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        ring.stalls++;
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    }
+    glDeleteSync(fence);
+    ring.fences[ring.region] = 0;
+}
+
+void* GpuRingAlloc(GpuRing& ring, GLsizeiptr bytes, GLintptr* offset) {
+    GLsizeiptr start = (ring.head + ring.alignment - 1) / ring.alignment * ring.alignment;
+    if (start + bytes > ring.regionSize) return 0;
+
+    ring.head = start + bytes;
+    *offset = ring.region * ring.regionSize + start;
+    return ring.mapped + *offset;
+}
+
+void GpuRingEndFrame(GpuRing& ring) {
+    ring.fences[ring.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void GpuRingRelease(GpuRing& ring) {
+    for (int i = 0; i < GPU_RING_FRAMES; i++) {
+        if (ring.fences[i]) glDeleteSync(ring.fences[i]);
+        ring.fences[i] = 0;
+    }
+    if (ring.buffer) {
+        if (ring.mapped) {
+            glBindBuffer(ring.target, ring.buffer);
+            glUnmapBuffer(ring.target);
+            glBindBuffer(ring.target, 0);
+        }
+        glDeleteBuffers(1, &ring.buffer);
+    }
+    ring.buffer = 0;
+    ring.mapped = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "glew.h"
+
+// --- Persistently mapped ring buffer ---
+// One buffer object is created with ARB_buffer_storage and stays mapped
+// for its whole life, so per-frame data is written straight into memory
+// the GPU reads from, with no glBufferData/glBufferSubData and no copies.
+// The buffer is split into one region per frame in flight. A fence is set
+// when a frame's commands have been issued, and the region is only written
+// again after that fence has signaled. With three regions the wait
+// normally finds the fence already signaled and costs nothing.
+
+const int GPU_RING_FRAMES = 3;
+
+struct GpuRing {
+    GLuint buffer;
+    GLenum target;
+    unsigned char* mapped;          // Write-only, coherent
+    GLsizeiptr regionSize;
+    GLsizeiptr head;                // Next free byte in the current region
+    int region;
+    GLsync fences[GPU_RING_FRAMES];
+    GLint alignment;                // Of every allocation
+    int stalls;                     // Frames that had to wait for the GPU
+};
+
+// False without ARB_buffer_storage and ARB_sync; the caller keeps its old path then
+bool GpuRingInit(GpuRing& ring, GLenum target, GLsizeiptr bytesPerFrame, GLint alignment);
+void GpuRingBeginFrame(GpuRing& ring); // Waits only if the GPU is still reading this region
+// Space for this frame's data and its offset in the buffer; 0 when the region is full
+void* GpuRingAlloc(GpuRing& ring, GLsizeiptr bytes, GLintptr* offset);
+void GpuRingEndFrame(GpuRing& ring); // After the frame's draw calls are issued
+void GpuRingRelease(GpuRing& ring);
@@ -0,0 +1,376 @@
+#include <string.h>
+#include "culling.h"
+#include "gpu_scene.h"
+
+// Threads per compute work group; one object each
+static const int CULL_GROUP_SIZE = 64;
+static const GLuint64 FENCE_TIMEOUT = 1000000000; // Longest wait for a counter's draw, in nanoseconds
+
+// Layout of one glMultiDrawElementsIndirect command
+struct DrawCommand {
+    unsigned count, instanceCount, firstIndex;
+    int baseVertex;
+    unsigned baseInstance;
+};
+
+#define GPU_OBJECT_STRUCT \
+    "struct Object { mat4 world; vec4 sphere; vec4 color; uint indexCount; uint firstIndex; int baseVertex; uint pad; };\n"
+
+static const char* CULL_SHADER =
+    "#version 430\n"
+    "layout(local_size_x = 64) in;\n"
+    GPU_OBJECT_STRUCT
+    "struct Command { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n"
+    "layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };\n"
+    "layout(std430, binding = 1) writeonly buffer Commands { Command commands[]; };\n"
+    "layout(std430, binding = 2) buffer Counter { uint visibleCount; };\n"
+    "uniform vec4 planes[6];\n"
+    "uniform uint objectCount;\n"
+    "void main() {\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    if (i >= objectCount) return;\n"
+    "    Object o = objects[i];\n"
+    "    // Same sphere test as FrustumTestSphere, scaled by the largest axis\n"
+    "    vec3 center = (o.world * vec4(o.sphere.xyz, 1.0)).xyz;\n"
+    "    float scale = max(dot(o.world[0].xyz, o.world[0].xyz), max(dot(o.world[1].xyz, o.world[1].xyz), dot(o.world[2].xyz, o.world[2].xyz)));\n"
+    "    float radius = o.sphere.w * sqrt(scale);\n"
+    "    bool visible = true;\n"
+    "    for (int p = 0; p < 6; p++)\n"
+    "        if (dot(planes[p].xyz, center) + planes[p].w < -radius) visible = false;\n"
+    "    commands[i].count = o.indexCount;\n"
+    "    commands[i].instanceCount = visible ? 1u : 0u;\n"
+    "    commands[i].firstIndex = o.firstIndex;\n"
+    "    commands[i].baseVertex = o.baseVertex;\n"
+    "    commands[i].baseInstance = i;\n"
+    "    if (visible) atomicAdd(visibleCount, 1u);\n"
+    "}\n";
+
+static const char* VERTEX_SHADER =
+    "#version 430\n"
+    GPU_OBJECT_STRUCT
+    "layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in uint objectIndex; // Instanced, so it equals the command's baseInstance\n"
+    "uniform mat4 viewProjection;\n"
+    "flat out vec4 color;\n"
+    "void main() {\n"
+    "    gl_Position = viewProjection * objects[objectIndex].world * vec4(position, 1.0);\n"
+    "    color = objects[objectIndex].color;\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER =
+    "#version 430\n"
+    "flat in vec4 color;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragColor = color;\n"
+    "}\n";
+
+static bool checked = false, supported = false;
+static GLuint cullProgram = 0, drawProgram = 0;
+static GLint planesLocation, objectCountLocation, viewProjectionLocation;
+
+static GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Links the compiled shaders (0 entries are failed compiles) and deletes them; 0 on failure
+static GLuint linkProgram(const GLuint* shaders, int count) {
+    GLuint program = 0;
+    bool compiled = true;
+    for (int i = 0; i < count; i++) compiled = compiled && shaders[i] != 0;
+
+    if (compiled) {
+        program = glCreateProgram();
+        for (int i = 0; i < count; i++) glAttachShader(program, shaders[i]);
+        glLinkProgram(program);
+
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (shaders[i]) glDeleteShader(shaders[i]);
+    }
+    return program;
+}
+
+bool GpuSceneSupported() {
+    if (checked) return supported;
+    checked = true;
+    if (!GLEW_VERSION_4_3) return false;
+
+    GLuint compute = compileShader(GL_COMPUTE_SHADER, CULL_SHADER);
+    cullProgram = linkProgram(&compute, 1);
+    GLuint draw[] = { compileShader(GL_VERTEX_SHADER, VERTEX_SHADER), compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER) };
+    drawProgram = linkProgram(draw, 2);
+    if (!cullProgram || !drawProgram) return false;
+
+    planesLocation = glGetUniformLocation(cullProgram, "planes");
+    objectCountLocation = glGetUniformLocation(cullProgram, "objectCount");
+    viewProjectionLocation = glGetUniformLocation(drawProgram, "viewProjection");
+    supported = true;
+    return true;
+}
+
+void GpuSceneInit(GpuScene& scene) {
+    scene.meshesDirty = scene.objectsDirty = true;
+    scene.objectCapacity = 0;
+    scene.frame = 0;
+    scene.lastVisible = 0;
+
+    glGenVertexArrays(1, &scene.vertexArray);
+    glGenBuffers(1, &scene.vertexBuffer);
+    glGenBuffers(1, &scene.indexBuffer);
+    glGenBuffers(1, &scene.objectBuffer);
+    glGenBuffers(1, &scene.commandBuffer);
+    glGenBuffers(1, &scene.instanceBuffer);
+    glGenBuffers(GPU_SCENE_COUNTERS, scene.counterBuffers);
+
+    unsigned zero = 0;
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (int i = 0; i < GPU_SCENE_COUNTERS; i++) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.counterBuffers[i]);
+        scene.counters[i] = 0;
+        scene.counterFences[i] = 0;
+        if (GLEW_ARB_buffer_storage) {
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(zero), &zero, flags);
+            scene.counters[i] = (const unsigned*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), flags);
+        }
+        else glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), &zero, GL_DYNAMIC_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindVertexArray(scene.vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+    glBindBuffer(GL_ARRAY_BUFFER, scene.instanceBuffer);
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(unsigned), 0);
+    glVertexAttribDivisor(1, 1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene.indexBuffer);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GpuSceneRelease(GpuScene& scene) {
+    glDeleteVertexArrays(1, &scene.vertexArray);
+    glDeleteBuffers(1, &scene.vertexBuffer);
+    glDeleteBuffers(1, &scene.indexBuffer);
+    glDeleteBuffers(1, &scene.objectBuffer);
+    glDeleteBuffers(1, &scene.commandBuffer);
+    glDeleteBuffers(1, &scene.instanceBuffer);
+    for (int i = 0; i < GPU_SCENE_COUNTERS; i++) {
+        if (scene.counterFences[i]) glDeleteSync(scene.counterFences[i]);
+        scene.counterFences[i] = 0;
+        if (!scene.counters[i]) continue;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.counterBuffers[i]);
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        scene.counters[i] = 0;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDeleteBuffers(GPU_SCENE_COUNTERS, scene.counterBuffers);
+    scene.objectCapacity = 0;
+}
+
+int GpuSceneAddMesh(GpuScene& scene, const float* positions, int vertexCount, const unsigned* indices, int indexCount) {
+    GpuMesh mesh;
+    mesh.firstIndex = (unsigned)scene.indices.size();
+    mesh.indexCount = indexCount;
+    mesh.baseVertex = (int)(scene.vertices.size() / 3);
+
+    // Bounding sphere around the box center, tight enough for culling
+    Vec3 lo = MakeVec3(positions[0], positions[1], positions[2]), hi = lo;
+    for (int i = 1; i < vertexCount; i++) {
+        Vec3 p = MakeVec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+        lo = Min(lo, p);
+        hi = Max(hi, p);
+    }
+    mesh.center = (lo + hi) * 0.5f;
+    mesh.radius = 0;
+    for (int i = 0; i < vertexCount; i++) {
+        Vec3 p = MakeVec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+        float d = Length(p - mesh.center);
+        if (d > mesh.radius) mesh.radius = d;
+    }
+
+    scene.vertices.insert(scene.vertices.end(), positions, positions + vertexCount * 3);
+    scene.indices.insert(scene.indices.end(), indices, indices + indexCount);
+    scene.meshes.push_back(mesh);
+    scene.meshesDirty = true;
+    return (int)scene.meshes.size() - 1;
+}
+
+int GpuSceneAddObject(GpuScene& scene, int mesh, const Matrix4& world, float r, float g, float b) {
+    const GpuMesh& m = scene.meshes[mesh];
+    GpuObject object;
+    memcpy(object.world, world.m, sizeof(object.world));
+    object.sphere[0] = m.center.x;
+    object.sphere[1] = m.center.y;
+    object.sphere[2] = m.center.z;
+    object.sphere[3] = m.radius;
+    object.color[0] = r;
+    object.color[1] = g;
+    object.color[2] = b;
+    object.color[3] = 1;
+    object.indexCount = m.indexCount;
+    object.firstIndex = m.firstIndex;
+    object.baseVertex = m.baseVertex;
+    object.pad = 0;
+
+    scene.objects.push_back(object);
+    scene.objectsDirty = true;
+    return (int)scene.objects.size() - 1;
+}
+
+void GpuSceneSetWorld(GpuScene& scene, int object, const Matrix4& world) {
+    memcpy(scene.objects[object].world, world.m, sizeof(scene.objects[object].world));
+    scene.objectsDirty = true;
+}
+
+void GpuSceneSetColor(GpuScene& scene, int object, float r, float g, float b) {
+    float* color = scene.objects[object].color;
+    if (color[0] == r && color[1] == g && color[2] == b) return;
+    color[0] = r;
+    color[1] = g;
+    color[2] = b;
+    scene.objectsDirty = true;
+}
+
+// Sends changed meshes and objects; buffers only grow
+static void upload(GpuScene& scene) {
+    if (scene.meshesDirty) {
+        glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, scene.vertices.size() * sizeof(float), scene.vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene.indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, scene.indices.size() * sizeof(unsigned), scene.indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        scene.meshesDirty = false;
+    }
+    if (!scene.objectsDirty) return;
+
+    int count = (int)scene.objects.size();
+    if (count > scene.objectCapacity) {
+        int capacity = scene.objectCapacity ? scene.objectCapacity : 256;
+        while (capacity < count) capacity *= 2;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.objectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GpuObject), 0, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(DrawCommand), 0, GL_DYNAMIC_COPY);
+
+        // Object indices for the instanced attribute, fixed once written
+        std::vector<unsigned> instances(capacity);
+        for (int i = 0; i < capacity; i++) instances[i] = i;
+        glBindBuffer(GL_ARRAY_BUFFER, scene.instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(unsigned), instances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        scene.objectCapacity = capacity;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.objectBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GpuObject), scene.objects.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    scene.objectsDirty = false;
+}
+
+// One compute dispatch fills the command buffer and counts into the given counter
+static void cull(GpuScene& scene, const Matrix4& viewProjection, GLuint counter) {
+    Frustum frustum = FrustumFromMatrix(viewProjection);
+    int count = (int)scene.objects.size();
+
+    unsigned zero = 0; // Cleared rather than written, which immutable storage allows
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUseProgram(cullProgram);
+    glUniform4fv(planesLocation, 6, &frustum.planes[0].x);
+    glUniform1ui(objectCountLocation, count);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, scene.objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, scene.commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, counter);
+    glDispatchCompute((count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    glUseProgram(0);
+}
+
+// Takes a ring slot's count once its draw has finished and frees the slot's
+// fence. Without wait, a count the GPU has not finished is dropped instead.
+static void retireCounter(GpuScene& scene, int counter, bool wait) {
+    GLsync fence = scene.counterFences[counter];
+    if (!fence) return;
+    GLenum status = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? FENCE_TIMEOUT : 0);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+        unsigned visible = 0;
+        if (scene.counters[counter]) visible = *scene.counters[counter];
+        else {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.counterBuffers[counter]);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(visible), &visible);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        scene.lastVisible = visible;
+    }
+    glDeleteSync(fence);
+    scene.counterFences[counter] = 0;
+}
+
+int GpuSceneDraw(GpuScene& scene, const Matrix4& viewProjection) {
+    int count = (int)scene.objects.size();
+    if (count == 0) return 0;
+    upload(scene);
+
+    // The oldest count in the ring, read only if the GPU is done with it;
+    // otherwise it is dropped and the HUD keeps the last one
+    int counter = scene.frame % GPU_SCENE_COUNTERS;
+    retireCounter(scene, counter, false);
+
+    cull(scene, viewProjection, scene.counterBuffers[counter]);
+    GLbitfield barriers = GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT;
+    if (scene.counters[counter]) barriers |= GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT;
+    glMemoryBarrier(barriers);
+
+    glUseProgram(drawProgram);
+    glUniformMatrix4fv(viewProjectionLocation, 1, GL_FALSE, viewProjection.m);
+    glBindVertexArray(scene.vertexArray);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    scene.counterFences[counter] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    scene.frame++;
+    return scene.lastVisible;
+}
+
+void GpuSceneReadVisibility(GpuScene& scene, const Matrix4& viewProjection, std::vector<unsigned char>& visible) {
+    int count = (int)scene.objects.size();
+    visible.assign(count, 0);
+    if (count == 0) return;
+    upload(scene);
+
+    // Reuses the ring's first counter, so its draw's count is taken first
+    retireCounter(scene, 0, true);
+    cull(scene, viewProjection, scene.counterBuffers[0]);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    std::vector<DrawCommand> commands(count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.commandBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(DrawCommand), commands.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    for (int i = 0; i < count; i++) visible[i] = commands[i].instanceCount != 0;
+}
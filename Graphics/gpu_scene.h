@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include "glew.h"
+#include "vecmath.h"
+
+// --- GPU-driven scene ---
+// Meshes share one vertex and one index buffer. Every object (world matrix,
+// local bounding sphere, color and mesh range) lives in a shader storage
+// buffer. Each frame a compute shader tests every object against the
+// camera frustum and writes one indirect draw command per object, with an
+// instance count of 1 or 0. A single glMultiDrawElementsIndirect then draws
+// the whole set, so the CPU issues the same few calls for ten objects or a
+// hundred thousand. The vertex shader finds its object through an instanced
+// attribute, so baseInstance selects it without ARB_shader_draw_parameters.
+//
+// Needs GL 4.3 (compute shaders, storage buffers, multi-draw indirect).
+// Mesa's llvmpipe provides this, so the path runs without a GPU too.
+//
+// The visible count for the HUD is never waited for. Each draw counts into
+// one of a ring of small buffers and sets a fence; the count is read when
+// that buffer comes round again, only if its fence has signaled, through a
+// persistent read mapping where ARB_buffer_storage is there.
+
+const int GPU_SCENE_COUNTERS = 3;
+
+struct GpuMesh {
+    unsigned firstIndex, indexCount;
+    int baseVertex;
+    Vec3 center;   // Local bounding sphere
+    float radius;
+};
+
+// std430 layout shared with the shaders
+struct GpuObject {
+    float world[16];
+    float sphere[4];  // Local center and radius
+    float color[4];
+    unsigned indexCount, firstIndex;
+    int baseVertex;
+    unsigned pad;
+};
+
+struct GpuScene {
+    std::vector<float> vertices;     // xyz
+    std::vector<unsigned> indices;
+    std::vector<GpuMesh> meshes;
+    std::vector<GpuObject> objects;  // CPU copy, uploaded when dirty
+    bool meshesDirty, objectsDirty;
+
+    GLuint vertexArray;
+    GLuint vertexBuffer, indexBuffer;
+    GLuint objectBuffer, commandBuffer, instanceBuffer;
+    GLuint counterBuffers[GPU_SCENE_COUNTERS];     // Visible counts, a ring of draws
+    const unsigned* counters[GPU_SCENE_COUNTERS];  // Persistently mapped, or 0 to read with glGetBufferSubData
+    GLsync counterFences[GPU_SCENE_COUNTERS];      // Set after each draw's commands
+    int objectCapacity;              // Of the GPU buffers, in objects
+    int frame;
+    int lastVisible;
+};
+
+bool GpuSceneSupported(); // After glewInit; also compiles the shaders once
+void GpuSceneInit(GpuScene& scene);
+void GpuSceneRelease(GpuScene& scene);
+
+// Triangles in local space; returns the mesh index
+int GpuSceneAddMesh(GpuScene& scene, const float* positions, int vertexCount, const unsigned* indices, int indexCount);
+int GpuSceneAddObject(GpuScene& scene, int mesh, const Matrix4& world, float r, float g, float b);
+void GpuSceneSetWorld(GpuScene& scene, int object, const Matrix4& world);
+void GpuSceneSetColor(GpuScene& scene, int object, float r, float g, float b);
+
+// Culls on the GPU and draws every visible object; returns the visible
+// count of a draw GPU_SCENE_COUNTERS - 1 calls ago, or the last one known
+int GpuSceneDraw(GpuScene& scene, const Matrix4& viewProjection);
+
+// Culls only and reads the per-object results back (waits for the GPU); for checks, not per frame
+void GpuSceneReadVisibility(GpuScene& scene, const Matrix4& viewProjection, std::vector<unsigned char>& visible);
@@ -0,0 +1,59 @@
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include "glew.h"
+#include "glut.h"
+#include "hud.h"
+#include "text.h"
+
+const int HUD_MAX_LINES = 16;
+const int HUD_LINE_LENGTH = 96;
+
+static char lines[HUD_MAX_LINES][HUD_LINE_LENGTH];
+static int numLines = 0;
+static double frameMs = 0;    // Smoothed frame time
+static std::chrono::steady_clock::time_point lastFrame;
+static bool firstFrame = true;
+
+void HudBeginFrame() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!firstFrame) {
+        double ms = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+        frameMs = frameMs == 0 ? ms : frameMs * 0.95 + ms * 0.05; // Exponential moving average
+    }
+    firstFrame = false;
+    lastFrame = now;
+
+    numLines = 0;
+    HudPrint("%.1f fps  %.2f ms", frameMs > 0 ? 1000.0 / frameMs : 0.0, frameMs);
+}
+
+void HudPrint(const char* format, ...) {
+    if (numLines == HUD_MAX_LINES) return;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(lines[numLines++], HUD_LINE_LENGTH, format, args);
+    va_end(args);
+}
+
+void HudDraw(int x, int y, int width, int height) {
+    void* font = GLUT_BITMAP_HELVETICA_12;
+    int lineHeight = TextHeight(font);
+
+    glViewport(x, y, width, height);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, width, 0, height, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    for (int i = 0; i < numLines; i++)
+        TextPrint(font, 6, height - (i + 1) * lineHeight, 0, 0, 0, lines[i]);
+    TextFlush();
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// --- Stats HUD ---
+// Lines are collected during the frame with HudPrint() and drawn together
+// in the top-left corner of the given viewport by HudDraw(). The frame
+// timing line is added automatically.
+
+void HudBeginFrame(); // Call once at the start of display()
+void HudPrint(const char* format, ...);
+void HudDraw(int x, int y, int width, int height); // Viewport in window pixels
@@ -0,0 +1,283 @@
+#include <string.h>
+#include "image_writer.h"
+
+static const int STORED_BLOCK_BYTES = 65535;  // Largest deflate stored block
+static const int FILE_BUFFER_BYTES = 1 << 20;
+
+// --- Byte output ---
+static void putBytes(ImageWriter& writer, const void* data, size_t size) {
+    if (size && fwrite(data, 1, size, writer.file) != size) writer.failed = true;
+}
+
+static void putLittle(ImageWriter& writer, unsigned long long value, int bytes) {
+    unsigned char out[8];
+    for (int i = 0; i < bytes; i++) out[i] = (unsigned char)(value >> (8 * i));
+    putBytes(writer, out, bytes);
+}
+
+// --- PNG ---
+struct CrcTable {
+    unsigned value[256];
+    CrcTable() {
+        for (unsigned n = 0; n < 256; n++) {
+            unsigned c = n;
+            for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            value[n] = c;
+        }
+    }
+};
+
+static unsigned crcUpdate(unsigned crc, const unsigned char* data, size_t size) {
+    static const CrcTable table;
+    for (size_t i = 0; i < size; i++) crc = table.value[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static unsigned adlerUpdate(unsigned adler, const unsigned char* data, size_t size) {
+    unsigned a = adler & 0xFFFF, b = adler >> 16;
+    while (size > 0) {
+        size_t run = size < 5552 ? size : 5552; // Longest run before the sums can overflow
+        for (size_t i = 0; i < run; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return b << 16 | a;
+}
+
+static void putBig32(unsigned char* out, unsigned value) {
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+// A chunk is written piece by piece, its CRC following along
+static unsigned chunkBegin(ImageWriter& writer, const char* type, unsigned length) {
+    unsigned char header[8];
+    putBig32(header, length);
+    memcpy(header + 4, type, 4);
+    putBytes(writer, header, 8);
+    return crcUpdate(0xFFFFFFFFu, header + 4, 4);
+}
+
+static void chunkData(ImageWriter& writer, unsigned* crc, const unsigned char* data, size_t size) {
+    putBytes(writer, data, size);
+    *crc = crcUpdate(*crc, data, size);
+}
+
+static void chunkEnd(ImageWriter& writer, unsigned crc) {
+    unsigned char out[4];
+    putBig32(out, crc ^ 0xFFFFFFFFu);
+    putBytes(writer, out, 4);
+}
+
+static void pngBegin(ImageWriter& writer) {
+    static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    putBytes(writer, SIGNATURE, 8);
+
+    unsigned char header[13] = { 0 };
+    putBig32(header, writer.width);
+    putBig32(header + 4, writer.height);
+    header[8] = 8; // Bits per channel
+    header[9] = 2; // RGB
+    unsigned crc = chunkBegin(writer, "IHDR", 13);
+    chunkData(writer, &crc, header, 13);
+    chunkEnd(writer, crc);
+
+    static const unsigned char ZLIB_HEADER[2] = { 0x78, 0x01 }; // Deflate, 32 KB window
+    crc = chunkBegin(writer, "IDAT", 2);
+    chunkData(writer, &crc, ZLIB_HEADER, 2);
+    chunkEnd(writer, crc);
+    writer.adler = 1;
+}
+
+// Filter byte 0 (none), then the row, cut into stored blocks
+static void pngRow(ImageWriter& writer, const unsigned char* rgb) {
+    static const unsigned char FILTER_NONE = 0;
+    size_t size = 1 + (size_t)writer.width * 3;
+    size_t blocks = (size + STORED_BLOCK_BYTES - 1) / STORED_BLOCK_BYTES;
+    unsigned crc = chunkBegin(writer, "IDAT", (unsigned)(size + 5 * blocks));
+
+    for (size_t done = 0; done < size;) {
+        unsigned length = (unsigned)(size - done < STORED_BLOCK_BYTES ? size - done : STORED_BLOCK_BYTES);
+        unsigned char block[5] = { 0, (unsigned char)length, (unsigned char)(length >> 8),
+            (unsigned char)~length, (unsigned char)(~length >> 8) };
+        chunkData(writer, &crc, block, 5);
+
+        size_t pixels = length;
+        if (done == 0) {
+            chunkData(writer, &crc, &FILTER_NONE, 1);
+            pixels--;
+        }
+        const unsigned char* from = rgb + (done == 0 ? 0 : done - 1);
+        chunkData(writer, &crc, from, pixels);
+        done += length;
+    }
+    chunkEnd(writer, crc);
+
+    writer.adler = adlerUpdate(writer.adler, &FILTER_NONE, 1);
+    writer.adler = adlerUpdate(writer.adler, rgb, (size_t)writer.width * 3);
+}
+
+static void pngEnd(ImageWriter& writer) {
+    unsigned char tail[9] = { 1, 0, 0, 0xFF, 0xFF }; // Final, empty stored block
+    putBig32(tail + 5, writer.adler);
+    unsigned crc = chunkBegin(writer, "IDAT", 9);
+    chunkData(writer, &crc, tail, 9);
+    chunkEnd(writer, crc);
+
+    crc = chunkBegin(writer, "IEND", 0);
+    chunkEnd(writer, crc);
+}
+
+// --- TIFF ---
+enum TiffType { TIFF_SHORT = 3, TIFF_LONG = 4, TIFF_RATIONAL = 5, TIFF_LONG8 = 16 };
+static const int TIFF_ENTRIES = 13;
+
+static unsigned long long tiffRowBytes(const ImageWriter& writer) {
+    return (unsigned long long)writer.width * 3;
+}
+
+static unsigned long long tiffDataStart(const ImageWriter& writer) {
+    return writer.bigTiff ? 16 : 8;
+}
+
+// Right after the pixels, on a word boundary
+static unsigned long long tiffDirectory(const ImageWriter& writer) {
+    unsigned long long end = tiffDataStart(writer) + tiffRowBytes(writer) * writer.height;
+    return (end + 7) & ~7ull;
+}
+
+static void tiffBegin(ImageWriter& writer) {
+    unsigned long long pixels = tiffRowBytes(writer) * writer.height;
+    writer.bigTiff = pixels + 16ull * writer.height + 1024 > 0xFFFFFFFFull; // Offsets past 32 bits
+    putBytes(writer, "II", 2);
+    if (writer.bigTiff) {
+        putLittle(writer, 43, 2);
+        putLittle(writer, 8, 2); // Offset size
+        putLittle(writer, 0, 2);
+        putLittle(writer, tiffDirectory(writer), 8);
+    } else {
+        putLittle(writer, 42, 2);
+        putLittle(writer, tiffDirectory(writer), 4);
+    }
+}
+
+// Values that fit the entry's field are stored in it, the others at *extra,
+// which then moves past them
+static void tiffEntry(ImageWriter& writer, int tag, TiffType type, unsigned long long count,
+    unsigned long long value, unsigned long long* extra) {
+    static const int TYPE_BYTES[17] = { 0, 1, 1, 2, 4, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8 };
+    int field = writer.bigTiff ? 8 : 4;
+    unsigned long long bytes = TYPE_BYTES[type] * count;
+
+    putLittle(writer, tag, 2);
+    putLittle(writer, type, 2);
+    putLittle(writer, count, writer.bigTiff ? 8 : 4);
+    if (bytes <= (unsigned long long)field) {
+        putLittle(writer, value, field);
+    } else {
+        putLittle(writer, *extra, field);
+        *extra += bytes;
+    }
+}
+
+// Rows of uncompressed RGB, the strip tables and resolution after the
+// directory, in the order the entries refer to them
+static void tiffEnd(ImageWriter& writer) {
+    unsigned long long directory = tiffDirectory(writer);
+    unsigned long long here = tiffDataStart(writer) + tiffRowBytes(writer) * writer.height;
+    putLittle(writer, 0, (int)(directory - here));
+
+    bool big = writer.bigTiff;
+    unsigned long long extra = directory + (big ? 8 + TIFF_ENTRIES * 20 + 8 : 2 + TIFF_ENTRIES * 12 + 4);
+    unsigned long long rowBytes = tiffRowBytes(writer), first = tiffDataStart(writer);
+    TiffType offsetType = big ? TIFF_LONG8 : TIFF_LONG;
+    int offsetBytes = big ? 8 : 4;
+    const unsigned long long BITS = 8 | 8ull << 16 | 8ull << 32, DPI = 72 | 1ull << 32;
+    unsigned long long counts = big && writer.height == 2 ? rowBytes | rowBytes << 32 : rowBytes; // Inline pair
+
+    putLittle(writer, TIFF_ENTRIES, big ? 8 : 2);
+    tiffEntry(writer, 256, TIFF_LONG, 1, writer.width, &extra);      // ImageWidth
+    tiffEntry(writer, 257, TIFF_LONG, 1, writer.height, &extra);     // ImageLength
+    tiffEntry(writer, 258, TIFF_SHORT, 3, BITS, &extra);             // BitsPerSample
+    tiffEntry(writer, 259, TIFF_SHORT, 1, 1, &extra);                // Compression: none
+    tiffEntry(writer, 262, TIFF_SHORT, 1, 2, &extra);                // PhotometricInterpretation: RGB
+    tiffEntry(writer, 273, offsetType, writer.height, first, &extra); // StripOffsets
+    tiffEntry(writer, 277, TIFF_SHORT, 1, 3, &extra);                // SamplesPerPixel
+    tiffEntry(writer, 278, TIFF_LONG, 1, 1, &extra);                 // RowsPerStrip
+    tiffEntry(writer, 279, TIFF_LONG, writer.height, counts, &extra);   // StripByteCounts
+    tiffEntry(writer, 282, TIFF_RATIONAL, 1, DPI, &extra);           // XResolution
+    tiffEntry(writer, 283, TIFF_RATIONAL, 1, DPI, &extra);           // YResolution
+    tiffEntry(writer, 284, TIFF_SHORT, 1, 1, &extra);                // PlanarConfiguration: chunky
+    tiffEntry(writer, 296, TIFF_SHORT, 1, 2, &extra);                // ResolutionUnit: inch
+    putLittle(writer, 0, big ? 8 : 4);                               // No next directory
+
+    // Out-of-line values, in entry order; a single strip's fit in their entries
+    if (!big) putLittle(writer, BITS, 6);
+    if (offsetBytes * (unsigned long long)writer.height > (unsigned long long)offsetBytes)
+        for (int row = 0; row < writer.height; row++) putLittle(writer, first + rowBytes * row, offsetBytes);
+    if (4ull * writer.height > (big ? 8u : 4u))
+        for (int row = 0; row < writer.height; row++) putLittle(writer, rowBytes, 4);
+    if (!big) {
+        putLittle(writer, DPI, 8);
+        putLittle(writer, DPI, 8);
+    }
+}
+
+// --- Writer ---
+ImageFormat ImageFormatFromPath(const char* path) {
+    const char* dot = strrchr(path, '.');
+    if (dot && (strcmp(dot, ".tif") == 0 || strcmp(dot, ".tiff") == 0 || strcmp(dot, ".TIF") == 0 ||
+        strcmp(dot, ".TIFF") == 0))
+        return IMAGE_TIFF;
+    return IMAGE_PNG;
+}
+
+bool ImageWriterOpen(ImageWriter& writer, const char* path, int width, int height) {
+    writer.format = ImageFormatFromPath(path);
+    writer.width = width;
+    writer.height = height;
+    writer.rows = 0;
+    writer.adler = 1;
+    writer.bigTiff = false;
+    writer.failed = false;
+    writer.file = 0;
+    if (width <= 0 || height <= 0) return false;
+#ifdef _MSC_VER
+    fopen_s(&writer.file, path, "wb"); // fopen is deprecated under /sdl
+#else
+    writer.file = fopen(path, "wb");
+#endif
+    if (!writer.file) return false;
+    setvbuf(writer.file, 0, _IOFBF, FILE_BUFFER_BYTES);
+
+    if (writer.format == IMAGE_PNG) pngBegin(writer);
+    else tiffBegin(writer);
+    return !writer.failed;
+}
+
+void ImageWriterRow(ImageWriter& writer, const unsigned char* rgb) {
+    if (!writer.file || writer.rows == writer.height) {
+        writer.failed = true;
+        return;
+    }
+    if (writer.format == IMAGE_PNG) pngRow(writer, rgb);
+    else putBytes(writer, rgb, (size_t)tiffRowBytes(writer));
+    writer.rows++;
+}
+
+bool ImageWriterClose(ImageWriter& writer) {
+    if (!writer.file) return false;
+    if (writer.rows != writer.height) writer.failed = true;
+    else if (writer.format == IMAGE_PNG) pngEnd(writer);
+    else tiffEnd(writer);
+    if (fclose(writer.file) != 0) writer.failed = true;
+    writer.file = 0;
+    return !writer.failed;
+}
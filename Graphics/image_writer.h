@@ -0,0 +1,32 @@
+#pragma once
+#include <stdio.h>
+
+// --- Streaming image files ---
+// PNG and TIFF written a row at a time, top row first, so an image of any
+// size goes to disk without ever being held in memory. Every offset and
+// length in either format is fixed by the image size, so nothing is
+// patched afterwards.
+//
+// PNG: one IDAT chunk per row, holding deflate's stored (uncompressed)
+// blocks, so no compression library is needed. The final empty block and
+// the Adler-32 checksum close the zlib stream.
+// TIFF: uncompressed RGB, one strip per row. The strip tables follow the
+// pixels; BigTIFF's 64-bit offsets take over past 4 GB.
+
+enum ImageFormat { IMAGE_PNG, IMAGE_TIFF };
+
+struct ImageWriter {
+    FILE* file;
+    ImageFormat format;
+    int width, height;
+    int rows;                // Written so far
+    unsigned adler;          // PNG: of the zlib stream's data
+    bool bigTiff;
+    bool failed;
+};
+
+ImageFormat ImageFormatFromPath(const char* path); // .tif or .tiff, otherwise PNG
+
+bool ImageWriterOpen(ImageWriter& writer, const char* path, int width, int height);
+void ImageWriterRow(ImageWriter& writer, const unsigned char* rgb); // width * 3 bytes
+bool ImageWriterClose(ImageWriter& writer); // False if any write failed or rows are missing
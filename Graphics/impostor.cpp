@@ -0,0 +1,120 @@
+#include <math.h>
+#include "glew.h"
+#include "glut.h"
+#include "impostor.h"
+
+static const char* VERTEX_SHADER =
+    "#version 120\n"
+    "varying vec3 rayOrigin; // Eye in the unit sphere's space\n"
+    "varying vec3 rayTarget; // Point on the box in the same space\n"
+    "void main() {\n"
+    "    rayOrigin = (gl_ModelViewMatrixInverse * vec4(0.0, 0.0, 0.0, 1.0)).xyz;\n"
+    "    rayTarget = gl_Vertex.xyz;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec3 rayOrigin;\n"
+    "varying vec3 rayTarget;\n"
+    "void main() {\n"
+    "    // Nearest t with |origin + t * direction| = 1\n"
+    "    vec3 direction = rayTarget - rayOrigin;\n"
+    "    float a = dot(direction, direction);\n"
+    "    float b = dot(rayOrigin, direction);\n"
+    "    float c = dot(rayOrigin, rayOrigin) - 1.0;\n"
+    "    float discriminant = b * b - a * c;\n"
+    "    if (discriminant < 0.0) discard;\n"
+    "    float t = (-b - sqrt(discriminant)) / a;\n"
+    "    if (t < 0.0) discard; // Eye inside the ellipsoid\n"
+    "\n"
+    "    vec4 clip = gl_ModelViewProjectionMatrix * vec4(rayOrigin + t * direction, 1.0);\n"
+    "    float ndcDepth = clip.z / clip.w;\n"
+    "    gl_FragDepth = 0.5 * (gl_DepthRange.diff * ndcDepth + gl_DepthRange.near + gl_DepthRange.far);\n"
+    "    gl_FragColor = gl_Color;\n"
+    "}\n";
+
+// Faces of the [-1, 1] cube, counter-clockwise seen from outside
+static const float CUBE_CORNERS[8][3] = {
+    { -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 },
+    { -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 }
+};
+static const int CUBE_FACES[6][4] = {
+    { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 4, 7, 3 }, { 1, 2, 6, 5 }, { 0, 1, 5, 4 }, { 3, 7, 6, 2 }
+};
+
+static GLuint program = 0;
+
+static GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool ImpostorInit() {
+    if (!GLEW_VERSION_2_1) return false;
+
+    GLuint vertex = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+    GLuint fragment = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    if (vertex && fragment) {
+        program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (vertex) glDeleteShader(vertex);
+    if (fragment) glDeleteShader(fragment);
+    return program != 0;
+}
+
+static float determinant3(const Matrix4& world) {
+    const float* m = world.m;
+    return m[0] * (m[5] * m[10] - m[6] * m[9]) - m[4] * (m[1] * m[10] - m[2] * m[9])
+        + m[8] * (m[1] * m[6] - m[2] * m[5]);
+}
+
+bool ImpostorCanDraw(const Matrix4& world) {
+    return fabsf(determinant3(world)) > 1e-6f; // The shader needs the inverse
+}
+
+void ImpostorBegin() {
+    glUseProgram(program);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_FRONT); // Back faces still cover the ellipsoid when the eye is inside the box
+}
+
+void ImpostorEllipsoid(const Matrix4& world, float r, float g, float b) {
+    glFrontFace(determinant3(world) < 0 ? GL_CW : GL_CCW); // Mirrored parts flip the winding
+
+    glPushMatrix();
+    glMultMatrixf(world.m);
+    glColor3f(r, g, b);
+    glBegin(GL_QUADS);
+    for (int face = 0; face < 6; face++) {
+        for (int i = 0; i < 4; i++) glVertex3fv(CUBE_CORNERS[CUBE_FACES[face][i]]);
+    }
+    glEnd();
+    glPopMatrix();
+}
+
+void ImpostorEnd() {
+    glFrontFace(GL_CCW);
+    glDisable(GL_CULL_FACE);
+    glUseProgram(0);
+}
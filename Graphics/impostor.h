@@ -0,0 +1,20 @@
+#pragma once
+#include "vecmath.h"
+
+// --- Ellipsoid impostors ---
+// An ellipsoid is a unit sphere under a (non-uniformly scaled) world matrix.
+// Instead of tessellating it, only the back faces of its bounding cube are
+// rasterized. The fragment shader casts the eye ray through each pixel into
+// the sphere's local space, discards misses and writes the exact hit depth,
+// so silhouettes and intersections with other geometry are exact at any
+// distance for 12 triangles per ellipsoid.
+//
+// Drawing uses the current modelview matrix, so the camera has to be loaded
+// there as for fixed-function geometry.
+
+bool ImpostorInit(); // After glewInit; false without shader support
+bool ImpostorCanDraw(const Matrix4& world); // False for flattened ellipsoids (a zero scale)
+
+void ImpostorBegin();
+void ImpostorEllipsoid(const Matrix4& world, float r, float g, float b);
+void ImpostorEnd();
@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include "jobs.h"
+
+// Jobs in flight at once; slots are reused round-robin, skipping any still in flight
+static const int JOB_POOL_SIZE = 4096;
+static const int MAX_WORKERS = 64;
+static const int MAX_CONTINUATIONS = 16; // Jobs that may depend on one job
+static const int DEQUE_CAPACITY = 1024;  // Per worker, a power of two
+
+struct Job {
+    JobFunction function;
+    JobRangeFunction rangeFunction; // Used instead of function when set
+    void* data;
+    int begin, end;
+
+    std::atomic<int> pending;           // Unfinished dependencies, plus one until JobRun
+    std::atomic<bool> done;
+    std::atomic<bool> inUse;            // From allocate until it has run and released its continuations
+    JobCounter* finishedCounter;        // Decremented when done; never touched after
+    Job* continuations[MAX_CONTINUATIONS];
+    std::atomic<int> numContinuations;
+};
+
+// Fixed ring, so queueing never allocates. Owner works at the back, thieves take from the front.
+struct Worker {
+    std::mutex lock;
+    Job* jobs[DEQUE_CAPACITY];
+    unsigned front, back; // back - front jobs queued
+};
+
+static Job jobPool[JOB_POOL_SIZE];
+static std::atomic<unsigned> nextJob(0);
+
+static Worker workers[MAX_WORKERS];
+static std::thread threads[MAX_WORKERS];
+static int numWorkers = 1;
+static std::atomic<bool> running(false);
+
+static std::atomic<int> queuedJobs(0);
+static std::mutex sleepLock;
+static std::condition_variable wakeUp;
+
+static thread_local int workerIndex = 0; // Threads outside the pool share worker 0's deque
+
+// --- Queues ---
+static void execute(Job* job);
+
+static void push(Job* job) {
+    Worker& worker = workers[workerIndex];
+    {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.back - worker.front < DEQUE_CAPACITY) {
+            worker.jobs[worker.back++ % DEQUE_CAPACITY] = job;
+            job = 0;
+        }
+    }
+    if (job) { // Deque full: run it right here instead
+        execute(job);
+        return;
+    }
+    queuedJobs++;
+    if (numWorkers > 1) {
+        std::lock_guard<std::mutex> guard(sleepLock); // Pairs with the predicate check in workerLoop
+        wakeUp.notify_one();
+    }
+}
+
+static Job* take() {
+    for (int k = 0; k < numWorkers; k++) {
+        Worker& worker = workers[(workerIndex + k) % numWorkers];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.back == worker.front) continue;
+
+        Job* job;
+        if (k == 0) // Own deque: newest first, its data is still in cache
+            job = worker.jobs[--worker.back % DEQUE_CAPACITY];
+        else // Steal the oldest, usually the biggest piece of remaining work
+            job = worker.jobs[worker.front++ % DEQUE_CAPACITY];
+        queuedJobs--;
+        return job;
+    }
+    return 0;
+}
+
+static void execute(Job* job) {
+    if (job->rangeFunction) job->rangeFunction(job->data, job->begin, job->end);
+    else job->function(job->data);
+
+    if (job->finishedCounter) job->finishedCounter->fetch_sub(1, std::memory_order_release);
+    job->done.store(true, std::memory_order_release);
+
+    int count = job->numContinuations.load(std::memory_order_acquire);
+    if (count > MAX_CONTINUATIONS) count = MAX_CONTINUATIONS;
+    for (int i = 0; i < count; i++)
+        if (job->continuations[i]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            push(job->continuations[i]);
+    job->inUse.store(false, std::memory_order_release);
+}
+
+// Runs one queued job if there is any, otherwise yields
+static void helpOrYield() {
+    Job* job = take();
+    if (job) execute(job);
+    else std::this_thread::yield();
+}
+
+static void workerLoop(int index) {
+    workerIndex = index;
+    while (running.load(std::memory_order_relaxed)) {
+        Job* job = take();
+        if (job) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wakeUp.wait(guard, [] { return queuedJobs.load() > 0 || !running.load(); });
+    }
+}
+
+// --- Pool ---
+void JobsStart(int count) {
+    if (running.exchange(true)) return; // Already running
+    if (count <= 0) count = (int)std::thread::hardware_concurrency();
+    if (count <= 0) count = 1;
+    if (count > MAX_WORKERS) count = MAX_WORKERS;
+
+    numWorkers = count;
+    workerIndex = 0;
+    for (int i = 1; i < numWorkers; i++) threads[i] = std::thread(workerLoop, i);
+}
+
+void JobsStop() {
+    if (!running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        wakeUp.notify_all();
+    }
+    for (int i = 1; i < numWorkers; i++)
+        if (threads[i].joinable()) threads[i].join();
+    numWorkers = 1;
+}
+
+int JobsWorkerCount() {
+    return numWorkers;
+}
+
+// --- Jobs ---
+// The next slot that is not in flight. Should every slot be, the caller
+// runs queued jobs until one finishes.
+static Job* allocate() {
+    Job* job = 0;
+    while (!job) {
+        for (int tries = 0; tries < JOB_POOL_SIZE && !job; tries++) {
+            Job* slot = &jobPool[nextJob.fetch_add(1, std::memory_order_relaxed) % JOB_POOL_SIZE];
+            bool expected = false;
+            if (slot->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) job = slot;
+        }
+        if (!job) helpOrYield();
+    }
+    job->function = 0;
+    job->rangeFunction = 0;
+    job->data = 0;
+    job->begin = job->end = 0;
+    job->pending.store(1, std::memory_order_relaxed);
+    job->done.store(false, std::memory_order_relaxed);
+    job->finishedCounter = 0;
+    job->numContinuations.store(0, std::memory_order_relaxed);
+    return job;
+}
+
+Job* JobCreate(JobFunction function, void* data, JobCounter* counter) {
+    Job* job = allocate();
+    job->function = function;
+    job->data = data;
+    job->finishedCounter = counter;
+    if (counter) counter->fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobDependsOn(Job* job, Job* dependency) {
+    if (dependency->done.load(std::memory_order_acquire)) return;
+    int slot = dependency->numContinuations.fetch_add(1, std::memory_order_acq_rel);
+    assert(slot < MAX_CONTINUATIONS && "too many jobs depend on one job");
+    if (slot >= MAX_CONTINUATIONS) return; // Release builds run job without waiting rather than overrun
+    job->pending.fetch_add(1, std::memory_order_relaxed);
+    dependency->continuations[slot] = job;
+}
+
+void JobRun(Job* job) {
+    if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) push(job);
+}
+
+void JobWait(JobCounter& counter) {
+    while (counter.load(std::memory_order_acquire) > 0) helpOrYield();
+}
+
+void JobParallelFor(int count, int grain, JobRangeFunction function, void* data) {
+    if (grain < 1) grain = 1;
+    if (numWorkers == 1 || count <= grain) { // Not worth splitting
+        if (count > 0) function(data, 0, count);
+        return;
+    }
+
+    JobCounter remaining((count + grain - 1) / grain);
+    for (int begin = grain; begin < count; begin += grain) { // First range is run here
+        Job* job = allocate();
+        job->rangeFunction = function;
+        job->data = data;
+        job->begin = begin;
+        job->end = begin + grain < count ? begin + grain : count;
+        job->finishedCounter = &remaining;
+        JobRun(job);
+    }
+
+    function(data, 0, grain);
+    remaining.fetch_sub(1, std::memory_order_release);
+    JobWait(remaining);
+}
+
+// --- Benchmark ---
+void JobsBenchmark(const char* name, void (*work)(), int repeats) {
+    using namespace std::chrono;
+    bool wasRunning = running.load();
+    int previous = numWorkers;
+    int cores = (int)std::thread::hardware_concurrency();
+    if (cores <= 0) cores = 1;
+    double baseline = 0;
+
+    for (int count = 1; count <= cores && count <= MAX_WORKERS; count++) {
+        JobsStop();
+        JobsStart(count);
+        work(); // Warm up
+
+        steady_clock::time_point start = steady_clock::now();
+        for (int i = 0; i < repeats; i++) work();
+        double ms = duration<double, std::milli>(steady_clock::now() - start).count() / repeats;
+
+        if (count == 1) baseline = ms;
+        printf("%s: %2d worker(s) %8.2f ms  speedup %.2fx\n", name, count, ms, baseline / ms);
+    }
+
+    JobsStop();
+    if (wasRunning) JobsStart(previous);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+
+// --- Job system ---
+// One pool of worker threads shared by every subsystem, sized to the core
+// count. Each worker owns a deque: it pushes and pops its own jobs at the
+// back, and steals from the front of another worker's deque when its own
+// runs dry. The thread that called JobsStart() counts as worker 0 and runs
+// jobs whenever it waits, so nothing blocks on a sleeping thread.
+//
+// A job may depend on others: it is queued once every dependency has
+// finished. Dependencies must be added before the dependency itself is run,
+// and at most 16 jobs may depend on any one. A Job* is only valid until the
+// job has finished; its slot is then reused. So jobs are waited for through
+// a JobCounter the caller owns, never through the Job*. Up to 4096 jobs may
+// be in flight, so JobParallelFor callers should size the grain from
+// JobsWorkerCount() rather than the item count.
+
+struct Job;
+typedef std::atomic<int> JobCounter; // Unfinished jobs created with it; start it at 0
+typedef void (*JobFunction)(void* data);
+typedef void (*JobRangeFunction)(void* data, int begin, int end);
+
+void JobsStart(int numWorkers); // 0 for one per core, including the calling thread
+void JobsStop();
+int JobsWorkerCount();          // 1 when the system is not running
+
+// counter, if given, counts the job until it has finished
+Job* JobCreate(JobFunction function, void* data, JobCounter* counter = 0);
+void JobDependsOn(Job* job, Job* dependency); // job runs after dependency has finished
+void JobRun(Job* job);              // Queues the job once its dependencies are done
+void JobWait(JobCounter& counter);  // Runs other jobs until every job counted has finished
+
+// Splits [0, count) into ranges of at most grain items and returns when all are done
+void JobParallelFor(int count, int grain, JobRangeFunction function, void* data);
+
+// Times work() with 1 to N workers and prints the scaling to stdout
+void JobsBenchmark(const char* name, void (*work)(), int repeats);
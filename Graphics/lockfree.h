@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+
+// --- Lock-free triple buffer ---
+// One writer publishes complete values, one reader always picks up the most
+// recently published one. Neither side ever blocks or waits for the other:
+// the writer keeps a private slot, the reader keeps a private slot and the
+// third slot is swapped between them through a single atomic.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : writeIndex(0), middle(1), readIndex(2) {}
+
+    // Writer side: the slot to fill before calling publish()
+    T& writeSlot() { return slots[writeIndex]; }
+
+    // Writer side: hand the filled slot to the reader
+    void publish() {
+        writeIndex = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader side: latest published value (or the previous one if nothing new)
+    const T& read() {
+        if (middle.load(std::memory_order_relaxed) & FRESH_BIT)
+            readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return slots[readIndex];
+    }
+
+private:
+    static const int FRESH_BIT = 4;
+    static const int INDEX_MASK = 3;
+
+    T slots[3];
+    int writeIndex;          // Owned by the writer
+    std::atomic<int> middle; // Shared slot index, FRESH_BIT set when unread
+    int readIndex;           // Owned by the reader
+};
+
+// --- Single producer / single consumer queue ---
+// Fixed capacity ring (power of two). push() fails instead of blocking when
+// the consumer has fallen behind.
+template <typename T, int CAPACITY>
+class SpscQueue {
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool push(const T& item) {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAPACITY) return false; // Full
+        items[t & (CAPACITY - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false; // Empty
+        item = items[h & (CAPACITY - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+    T items[CAPACITY];
+    std::atomic<unsigned> head; // Next item to pop (consumer)
+    std::atomic<unsigned> tail; // Next free slot (producer)
+};
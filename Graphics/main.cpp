@@ -1,8 +1,34 @@
 #include <stdlib.h>
+#include <chrono>
 #include <time.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include "glew.h"
 #include "glut.h"
+#include "asset_pack.h"
+#include "batch.h"
+#include "bvh.h"
+#include "collision.h"
+#include "culling.h"
+#include "draw_queue.h"
+#include "frame_arena.h"
+#include "hud.h"
+#include "impostor.h"
+#include "jobs.h"
+#include "lockfree.h"
+#include "mesh_opt.h"
+#include "owl_model.h"
+#include "pathtracer.h"
+#include "picking.h"
+#include "poster.h"
+#include "primitives.h"
+#include "scene_graph.h"
+#include "vecmath.h"
+#include "simulation.h"
+#include "text.h"
+#include "ui.h"
+#include "vertex_format.h"
 
 // --- Constants ---
 // Math Constant
@@ -12,6 +38,10 @@ const double PI = 3.14159;
 const int WINDOW_WIDTH = 600;
 const int WINDOW_HEIGHT = 600;
 const int SLIDER_HEIGHT = 120;
+const int VIEW_HEIGHT = WINDOW_HEIGHT - SLIDER_HEIGHT; // 3D view above the slider
+
+// Perspective projection of the 3D view: left, right, bottom, top, near, far
+const float VIEW_FRUSTUM[6] = { -1, 1, -1, 1, 1, 300 };
 
 //texture dimensions
 const int TW = 256;
@@ -24,6 +54,53 @@ const int GROUND_SIZE = 100;
 const double CAMERA_INITIAL_X = -35;
 const double CAMERA_INITIAL_Y = 10;
 const double CAMERA_INITIAL_Z = 50;
+const float CAMERA_RADIUS = 1;  // Collision sphere around the eye
+
+// Clicks pick objects up to the far plane
+const float PICK_DISTANCE = 300;
+
+// Path tracer lights: the sky is the clear color, the sun is above and behind the starting view
+const float PATH_SKY[3] = { 0.6f, 0.6f, 0.6f };
+const Vec3 PATH_SUN_DIRECTION = { -0.5f, 0.8f, 0.6f };
+const float PATH_SUN[3] = { 1.1f, 1.05f, 0.95f };
+
+// --batch DIR renders a thumbnail per pupil position; defaults for what its arguments leave out
+const int BATCH_SIZE = 256;
+const int BATCH_SAMPLES = 16;
+const BatchRange BATCH_EYE_RANGE = { "eye", 40 - WINDOW_WIDTH / 2, WINDOW_WIDTH / 2 - 40, 9 }; // Slider's drag range
+
+// F4 renders the current view into this file, POSTER_WIDTH pixels across (--poster FILE W [H] for any size)
+const char* const POSTER_FILE = "owl_poster.png";
+const int POSTER_WIDTH = 16384;
+
+// Simulation rate (input handling and camera integration)
+const int SIM_TICKS_PER_SECOND = 120;
+
+// Baked owl meshes, written by --bake and used when they match buildOwl
+const char* const ASSET_PACK_FILE = "owl.pak";
+const unsigned OWL_ASSET_REVISION = 1; // Bump when the mesh passes change their output
+
+// --- Simulation <-> Render ---
+// Everything the render thread needs to draw one frame
+struct FrameSnapshot {
+    Vec3 eye;                 // Camera position
+    Vec3 direction;           // Camera direction vector
+    double eyeOffset;         // Slider eye offset
+    bool impostors;           // Ray-cast the ellipsoids instead of tessellating them
+    int pickX, pickY;         // Last click in the 3D view, window coordinates
+    unsigned picks;           // Clicks in the 3D view so far
+    bool pathTrace;           // Path traced still instead of the rasterized view
+    unsigned posters;         // Poster renders requested so far
+};
+
+// Raw input forwarded from the GLUT callbacks to the simulation thread
+enum InputType { INPUT_SPECIAL_KEY, INPUT_MOUSE_BUTTON, INPUT_MOUSE_DRAG };
+struct InputEvent {
+    InputType type;
+    int key;            // INPUT_SPECIAL_KEY
+    int button, state;  // INPUT_MOUSE_BUTTON
+    int x, y;
+};
 
 // --- Global Variables ---
 // Terrain
@@ -32,21 +109,64 @@ double ground[GROUND_SIZE][GROUND_SIZE] = { 0 }; // Terrain height map
 // Texture
 unsigned char tx[TH][TW][3]; // Texture map
 
+// Camera and UI state below is owned by the simulation thread
+
 // Camera Position
-double eyeX = CAMERA_INITIAL_X;  // X coordinate of the camera's position
-double eyeY = CAMERA_INITIAL_Y;  // Y coordinate of the camera's position
-double eyeZ = CAMERA_INITIAL_Z;  // Z coordinate of the camera's position
+Vec3 eye = { CAMERA_INITIAL_X, CAMERA_INITIAL_Y, CAMERA_INITIAL_Z }; // Camera's position
 
 // Camera movement
 double speed = 0.0;         // Camera movement speed
 double angularSpeed = 0.0;  // Camera rotation speed (yaw)
 double sightAngle = PI+1;      // Current camera direction angle (in the x-z plane)
 double pitch = 0.0;         // Camera angle in the y direction (pitch)
-double direction[3] = { sin(sightAngle), 0, cos(sightAngle) }; // Camera direction vector
+Vec3 direction = { sinf(sightAngle), 0, cosf(sightAngle) }; // Camera direction vector
 
 // UI
 bool isCaptured = false;     // Flag to check if mouse is dragging the slider
 double eyeOffset = 0;        // Slider eye offset
+bool useImpostors = false;   // Toggled with F2
+int pickX = 0, pickY = 0;    // Click to pick an owl part at
+unsigned picks = 0;
+bool pathTrace = false;      // Toggled with F3
+unsigned posters = 0;        // Incremented with F4
+
+// Owl model (render thread)
+OwlModel owl;
+double pupilsEyeOffset = 0;   // Slider value the pupils node was last set for
+CullSet owlCull;              // World bounding spheres, one per part
+Bvh owlBvh;                   // Boxes of the same spheres, refit when parts move
+int pickedPart = -1;          // Highlighted part, -1 for none
+unsigned picksDone = 0;       // Pick requests handled, compared with the snapshot's
+double pickMilliseconds = 0;
+DrawQueue drawQueue;          // Packets of the frame being drawn
+bool impostorsReady = false;  // Impostor shader compiled
+AssetPack assets;             // Mapped for the whole run when the meshes come from it
+PtScene pathScene;            // The owl as of pathEyeOffset, refined while the view stays at pathView
+PtScene pathBase;             // Every part but the pupils, which the slider moves
+bool pathBaseBuilt = false;
+PtRender pathRender;
+double pathEyeOffset = 0;
+Matrix4 pathView;
+bool pathSceneBuilt = false;
+BatchRange batchRange;
+unsigned postersDone = 0;     // Poster requests handled, compared with the snapshot's
+PosterStats posterStats;
+bool posterWritten = false;
+
+// Camera collision (simulation thread, built before it starts)
+CollisionWorld collision;
+CollisionMesh owlCollisionMesh; // Every part but the moving pupils, in world space
+
+// Slider panel (layout is fixed after init and read by both threads)
+UiPanel sliderPanel;
+
+// Threading
+SpscQueue<InputEvent, 256> inputEvents; // GLUT thread -> simulation thread
+TripleBuffer<FrameSnapshot> frames;     // Simulation thread -> render thread
+FrameSnapshot frame;                    // Snapshot being drawn (render thread only)
+
+// Camera matrices of the frame being drawn, computed on the CPU
+Matrix4 projection, view, viewProjection;
 
 // --- Function Prototypes ---
 // General
@@ -58,18 +178,42 @@ void specialKeyboard(int key, int x, int y);
 void mouseClick(int button, int state, int x, int y);
 void mouseDrag(int x, int y);
 
-// Geometric functions
-void DrawSphere(int n, int slices);
-void DrawCylinder1(int num_sides, double topr, double bottomr);
+// Simulation
+void simulationTick();
+void publishFrame();
+void handleSpecialKey(int key);
+void handleMouseClick(int button, int state, int x, int y);
+void handleMouseDrag(int x, int y);
 
 // Slider
-void drawSlider();
+void setupSlider();
 void sliderControl();
 
 // Owl
-void drawOwlBar();
+void buildOwl();
+void buildOwlCollision();
+void updatePupils();
+void updateOwlBounds();
+unsigned owlAssetKey();
+bool loadOwlMeshes();
+int bakeAssets(const char* path);
+void updateOwl();
 void drawOwl();
+int drawOwlParts();
+bool renderPoster(const char* path, int width, int height);
+void drawPosterTile(const Matrix4& tileProjection, void* data);
+void drawPathTraced();
+void buildPathScene();
+void addPathParts(PtScene& scene, bool pupils);
+bool isPupilPart(int part);
+int runBatch(const char* directory, int argc, char* argv[]);
+void buildBatchVariant(int variant, PtScene& scene, char name[BATCH_NAME_LENGTH], void* data);
 void drawBody();
+void drawImpostors();
+bool isImpostor(const OwlPart& part, const Matrix4& world);
+void drawPartGeometry(const DrawPacket& packet);
+void pickOwl();
+bool pickPart(void* data, int part, const Vec3& origin, const Vec3& direction, float* t);
 
 // --- Initialization ---
 void init() {
@@ -77,36 +221,56 @@ void init() {
 
     glClearColor(0.6, 0.6, 0.6, 0); // Background color
     glEnable(GL_DEPTH_TEST);    // Enable depth testing for 3D rendering
+
+    glewInit();    // Load FBO entry points for the cached slider panel and glyph atlases
+    DrawQueueInitRing(); // Per-object uniforms through a mapped ring when supported
+    impostorsReady = ImpostorInit();
+    TextLoadFont(GLUT_BITMAP_HELVETICA_12); // HUD font
+    setupSlider(); // Slider layout
+    buildOwl();    // Owl scene graph
+    if (loadOwlMeshes()) printf("Owl meshes mapped from %s\n", ASSET_PACK_FILE);
+    else OwlModelBuildMeshes(owl);
+    buildOwlCollision();
+
+    publishFrame(); // First snapshot, before the simulation thread starts
 }
 
 // --- Display and Rendering ---
 void display() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    frame = frames.read(); // Latest simulation state, never waits
+    view = MatLookAt(frame.eye, frame.eye + frame.direction, MakeVec3(0, 1, 0));
+    if (frame.posters != postersDone) // Before the frame's HUD lines, which the tiles' would crowd out
+        renderPoster(POSTER_FILE, POSTER_WIDTH, POSTER_WIDTH * VIEW_HEIGHT / WINDOW_WIDTH);
+
+    HudBeginFrame();
+    FrameArenaBeginFrame(); // Transient data from two frames ago is released here
+    HudPrint("frame arena %.1f KB  peak %.1f KB", FrameArenaLastFrameBytes() / 1024.0, FrameArenaPeakBytes() / 1024.0);
+
     // 3D Rendering
-    glViewport(0, SLIDER_HEIGHT, WINDOW_WIDTH, WINDOW_HEIGHT - SLIDER_HEIGHT);
+    glViewport(0, SLIDER_HEIGHT, WINDOW_WIDTH, VIEW_HEIGHT);
+    projection = MatFrustum(VIEW_FRUSTUM[0], VIEW_FRUSTUM[1], VIEW_FRUSTUM[2], VIEW_FRUSTUM[3], VIEW_FRUSTUM[4],
+        VIEW_FRUSTUM[5]); // Perspective projection
+    viewProjection = MatMultiply(projection, view);
     glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glFrustum(-1, 1, -1, 1, 1, 300); // Perspective projection
+    glLoadMatrixf(projection.m);
 
     glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    gluLookAt(eyeX, eyeY, eyeZ,
-        eyeX + direction[0], eyeY + direction[1], eyeZ + direction[2],
-        0, 1, 0);
+    glLoadMatrixf(view.m);
 
-    drawOwl(); // Draw the owl in the scene
+    if (frame.pathTrace) drawPathTraced(); // Instead of the rasterized owl
+    else drawOwl(); // Draw the owl in the scene
+    if (postersDone)
+        HudPrint("poster (F4) %s  %d tiles  %.1f s", posterWritten ? POSTER_FILE : "failed", posterStats.tiles,
+            posterStats.seconds);
 
     // 2D Rendering (for the slider)
-    glViewport(0, 0, WINDOW_WIDTH, SLIDER_HEIGHT);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, WINDOW_WIDTH, 0, SLIDER_HEIGHT, -1, 1); // Orthographic projection for 2D
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
     glDisable(GL_DEPTH_TEST); // Disable depth test for the 2D elements
 
-    drawSlider(); // Draw the slider at the bottom of the screen
+    UiSetSliderValue(sliderPanel, 0, frame.eyeOffset); // Re-renders the panel only if it moved
+    UiDraw(sliderPanel); // Draw the slider at the bottom of the screen
+    HudDraw(0, SLIDER_HEIGHT, WINDOW_WIDTH, VIEW_HEIGHT); // Stats over the 3D view
 
     glEnable(GL_DEPTH_TEST); // Re-enable depth testing
     glutSwapBuffers(); // Swap the front and back buffers
@@ -114,30 +278,74 @@ void display() {
 
 // --- Animation and Updates ---
 void idle() {
+    glutPostRedisplay(); // Request a redisplay
+}
+
+// --- Simulation (runs on the simulation thread) ---
+void simulationTick() {
+    InputEvent event;
+    while (inputEvents.pop(event)) {
+        switch (event.type) {
+        case INPUT_SPECIAL_KEY: handleSpecialKey(event.key); break;
+        case INPUT_MOUSE_BUTTON: handleMouseClick(event.button, event.state, event.x, event.y); break;
+        case INPUT_MOUSE_DRAG: handleMouseDrag(event.x, event.y); break;
+        }
+    }
+
     // Update camera orientation based on angular speed
     sightAngle += angularSpeed;
-    direction[0] = sin(sightAngle); // Update X direction
-    direction[1] = sin(pitch);      // Update Y direction
-    direction[2] = cos(sightAngle); // Update Z direction
-    // Update camera position based on speed and direction
-    eyeX += speed * direction[0];
-    eyeY += speed * direction[1];
-    eyeZ += speed * direction[2];
+    direction = MakeVec3(sinf(sightAngle), sinf(pitch), cosf(sightAngle)); // Update direction
+    // Update camera position based on speed and direction, sliding along the owl
+    eye = CollisionMove(collision, eye, eye + direction * speed, CAMERA_RADIUS);
 
-    glutPostRedisplay(); // Request a redisplay
+    publishFrame();
+}
+
+void publishFrame() {
+    FrameSnapshot& out = frames.writeSlot();
+    out.eye = eye;
+    out.direction = direction;
+    out.eyeOffset = eyeOffset;
+    out.impostors = useImpostors;
+    out.pickX = pickX;
+    out.pickY = pickY;
+    out.picks = picks;
+    out.pathTrace = pathTrace;
+    out.posters = posters;
+    frames.publish();
+}
+
+// --- Input forwarding (GLUT thread) ---
+// Callbacks only queue the raw event; all handling happens on the simulation thread
+void specialKeyboard(int key, int x, int y) {
+    InputEvent event = { INPUT_SPECIAL_KEY, key, 0, 0, x, y };
+    inputEvents.push(event);
+}
+
+void mouseClick(int button, int state, int x, int y) {
+    InputEvent event = { INPUT_MOUSE_BUTTON, 0, button, state, x, y };
+    inputEvents.push(event);
+}
+
+void mouseDrag(int x, int y) {
+    InputEvent event = { INPUT_MOUSE_DRAG, 0, 0, 0, x, y };
+    inputEvents.push(event);
 }
 
 // --- Mouse Interaction ---
-void mouseClick(int button, int state, int x, int y)
+void handleMouseClick(int button, int state, int x, int y)
 {
     if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
         int clickX = x;
         int clickY = WINDOW_HEIGHT - y;
-        int center = (WINDOW_WIDTH / 2.0) + eyeOffset;
 
-        if (clickY <= 75 && clickY >= 50 &&
-            clickX >= center - 10 && clickX <= center + 10)
+        if (UiHitTest(sliderPanel, &eyeOffset, clickX, clickY) == 0)
             isCaptured = true; // Start dragging the slider
+        else if (!UiPanelContains(sliderPanel, clickX, clickY)) { // In the 3D view: picked on the render thread
+            pickX = clickX;
+            pickY = clickY;
+            picks++;
+        }
     }
 
     if (button == GLUT_LEFT_BUTTON && state == GLUT_UP) {
@@ -145,19 +353,17 @@ void mouseClick(int button, int state, int x, int y)
     }
 }
 
-void mouseDrag(int x, int y)
+void handleMouseDrag(int x, int y)
 {
-    int highLimit = WINDOW_WIDTH - 40;
-    int lowLimit = 40;
-    int diff = x - WINDOW_WIDTH / 2; // +- 260
+    double value;
 
-    if (x > highLimit || x < lowLimit) return; // Limit slider dragging to slider area
+    if (!UiSliderDrag(sliderPanel, 0, x, &value)) return; // Limit slider dragging to slider area
 
-    if (isCaptured) eyeOffset = diff; // Change slider position when dragged
+    if (isCaptured) eyeOffset = value; // Change slider position when dragged
 }
 
 // --- Keyboard Interaction ---
-void specialKeyboard(int key, int x, int y) {
+void handleSpecialKey(int key) {
     switch (key) {
     case GLUT_KEY_LEFT:
         angularSpeed += 0.0001; // Rotate camera left
@@ -177,11 +383,38 @@ void specialKeyboard(int key, int x, int y) {
     case GLUT_KEY_PAGE_DOWN:
         pitch -= 0.01; // Decrease pitch angle
         break;
+    case GLUT_KEY_F2:
+        useImpostors = !useImpostors; // Ray-cast or tessellated ellipsoids
+        break;
+    case GLUT_KEY_F3:
+        pathTrace = !pathTrace; // Path traced still or rasterized view
+        break;
+    case GLUT_KEY_F4:
+        posters++; // Poster of the current view, rendered by the render thread
+        break;
     }
 }
 
 // --- Main function ---
 int main(int argc, char* argv[]) {
+    JobsStart(0); // One worker per core, used by culling
+    atexit(JobsStop);
+
+    const char* posterPath = 0;
+    int posterWidth = 0, posterHeight = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bake") == 0) // Write the asset pack instead of opening the window
+            return bakeAssets(i + 1 < argc ? argv[i + 1] : ASSET_PACK_FILE);
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) // Thumbnail per pupil position, no window
+            return runBatch(argv[i + 1], argc - i - 2, argv + i + 2);
+        if (strcmp(argv[i], "--poster") == 0 && i + 2 < argc) { // Write a poster of the starting view and exit
+            posterPath = argv[++i];
+            posterWidth = atoi(argv[++i]);
+            posterHeight = i + 1 < argc && argv[i + 1][0] != '-' ? atoi(argv[++i])
+                : posterWidth * VIEW_HEIGHT / WINDOW_WIDTH;
+        }
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH); // Initialize display mode
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);          // Set window size
@@ -194,225 +427,372 @@ int main(int argc, char* argv[]) {
     glutMouseFunc(mouseClick); //set mouse interaction function
     glutMotionFunc(mouseDrag); //set dragging interaction function
     init(); // Initialize the scene
+    if (posterPath) {
+        frame = frames.read();
+        view = MatLookAt(frame.eye, frame.eye + frame.direction, MakeVec3(0, 1, 0));
+        return renderPoster(posterPath, posterWidth, posterHeight) ? 0 : 1;
+    }
+
+    StartSimulation(simulationTick, SIM_TICKS_PER_SECOND); // Input and camera on their own thread
+    atexit(StopSimulation);
 
     glutMainLoop(); // Enter the main loop
     return 0;
 }
 
-// --- Geometric Functions ---
-void DrawSphere(int n, int slices)
-{
-    double beta, delta = PI / slices;
-
-    for (beta = -PI / 2; beta <= PI / 2; beta += delta)
-    {
-        glPushMatrix();
-        glTranslated(0, sin(beta), 0);
-        glScaled(1, sin(beta + delta) - sin(beta), 1);
-        DrawCylinder1(n, cos(beta + delta), cos(beta));
-        glPopMatrix();
-    }
+// --- Slider Implementation ---
+void sliderControl() {
+    // Function to add slider logic if needed
 }
 
-void DrawCylinder1(int num_sides, double topr, double bottomr)
-{
-    double alpha, teta = 2 * PI / num_sides;
+void setupSlider() {
+    UiInitPanel(sliderPanel, UiRect{ 0, 0, WINDOW_WIDTH, SLIDER_HEIGHT }, 0.62, 0.611, 0.015);
+
+    UiSlider slider = {};
+    slider.lineX0 = 50;                         // Line of the slider
+    slider.lineX1 = WINDOW_WIDTH - 50;
+    slider.lineY = SLIDER_HEIGHT / 2;
+    slider.knobX = WINDOW_WIDTH / 2;            // Knob
+    slider.knobBottom = 50;
+    slider.knobMid = 65;
+    slider.knobTop = 76;
+    slider.knobHalfWidth = 10;
+    slider.minValue = 40 - WINDOW_WIDTH / 2;    // Drag range, +- 260
+    slider.maxValue = WINDOW_WIDTH / 2 - 40;
+    UiAddSlider(sliderPanel, slider);
+}
 
-    for (alpha = 0; alpha <= 2 * PI; alpha += teta)
-    {
-        glBegin(GL_POLYGON);
-        glVertex3d(topr * sin(alpha), 1, topr * cos(alpha));// 1-st vertex
-        glVertex3d(topr * sin(alpha + teta), 1, topr * cos(alpha + teta));// 2-nd vertex
+// --- Owl Implementation ---
+// Builds the owl's scene graph once, with one bounding sphere per part
+void buildOwl() {
+    OwlModelBuild(owl);
+    for (int i = 0; i < owl.numParts; i++) CullSetAdd(owlCull);
+    pupilsEyeOffset = 0;
+    updateOwlBounds();
+
+    std::vector<Aabb> bounds(owl.numParts);
+    for (int i = 0; i < owl.numParts; i++)
+        bounds[i] = SphereAabb(MakeVec3(owlCull.x[i], owlCull.y[i], owlCull.z[i]), owlCull.radius[i]);
+    BvhBuild(owlBvh, bounds.data(), owl.numParts);
+}
 
-        glVertex3d(bottomr * sin(alpha + teta), 0, bottomr * cos(alpha + teta));// 3-d vertex
-        glVertex3d(bottomr * sin(alpha), 0, bottomr * cos(alpha));// 4-th vertex
-        glEnd();
-    }
+// One collider with the parts' triangles in world space; the pupils move
+// with the slider and sit inside the eyes, so they are left out
+void buildOwlCollision() {
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+    for (int i = 0; i < owl.numParts; i++)
+        if (!isPupilPart(i)) CollisionMeshAddPacked(owlCollisionMesh, owl.meshes[i], world[owl.parts[i].node]);
+    CollisionAdd(collision, owlCollisionMesh, MatIdentity());
+    CollisionBuild(collision);
 }
 
-// --- Slider Implementation ---
-void sliderControl() {
-    // Function to add slider logic if needed
+// Parts under the pupils group node, which the slider moves
+bool isPupilPart(int part) {
+    int node = owl.parts[part].node;
+    while (node != -1 && node != owl.pupilsNode) node = owl.graph.nodes[node].parent;
+    return node != -1;
 }
 
-void drawSlider() {
-    //background of the slider
-    glColor3d(0.62, 0.611, 0.015);
-    glBegin(GL_POLYGON);
-    glVertex2d(0, 0);
-    glVertex2d(0, SLIDER_HEIGHT);
-    glVertex2d(WINDOW_WIDTH, SLIDER_HEIGHT);
-    glVertex2d(WINDOW_WIDTH, 0);
-    glEnd();
-
-    //line of the slider
-    glColor3d(0, 0, 0);
-    glLineWidth(2);
-    glBegin(GL_LINES);
-    glVertex2d(50, SLIDER_HEIGHT / 2.0);
-    glVertex2d(WINDOW_WIDTH - 50, SLIDER_HEIGHT / 2.0);
-    glEnd();
-    glLineWidth(1);
-
-    //slider
-    glColor3d(1, 0, 0);
-    glPushMatrix();
-    glTranslated(eyeOffset, 0, 0);
-    glBegin(GL_POLYGON);
-    glVertex2d(WINDOW_WIDTH / 2.0, 76);
-    glVertex2d((WINDOW_WIDTH / 2.0) + 10, 65);
-    glVertex2d((WINDOW_WIDTH / 2.0) + 10, 50);
-    glVertex2d((WINDOW_WIDTH / 2.0) - 10, 50);
-    glVertex2d((WINDOW_WIDTH / 2.0) - 10, 65);
-    glEnd();
-    glPopMatrix();
+// Moves the pupils group; only it and its children get new world matrices
+void updatePupils() {
+    OwlModelSetPupils(owl, frame.eyeOffset);
+    pupilsEyeOffset = frame.eyeOffset;
 }
 
-// --- Owl Implementation ---
-void drawOwlBar() {
-    double alpha, teta = 2 * PI / 30;
-
-    glColor3d(0.2, 0.2, 0);
-    glPushMatrix();
-    glTranslated(0, 0, -10);
-    glRotated(90, 0, 0, 1);
-    glScaled(1, 70, 1);
-    for (alpha = 0; alpha <= 2 * PI; alpha += teta)
-    {
-        glBegin(GL_POLYGON);
-        glTexCoord2d(0, 0); glVertex3d(1 * sin(alpha), 1, 1 * cos(alpha));// 1-st vertex
-        glTexCoord2d(2, 0); glVertex3d(1 * sin(alpha + teta), 1, 1 * cos(alpha + teta));// 2-nd vertex
-        glTexCoord2d(2, 1); glVertex3d(1 * sin(alpha + teta), 0, 1 * cos(alpha + teta));// 3-d vertex
-        glTexCoord2d(0, 1); glVertex3d(1 * sin(alpha), 0, 1 * cos(alpha));// 4-th vertex
-        glEnd();
+// World bounding spheres follow only the nodes moved by the last SceneUpdate
+void updateOwlBounds() {
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+
+    for (int i = 0; i < owl.numParts; i++) {
+        const OwlPart& part = owl.parts[i];
+        if (!owl.graph.changed[part.node]) continue;
+
+        Vec3 center;
+        float radius;
+        TransformSphere(world[part.node], part.boundCenter, part.boundRadius, &center, &radius);
+        CullSetSphere(owlCull, i, center, radius);
+        if (!owlBvh.nodes.empty()) BvhMove(owlBvh, i, SphereAabb(center, radius));
     }
+    BvhRefit(owlBvh);
+}
 
-    glPopMatrix();
+// Pupils, world matrices and bounds as of the frame's slider value
+void updateOwl() {
+    if (frame.eyeOffset != pupilsEyeOffset) updatePupils();
+    SceneUpdate(owl.graph); // Recomputes only moved nodes
+    updateOwlBounds();
 }
 
 void drawOwl() {
-    drawOwlBar(); // Draw owl bar
-    drawBody(); // Draw owl body
+    updateOwl();
+    HudPrint("scene nodes %d  updated %d", (int)owl.graph.nodes.size(), owl.graph.lastUpdateCount);
+
+    int visible = drawOwlParts();
+    HudPrint("parts drawn %d / %d", visible, owl.numParts);
+    if (frame.picks != picksDone) pickOwl();
+    if (pickedPart >= 0) HudPrint("picked part %d  %.3f ms", pickedPart, pickMilliseconds);
+    HudPrint("draw packets %d  state changes %d", (int)drawQueue.packets.size(), drawQueue.lastStateChanges);
+    HudPrint("uniform ring %s  stalls %d", DrawQueueUsesRing() ? "on" : "off", DrawQueueRingStalls());
+    HudPrint("impostors %s (F2)", frame.impostors && impostorsReady ? "on" : "off");
+    HudPrint("mesh triangles %d -> %d  ACMR %.2f -> %.2f", owl.meshesBefore.triangles, owl.meshesAfter.triangles,
+        owl.meshesBefore.acmr, owl.meshesAfter.acmr);
 }
 
+// Culls and draws the parts for the camera in projection, view and
+// viewProjection; returns how many are in view
+int drawOwlParts() {
+    int visible = CullSetRun(owlCull, FrustumFromMatrix(viewProjection)); // Tests every part at once
+    DrawQueueBegin(drawQueue, projection, view);
+    drawBody(); // Record owl body and bar
+    DrawQueueSubmit(drawQueue);
+    drawImpostors(); // Spheres left out of the queue
+    return visible;
+}
+
+// Records a packet per visible part, placed by the flat array of cached world matrices
 void drawBody() {
-    double pupilRadius = 1.5; // Adjust as needed
-    double angle = eyeOffset * 0.01; // Adjust scaling factor as needed for a smooth circular movement
-    double pupilX = pupilRadius * cos(angle);
-    double pupilY = pupilRadius * sin(angle);
-
-    //main body
-    glColor3d(0.4, 0.29, 0);
-    glPushMatrix();
-    glTranslated(-35, 14, -5);
-    glScaled(13, 15, 20);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    //side body
-    glColor3d(0.69, 0.49, 0);
-    glPushMatrix();
-    glTranslated(-35, 14, 0);
-    glRotated(90, 0, 0, 1);
-    glScaled(11, 20, 10);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    //nose
-    glPushMatrix();
-    glTranslated(-35, 17, 10);
-    glScaled(2, 4, 10);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    //left legs
-    glPushMatrix();
-    glTranslated(-42, 0, -5);
-    glScaled(0.8, 4, 0);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-40, 0, -5);
-    glScaled(0.8, 4, 0);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-38, 0, -5);
-    glScaled(0.8, 4, 0);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    //right legs
-    glPushMatrix();
-    glTranslated(10, 0, 0);
-    glPushMatrix();
-    glTranslated(-42, 0, -5);
-    glScaled(0.8, 4, 0);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-40, 0, -5);
-    glScaled(0.8, 4, 0);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslated(-38, 0, -5);
-    glScaled(0.8, 4, 0);
-    DrawSphere(20, 20);
-    glPopMatrix();
-    glPopMatrix();
-
-    //head 
-    glColor3d(0.4, 0.29, 0);
-    glPushMatrix();
-    glTranslated(-35, 13.2, 6.9);
-    glScaled(1.1, 10, 1);
-    glRotated(45, 0, 1, 0);
-    DrawCylinder1(4, 13, 0);
-    glPopMatrix();
-
-
-
-    //left eye
-    glColor3d(1, 1, 1);
-    glPushMatrix();
-    glTranslated(-39, 20, 11.5);
-    glScaled(4, 4, 3);
-    DrawSphere(17, 17);
-    glPopMatrix();
-
-    //right eye
-    glPushMatrix();
-    glTranslated(8, 0, 0);
-    glPushMatrix();
-    glTranslated(-39, 20, 11.5);
-    glScaled(4, 4, 3);
-    DrawSphere(15, 15);
-    glPopMatrix();
-    glPopMatrix();
-
-    //left pupil
-    glColor3d(0, 0, 0);
-    glPushMatrix();
-    glTranslated(pupilX, pupilY, 0);
-    glPushMatrix();
-    glTranslated(-39.3, 19, 15);
-    glScaled(0.7, 0.7, 0.7);
-    DrawSphere(20, 20);
-    glPopMatrix();
-
-    //right pupil
-    glPushMatrix();
-    glTranslated(8.5, 0, 0);
-    glPushMatrix();
-    glTranslated(-39.3, 19, 15);
-    glScaled(0.7, 0.7, 0.7);
-    DrawSphere(20, 20);
-    glPopMatrix();
-    glPopMatrix();
-    glPopMatrix();
-}
\ No newline at end of file
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+
+    for (int i = 0; i < owl.numParts; i++) {
+        const OwlPart& part = owl.parts[i];
+        if (!owlCull.visible[i]) continue; // Outside the view
+        if (isImpostor(part, world[part.node])) continue;
+
+        Vec3 center = MakeVec3(owlCull.x[i], owlCull.y[i], owlCull.z[i]);
+        DrawPacket& packet = DrawQueueAdd(drawQueue, MATERIAL_COLOR, 0, center, drawPartGeometry);
+        if (i == pickedPart) DrawPacketColor(packet, PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2]);
+        else DrawPacketColor(packet, part.color[0], part.color[1], part.color[2]);
+        DrawPacketWorld(packet, world[part.node]);
+        packet.params[0] = i;
+    }
+}
+
+// Ellipsoids as ray-cast boxes: 12 triangles each instead of a tessellated sphere
+void drawImpostors() {
+    if (!frame.impostors || !impostorsReady) return;
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+
+    ImpostorBegin();
+    for (int i = 0; i < owl.numParts; i++) {
+        const OwlPart& part = owl.parts[i];
+        if (!owlCull.visible[i] || !isImpostor(part, world[part.node])) continue;
+        const double* color = part.color;
+        double highlight[3] = { PICK_HIGHLIGHT[0], PICK_HIGHLIGHT[1], PICK_HIGHLIGHT[2] };
+        if (i == pickedPart) color = highlight;
+        ImpostorEllipsoid(world[part.node], color[0], color[1], color[2]);
+    }
+    ImpostorEnd();
+}
+
+// Flat parts such as the legs (zero depth) stay tessellated
+bool isImpostor(const OwlPart& part, const Matrix4& world) {
+    return frame.impostors && impostorsReady && part.shape == OWL_SPHERE && ImpostorCanDraw(world);
+}
+
+void drawPartGeometry(const DrawPacket& packet) {
+    PackedMeshDraw(owl.meshes[(int)packet.params[0]]);
+}
+
+// Click ray through the 3D viewport against the parts' boxes, then the hit
+// candidates' triangles; clicking empty space clears the selection
+void pickOwl() {
+    picksDone = frame.picks;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PickRay ray = PickRayFromWindow(viewProjection, 0, SLIDER_HEIGHT, WINDOW_WIDTH, VIEW_HEIGHT,
+        frame.pickX, frame.pickY);
+    float t;
+    pickedPart = BvhRaycast(owlBvh, ray.origin, ray.direction, PICK_DISTANCE, pickPart, 0, &t);
+    pickMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool pickPart(void*, int part, const Vec3& origin, const Vec3& direction, float* t) {
+    PickRay ray = { origin, direction };
+    return PickMesh(ray, SceneWorldMatrices(owl.graph)[owl.parts[part].node], owl.meshes[part], t);
+}
+
+// --- Poster (F4, --poster FILE W [H]) ---
+// The rasterized owl at any size, tile by tile (see poster.h), from the
+// camera in view. Each tile gets its own projection and is culled and drawn
+// as display() does, all within the one frame. The band buffers and writer
+// thread are the poster's own, so that frame is not held to the arena's
+// steady-state check.
+bool renderPoster(const char* path, int width, int height) {
+    postersDone = frame.posters;
+    FrameArenaSkipCheck();
+    updateOwl();
+    posterWritten = width > 0 && height > 0 &&
+        PosterRender(path, width, height, VIEW_FRUSTUM, drawPosterTile, 0, &posterStats);
+    if (posterWritten)
+        printf("Poster %s: %d x %d, %d tiles in %d bands, %.1f s, %.1f MB of band buffers\n", path, width, height,
+            posterStats.tiles, posterStats.bands, posterStats.seconds, posterStats.peakBytes / 1048576.0);
+    else
+        printf("Poster %s: %d x %d could not be rendered or written\n", path, width, height);
+    return posterWritten;
+}
+
+void drawPosterTile(const Matrix4& tileProjection, void*) {
+    projection = tileProjection;
+    viewProjection = MatMultiply(projection, view);
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(projection.m);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(view.m);
+    drawOwlParts();
+}
+
+// --- Path tracer ---
+// Every part's mesh in its part color, with the pupils where the slider puts them
+void buildPathScene() {
+    if (!pathBaseBuilt) {
+        PtSceneBegin(pathBase, PATH_SKY, PATH_SUN_DIRECTION, PATH_SUN);
+        addPathParts(pathBase, false);
+        pathBaseBuilt = true;
+    }
+    pathScene = pathBase;
+    addPathParts(pathScene, true);
+    PtSceneBuild(pathScene);
+    pathEyeOffset = frame.eyeOffset;
+    pathSceneBuilt = true;
+}
+
+// The pupils' parts or all the others, placed by the current world matrices
+void addPathParts(PtScene& scene, bool pupils) {
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+    for (int i = 0; i < owl.numParts; i++) {
+        const OwlPart& part = owl.parts[i];
+        if (isPupilPart(i) != pupils) continue;
+        int material = PtSceneAddMaterial(scene, part.color[0], part.color[1], part.color[2], -1);
+        PtSceneAddMesh(scene, world[part.node], owl.meshes[i], material, true);
+    }
+}
+
+// One more pass per frame while the view and slider stay put; any change starts over
+void drawPathTraced() {
+    updateOwl(); // Keeps the culling and picking bounds in step for the rasterized view
+    bool sceneChanged = !pathSceneBuilt || frame.eyeOffset != pathEyeOffset;
+    if (sceneChanged) buildPathScene();
+    if (sceneChanged || memcmp(viewProjection.m, pathView.m, sizeof(pathView.m)) != 0) {
+        PtRenderReset(pathRender, WINDOW_WIDTH, VIEW_HEIGHT, viewProjection, frame.eye);
+        pathView = viewProjection;
+    }
+    PtRenderPass(pathRender, pathScene);
+
+    glWindowPos2i(0, SLIDER_HEIGHT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glDrawPixels(pathRender.width, pathRender.height, GL_RGB, GL_UNSIGNED_BYTE, pathRender.pixels.data());
+    HudPrint("path tracer (F3)  %d triangles  %d samples/pixel", (int)pathScene.triangles.size(), pathRender.samples);
+    HudPrint("%.2f M samples/s  %.2f M rays/s  %.0f ms/pass", pathRender.samplesPerSecond / 1e6,
+        pathRender.raysPerSecond / 1e6, pathRender.passMilliseconds);
+}
+
+// --- Thumbnail batch (--batch DIR [eye=A:B[:N]] [size=N] [samples=N]) ---
+// A path traced thumbnail per pupil position, from the starting eye
+// position turned towards the owl's center, without a window. Everything but the pupils is built into pathBase once.
+int runBatch(const char* directory, int argc, char* argv[]) {
+    BatchSettings settings;
+    settings.directory = directory;
+    settings.width = BATCH_SIZE;
+    settings.samples = BATCH_SAMPLES;
+    batchRange = BATCH_EYE_RANGE;
+    if (!BatchParseArgs(argc, argv, &batchRange, 1, settings)) return 1;
+    settings.height = settings.width * VIEW_HEIGHT / WINDOW_WIDTH;
+
+    buildOwl();
+    if (!loadOwlMeshes()) OwlModelBuildMeshes(owl);
+    Aabb bounds = SphereAabb(MakeVec3(owlCull.x[0], owlCull.y[0], owlCull.z[0]), owlCull.radius[0]);
+    for (int i = 1; i < owl.numParts; i++) {
+        Aabb part = SphereAabb(MakeVec3(owlCull.x[i], owlCull.y[i], owlCull.z[i]), owlCull.radius[i]);
+        bounds.min = Min(bounds.min, part.min);
+        bounds.max = Max(bounds.max, part.max);
+    }
+    settings.viewProjection = MatMultiply(MatFrustum(VIEW_FRUSTUM[0], VIEW_FRUSTUM[1], VIEW_FRUSTUM[2],
+        VIEW_FRUSTUM[3], VIEW_FRUSTUM[4], VIEW_FRUSTUM[5]), MatLookAt(eye, (bounds.min + bounds.max) * 0.5f,
+        MakeVec3(0, 1, 0)));
+    settings.eye = eye;
+    PtSceneBegin(pathBase, PATH_SKY, PATH_SUN_DIRECTION, PATH_SUN);
+    addPathParts(pathBase, false);
+    pathBaseBuilt = true;
+
+    int variants = BatchVariantCount(&batchRange, 1);
+    printf("batch: %d variants, %dx%d at %d samples/pixel, %d workers\n", variants, settings.width,
+        settings.height, settings.samples, JobsWorkerCount());
+    BatchStats stats;
+    bool written = BatchRender(variants, buildBatchVariant, 0, settings, &stats);
+    printf("batch: %d images in %.2f s, %.2f images/s  (scene %.1f ms, render %.1f ms per image)\n", stats.images,
+        stats.seconds, stats.images / stats.seconds, stats.buildMilliseconds, stats.renderMilliseconds);
+    return written ? 0 : 1;
+}
+
+// Runs on a worker, while the previous variant renders; nothing else
+// touches the scene graph meanwhile
+void buildBatchVariant(int variant, PtScene& scene, char name[BATCH_NAME_LENGTH], void*) {
+    double eyeOffset = BatchValue(&batchRange, 1, variant, 0);
+    OwlModelSetPupils(owl, eyeOffset);
+    SceneUpdate(owl.graph);
+
+    scene = pathBase;
+    addPathParts(scene, true);
+    PtSceneBuild(scene);
+    snprintf(name, BATCH_NAME_LENGTH, "owl_eye%+.1f", eyeOffset);
+}
+
+// --- Asset pack ---
+// Everything the meshes are built from: shapes, tessellation and the world
+// matrices degenerate triangles are judged under. Editing buildOwl changes
+// the key, so an old pack is ignored rather than drawn.
+unsigned owlAssetKey() {
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+    unsigned key = AssetHash(ASSET_HASH_SEED, &OWL_ASSET_REVISION, sizeof(OWL_ASSET_REVISION));
+    key = AssetHash(key, &owl.numParts, sizeof(owl.numParts));
+    for (int i = 0; i < owl.numParts; i++) {
+        const OwlPart& part = owl.parts[i];
+        int shape[3] = { part.shape, part.sides, part.slices };
+        key = AssetHash(key, shape, sizeof(shape));
+        key = AssetHash(key, world[part.node].m, sizeof(world[part.node].m));
+    }
+    return key;
+}
+
+// Meshes stay in the mapped file; false leaves the pack closed
+bool loadOwlMeshes() {
+    if (!AssetPackOpen(assets, ASSET_PACK_FILE, owlAssetKey())) return false;
+
+    size_t size;
+    const MeshStats* stats = (const MeshStats*)AssetPackFind(assets, "owl/stats", &size);
+    bool found = stats && size == 2 * sizeof(MeshStats);
+    for (int i = 0; i < owl.numParts && found; i++) {
+        char name[ASSET_NAME_LENGTH];
+        snprintf(name, sizeof(name), "owl/part%d", i);
+        found = AssetPackFindMesh(assets, name, owl.meshes[i]);
+    }
+    if (!found) {
+        AssetPackClose(assets);
+        return false;
+    }
+    owl.meshesBefore = stats[0];
+    owl.meshesAfter = stats[1];
+    return true;
+}
+
+// --bake [file]: builds the meshes procedurally and writes them out
+int bakeAssets(const char* path) {
+    buildOwl();
+    OwlModelBuildMeshes(owl);
+
+    AssetPackWriter writer;
+    AssetPackWriterInit(writer, owlAssetKey());
+    MeshStats stats[2] = { owl.meshesBefore, owl.meshesAfter };
+    AssetPackAdd(writer, "owl/stats", stats, sizeof(stats));
+    for (int i = 0; i < owl.numParts; i++) {
+        char name[ASSET_NAME_LENGTH];
+        snprintf(name, sizeof(name), "owl/part%d", i);
+        AssetPackAddMesh(writer, name, owl.meshes[i]);
+    }
+
+    if (!AssetPackWrite(writer, path)) {
+        printf("Could not write %s\n", path);
+        return 1;
+    }
+    printf("Baked %d meshes into %s\n", owl.numParts, path);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "jobs.h"
+#include "mesh_cache.h"
+
+void MeshCacheInit(MeshCache& cache, MeshBuildFunction build) {
+    cache.build = build;
+    for (int i = 0; i < MESH_CACHE_CAPACITY; i++) {
+        cache.slots[i].valid = false;
+        cache.slots[i].lastUse = 0;
+    }
+    cache.front = cache.building = -1;
+    cache.built.store(false);
+    cache.frame = 0;
+    cache.hits = cache.misses = cache.evictions = 0;
+}
+
+static void buildJob(void* data) {
+    MeshCache& cache = *(MeshCache*)data;
+    MeshCacheSlot& slot = cache.slots[cache.building];
+    cache.build(slot.key, slot.mesh);
+    cache.built.store(true, std::memory_order_release); // Publishes the mesh to the render thread
+}
+
+static int findSlot(const MeshCache& cache, unsigned key) {
+    for (int i = 0; i < MESH_CACHE_CAPACITY; i++)
+        if (cache.slots[i].valid && cache.slots[i].key == key && i != cache.building) return i;
+    return -1;
+}
+
+// An empty slot, else the least recently used one that is not being drawn
+static int evictSlot(MeshCache& cache) {
+    int best = -1;
+    for (int i = 0; i < MESH_CACHE_CAPACITY; i++) {
+        if (i == cache.front) continue;
+        if (!cache.slots[i].valid) return i;
+        if (best < 0 || cache.slots[i].lastUse < cache.slots[best].lastUse) best = i;
+    }
+    cache.evictions++;
+    return best;
+}
+
+static void startBuild(MeshCache& cache, unsigned key) {
+    int slot = evictSlot(cache);
+    cache.slots[slot].valid = false;
+    cache.slots[slot].key = key;
+    cache.building = slot;
+    cache.misses++;
+
+    if (JobsWorkerCount() == 1) { // No other thread would pick the job up
+        buildJob(&cache);
+        return;
+    }
+    JobCounter first(0); // Only counted, and waited for, when there is nothing to draw yet
+    JobRun(JobCreate(buildJob, &cache, cache.front < 0 ? &first : 0));
+    JobWait(first);
+}
+
+// Marks a finished build valid; it becomes the front when it is what the caller wants
+static void finishBuild(MeshCache& cache, unsigned key) {
+    if (cache.building < 0 || !cache.built.load(std::memory_order_acquire)) return;
+    cache.slots[cache.building].valid = true;
+    if (cache.slots[cache.building].key == key) cache.front = cache.building;
+    cache.building = -1;
+    cache.built.store(false, std::memory_order_relaxed);
+}
+
+const MeshCacheSlot* MeshCacheGet(MeshCache& cache, unsigned key) {
+    cache.frame++;
+    finishBuild(cache, key);
+
+    if (cache.front < 0 || cache.slots[cache.front].key != key) {
+        int slot = findSlot(cache, key);
+        if (slot >= 0) {
+            cache.front = slot;
+            cache.hits++;
+        }
+        else if (cache.building < 0) {
+            startBuild(cache, key);
+            finishBuild(cache, key); // Done already when built inline or waited for
+        }
+    }
+
+    if (cache.front < 0) return 0;
+    cache.slots[cache.front].lastUse = cache.frame;
+    return &cache.slots[cache.front];
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include "vertex_format.h"
+
+// --- Parameterized mesh cache ---
+// Meshes that depend on a few quantized parameters (the house's floor count
+// and window repeat) are built once per parameter set and kept in a small
+// LRU cache keyed on them. A missing mesh is built by a job on another
+// worker while the previous mesh keeps being drawn; the finished mesh is
+// swapped in at the start of a later frame, so a slider drag never waits on
+// a build. One build runs at a time. Parameters that change mid-build are
+// picked up when it finishes; the intermediate mesh is still cached.
+//
+// With a single worker there is no other thread to build on, and the build
+// runs inline.
+
+const int MESH_CACHE_CAPACITY = 8;
+
+typedef void (*MeshBuildFunction)(unsigned key, PackedMesh& mesh); // Runs on a worker thread
+
+struct MeshCacheSlot {
+    unsigned key;
+    PackedMesh mesh;
+    unsigned lastUse; // Frame it was last handed out
+    bool valid;
+};
+
+struct MeshCache {
+    MeshBuildFunction build;
+    MeshCacheSlot slots[MESH_CACHE_CAPACITY];
+    int front;                 // Slot being drawn, -1 before the first mesh
+    int building;              // Slot the job fills, -1 when idle
+    std::atomic<bool> built;   // Set by the job when the slot is ready
+    unsigned frame;
+    int hits, misses, evictions;
+};
+
+void MeshCacheInit(MeshCache& cache, MeshBuildFunction build);
+// Once per frame: the slot to draw, holding key's mesh or the last one
+// drawn until that is built. Only the very first call waits for a build.
+const MeshCacheSlot* MeshCacheGet(MeshCache& cache, unsigned key);
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <math.h>
+#include <unordered_map>
+#include "glew.h"
+#include "glut.h"
+#include "mesh_opt.h"
+
+// Weld tolerance: positions and texture coordinates snap to this grid
+static const float WELD_GRID = 1e-5f;
+
+// LRU cache size the vertex cache pass optimizes for (Forsyth's default)
+static const int FORSYTH_CACHE_SIZE = 32;
+
+// --- Helpers ---
+static Vec3 position(const PrimitiveVertex& v) {
+    return MakeVec3(v.x, v.y, v.z);
+}
+
+struct WeldKey {
+    long long x, y, z, u, v;
+    bool operator==(const WeldKey& o) const { return x == o.x && y == o.y && z == o.z && u == o.u && v == o.v; }
+};
+
+struct WeldHash {
+    size_t operator()(const WeldKey& k) const {
+        unsigned long long h = 1469598103934665603ULL;
+        const long long parts[] = { k.x, k.y, k.z, k.u, k.v };
+        for (int i = 0; i < 5; i++) h = (h ^ (unsigned long long)parts[i]) * 1099511628211ULL;
+        return (size_t)h;
+    }
+};
+
+static long long snap(float value) {
+    return (long long)floorf(value / WELD_GRID + 0.5f);
+}
+
+// Keeps the vertices in newIndex order; newIndex[i] < 0 drops vertex i
+static void remapVertices(Mesh& mesh, const std::vector<int>& newIndex, int count) {
+    std::vector<PrimitiveVertex> vertices(count);
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        if (newIndex[i] >= 0) vertices[newIndex[i]] = mesh.vertices[i];
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i++) mesh.indices[i] = newIndex[mesh.indices[i]];
+    mesh.vertices.swap(vertices);
+}
+
+// --- Construction ---
+void MeshFromQuads(Mesh& mesh, const PrimitiveVertex* quads, int vertexCount) {
+    mesh.vertices.assign(quads, quads + vertexCount);
+    mesh.indices.clear();
+    for (unsigned q = 0; q + 3 < (unsigned)vertexCount; q += 4) {
+        unsigned quad[] = { q, q + 1, q + 2, q, q + 2, q + 3 };
+        mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+    }
+}
+
+// --- Weld and clean up ---
+void MeshWeld(Mesh& mesh, bool positionsOnly) {
+    std::unordered_map<WeldKey, int, WeldHash> unique;
+    std::vector<int> newIndex(mesh.vertices.size());
+    int count = 0;
+
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const PrimitiveVertex& v = mesh.vertices[i];
+        WeldKey key = { snap(v.x), snap(v.y), snap(v.z), positionsOnly ? 0 : snap(v.u), positionsOnly ? 0 : snap(v.v) };
+        std::pair<std::unordered_map<WeldKey, int, WeldHash>::iterator, bool> found = unique.insert(std::make_pair(key, count));
+        newIndex[i] = found.first->second; // The first copy survives
+        if (found.second) count++;
+    }
+
+    // Survivors are first copies, so they keep their relative order
+    std::vector<PrimitiveVertex> vertices(count);
+    for (size_t i = mesh.vertices.size(); i-- > 0;) vertices[newIndex[i]] = mesh.vertices[i];
+    for (size_t i = 0; i < mesh.indices.size(); i++) mesh.indices[i] = newIndex[mesh.indices[i]];
+    mesh.vertices.swap(vertices);
+}
+
+int MeshRemoveDegenerate(Mesh& mesh, const Matrix4& world) {
+    size_t kept = 0;
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        unsigned a = mesh.indices[t], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+        if (a == b || b == c || a == c) continue;
+
+        // Linear part only: translation does not change area
+        Vec3 pa = MatTransformVector(world, position(mesh.vertices[a]));
+        Vec3 e1 = MatTransformVector(world, position(mesh.vertices[b])) - pa;
+        Vec3 e2 = MatTransformVector(world, position(mesh.vertices[c])) - pa;
+        Vec3 n = Cross(e1, e2);
+        if (Dot(n, n) <= 1e-12f * Dot(e1, e1) * Dot(e2, e2)) continue; // Sine of the corner angle ~ 0
+
+        mesh.indices[kept++] = a;
+        mesh.indices[kept++] = b;
+        mesh.indices[kept++] = c;
+    }
+    int removed = (int)(mesh.indices.size() - kept) / 3;
+    mesh.indices.resize(kept);
+
+    // Drop vertices no triangle uses any more
+    std::vector<int> newIndex(mesh.vertices.size(), -1);
+    int count = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        if (newIndex[mesh.indices[i]] < 0) newIndex[mesh.indices[i]] = 0;
+    }
+    for (size_t i = 0; i < newIndex.size(); i++) {
+        if (newIndex[i] == 0) newIndex[i] = count++;
+    }
+    remapVertices(mesh, newIndex, count);
+    return removed;
+}
+
+// --- Vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation") ---
+static float vertexScore(int cachePosition, int remaining) {
+    if (remaining == 0) return -1;
+
+    float score = 0;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) score = 0.75f; // Just used: discourages strips of one triangle
+        else score = powf(1 - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / sqrtf((float)remaining); // Finish off vertices with few triangles left
+}
+
+void MeshOptimizeVertexCache(Mesh& mesh) {
+    int numTriangles = (int)mesh.indices.size() / 3;
+    int numVertices = (int)mesh.vertices.size();
+    if (numTriangles == 0) return;
+
+    // Triangles of each vertex, compacted as triangles are emitted
+    std::vector<int> offset(numVertices + 1, 0), remaining(numVertices, 0);
+    for (size_t i = 0; i < mesh.indices.size(); i++) remaining[mesh.indices[i]]++;
+    for (int v = 0; v < numVertices; v++) offset[v + 1] = offset[v] + remaining[v];
+    std::vector<int> adjacency(offset[numVertices]), fill(offset.begin(), offset.end() - 1);
+    for (int t = 0; t < numTriangles; t++) {
+        for (int k = 0; k < 3; k++) adjacency[fill[mesh.indices[t * 3 + k]]++] = t;
+    }
+
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> score(numVertices), triangleScore(numTriangles);
+    std::vector<unsigned char> emitted(numTriangles, 0);
+    for (int v = 0; v < numVertices; v++) score[v] = vertexScore(-1, remaining[v]);
+    for (int t = 0; t < numTriangles; t++) {
+        triangleScore[t] = score[mesh.indices[t * 3]] + score[mesh.indices[t * 3 + 1]] + score[mesh.indices[t * 3 + 2]];
+    }
+
+    std::vector<unsigned> order;
+    order.reserve(mesh.indices.size());
+    int cache[FORSYTH_CACHE_SIZE + 3], cacheSize = 0;
+    int best = 0, scan = 0;
+    for (int t = 1; t < numTriangles; t++) {
+        if (triangleScore[t] > triangleScore[best]) best = t;
+    }
+
+    while (best >= 0) {
+        emitted[best] = 1;
+        const unsigned* tri = &mesh.indices[best * 3];
+        order.insert(order.end(), tri, tri + 3);
+
+        // Move the triangle's vertices to the front of the LRU cache
+        int next[FORSYTH_CACHE_SIZE + 3], nextSize = 0;
+        for (int k = 0; k < 3; k++) next[nextSize++] = tri[k];
+        for (int i = 0; i < cacheSize; i++) {
+            int v = cache[i];
+            if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2]) next[nextSize++] = v;
+        }
+        for (int k = 0; k < 3; k++) {
+            int v = tri[k];
+            int* begin = &adjacency[offset[v]];
+            int* end = begin + remaining[v];
+            std::remove(begin, end, best);
+            remaining[v]--;
+        }
+
+        // Rescore everything that was or is in the cache
+        for (int i = 0; i < nextSize; i++) {
+            int v = next[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        cacheSize = nextSize < FORSYTH_CACHE_SIZE ? nextSize : FORSYTH_CACHE_SIZE;
+        for (int i = 0; i < cacheSize; i++) cache[i] = next[i];
+
+        // Best triangle touching the cache; otherwise the first one left
+        best = -1;
+        float bestScore = -1;
+        for (int i = 0; i < nextSize; i++) {
+            int v = next[i];
+            for (int j = 0; j < remaining[v]; j++) {
+                int t = adjacency[offset[v] + j];
+                const unsigned* o = &mesh.indices[t * 3];
+                triangleScore[t] = score[o[0]] + score[o[1]] + score[o[2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        if (best < 0) {
+            while (scan < numTriangles && emitted[scan]) scan++;
+            best = scan < numTriangles ? scan : -1;
+        }
+    }
+    mesh.indices.swap(order);
+}
+
+// --- Overdraw (Sander, Nehab and Barczak, "Fast Triangle Reordering") ---
+struct Cluster {
+    int first, count; // Triangle range in the cache-optimized order
+    float sortKey;    // How much the cluster faces away from the mesh center
+};
+
+void MeshOptimizeOverdraw(Mesh& mesh, float threshold) {
+    int numTriangles = (int)mesh.indices.size() / 3;
+    if (numTriangles == 0) return;
+    float acmr = MeshAcmr(mesh);
+
+    // New clusters start where the FIFO cache has none of a triangle's vertices,
+    // so changing the order there costs (almost) no extra transforms
+    std::vector<Cluster> clusters;
+    std::vector<int> fifo(mesh.vertices.size(), -1);
+    int timestamp = 0;
+    for (int t = 0; t < numTriangles; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned v = mesh.indices[t * 3 + k];
+            if (fifo[v] < 0 || timestamp - fifo[v] >= MESH_CACHE_SIZE) {
+                fifo[v] = timestamp++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            Cluster c = { t, 0, 0 };
+            clusters.push_back(c);
+        }
+        clusters.back().count++;
+    }
+
+    Vec3 meshCenter = MakeVec3(0, 0, 0);
+    for (size_t i = 0; i < mesh.vertices.size(); i++) meshCenter = meshCenter + position(mesh.vertices[i]);
+    meshCenter = meshCenter * (1.0f / mesh.vertices.size());
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        Vec3 center = MakeVec3(0, 0, 0), normal = MakeVec3(0, 0, 0);
+        float area = 0;
+        for (int t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++) {
+            Vec3 a = position(mesh.vertices[mesh.indices[t * 3]]);
+            Vec3 b = position(mesh.vertices[mesh.indices[t * 3 + 1]]);
+            Vec3 d = position(mesh.vertices[mesh.indices[t * 3 + 2]]);
+            Vec3 n = Cross(b - a, d - a); // Area-weighted
+            float triangleArea = Length(n);
+            center = center + (a + b + d) * (triangleArea / 3);
+            normal = normal + n;
+            area += triangleArea;
+        }
+        if (area > 0) center = center * (1 / area);
+        clusters[c].sortKey = Dot(center - meshCenter, normal);
+    }
+
+    // Outward-facing clusters first: they are the likeliest to hide the rest
+    std::vector<int> clusterOrder(clusters.size());
+    for (size_t i = 0; i < clusters.size(); i++) clusterOrder[i] = (int)i;
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+        [&](int a, int b) { return clusters[a].sortKey > clusters[b].sortKey; });
+
+    std::vector<unsigned> indices;
+    indices.reserve(mesh.indices.size());
+    for (size_t i = 0; i < clusterOrder.size(); i++) {
+        const Cluster& c = clusters[clusterOrder[i]];
+        indices.insert(indices.end(), mesh.indices.begin() + c.first * 3, mesh.indices.begin() + (c.first + c.count) * 3);
+    }
+
+    indices.swap(mesh.indices);
+    if (MeshAcmr(mesh) > acmr * threshold) mesh.indices.swap(indices); // Too many extra transforms
+}
+
+// --- Vertex fetch ---
+void MeshOptimizeVertexFetch(Mesh& mesh) {
+    std::vector<int> newIndex(mesh.vertices.size(), -1);
+    int count = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        if (newIndex[mesh.indices[i]] < 0) newIndex[mesh.indices[i]] = count++;
+    }
+    remapVertices(mesh, newIndex, count);
+}
+
+// --- Statistics ---
+float MeshAcmr(const Mesh& mesh, int cacheSize) {
+    int numTriangles = (int)mesh.indices.size() / 3;
+    if (numTriangles == 0) return 0;
+
+    std::vector<int> fifo(mesh.vertices.size(), -1); // Timestamp a vertex entered the cache
+    int timestamp = 0, misses = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        unsigned v = mesh.indices[i];
+        if (fifo[v] < 0 || timestamp - fifo[v] >= cacheSize) {
+            fifo[v] = timestamp++;
+            misses++;
+        }
+    }
+    return (float)misses / numTriangles;
+}
+
+MeshStats MeshGetStats(const Mesh& mesh) {
+    MeshStats stats = { (int)mesh.indices.size() / 3, (int)mesh.vertices.size(), MeshAcmr(mesh) };
+    return stats;
+}
+
+void MeshOptimize(Mesh& mesh, const Matrix4& world, bool positionsOnly, MeshStats* before, MeshStats* after) {
+    if (before) *before = MeshGetStats(mesh);
+    MeshWeld(mesh, positionsOnly);
+    MeshRemoveDegenerate(mesh, world);
+    MeshOptimizeVertexCache(mesh);
+    MeshOptimizeOverdraw(mesh);
+    MeshOptimizeVertexFetch(mesh);
+    if (after) *after = MeshGetStats(mesh);
+}
+
+// --- Drawing ---
+void MeshDraw(const Mesh& mesh) {
+    if (mesh.indices.empty()) return;
+    glInterleavedArrays(GL_T2F_V3F, sizeof(PrimitiveVertex), mesh.vertices.data());
+    glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, mesh.indices.data());
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
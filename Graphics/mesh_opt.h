@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include "primitives.h"
+#include "vecmath.h"
+
+// --- Mesh optimization ---
+// Generated primitives come out as quad soups: every side repeats the seam
+// vertices of its neighbours and pole rings collapse to a point. The passes
+// below turn them into indexed triangle lists that are cheap to draw:
+//   weld        merge vertices that are equal (within float noise)
+//   degenerate  drop triangles with zero area, optionally after a transform
+//               that flattens the mesh (the owl's legs have a zero scale)
+//   vertex cache  Forsyth's greedy ordering for the post-transform cache
+//   overdraw    split that order into clusters and draw outward-facing ones
+//               first, keeping the cache order inside each cluster
+//   vertex fetch  renumber vertices in first-use order
+// ACMR (average cache miss ratio) is transformed vertices per triangle with
+// a FIFO cache: 3 for an unindexed soup, 0.5 at best for a regular grid.
+
+const int MESH_CACHE_SIZE = 16;          // FIFO cache ACMR is measured with
+const float MESH_OVERDRAW_THRESHOLD = 1.05f; // ACMR the overdraw pass may give up, relative
+
+// Indexed triangles
+struct Mesh {
+    std::vector<PrimitiveVertex> vertices;
+    std::vector<unsigned> indices;
+};
+
+struct MeshStats {
+    int triangles, vertices;
+    float acmr;
+};
+
+void MeshFromQuads(Mesh& mesh, const PrimitiveVertex* quads, int vertexCount); // Two triangles per quad
+void MeshWeld(Mesh& mesh, bool positionsOnly); // positionsOnly: texture coordinates are not used
+int MeshRemoveDegenerate(Mesh& mesh, const Matrix4& world); // Returns how many triangles went
+void MeshOptimizeVertexCache(Mesh& mesh);
+void MeshOptimizeOverdraw(Mesh& mesh, float threshold = MESH_OVERDRAW_THRESHOLD);
+void MeshOptimizeVertexFetch(Mesh& mesh);
+
+float MeshAcmr(const Mesh& mesh, int cacheSize = MESH_CACHE_SIZE);
+MeshStats MeshGetStats(const Mesh& mesh);
+
+// Every pass in order; stats of the incoming and the optimized mesh
+void MeshOptimize(Mesh& mesh, const Matrix4& world, bool positionsOnly, MeshStats* before, MeshStats* after);
+
+void MeshDraw(const Mesh& mesh); // Client arrays, one glDrawElements
@@ -0,0 +1,233 @@
+#include "occlusion.h"
+
+static const float NEAR_W = 1e-3f; // Clip-space w below which a point counts as behind the eye
+
+void OcclusionInit(OcclusionBuffer& buffer, int width, int height) {
+    buffer.width = (width + 3) & ~3;
+    buffer.height = height;
+
+    int w = buffer.width, h = buffer.height, level = 0;
+    for (;;) {
+        buffer.levelWidth[level] = w;
+        buffer.levelHeight[level] = h;
+        buffer.levels[level].assign(w * h, 1.0f);
+        level++;
+        if ((w == 1 && h == 1) || level == OCCLUSION_MAX_LEVELS) break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+    buffer.numLevels = level;
+    buffer.viewProjection = MatIdentity();
+}
+
+void OcclusionBegin(OcclusionBuffer& buffer, const Matrix4& viewProjection) {
+    std::vector<float>& depth = buffer.levels[0];
+    for (size_t i = 0; i < depth.size(); i++) depth[i] = 1.0f;
+    buffer.viewProjection = viewProjection;
+}
+
+// --- Rasterization ---
+struct ScreenVertex {
+    float x, y, z;
+};
+
+// Window coordinates of a clip-space point, false when it is behind the eye
+static bool toScreen(const OcclusionBuffer& buffer, const Vec4& clip, ScreenVertex* out) {
+    if (clip.w < NEAR_W) return false;
+    float invW = 1.0f / clip.w;
+    out->x = (clip.x * invW * 0.5f + 0.5f) * buffer.width;
+    out->y = (clip.y * invW * 0.5f + 0.5f) * buffer.height;
+    out->z = clip.z * invW * 0.5f + 0.5f;
+    return true;
+}
+
+static void rasterizeTriangle(OcclusionBuffer& buffer, ScreenVertex a, ScreenVertex b, ScreenVertex c) {
+    float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+    if (area == 0) return;
+    if (area < 0) { ScreenVertex t = b; b = c; c = t; } // Counter-clockwise from here on
+
+    // Flat depth of the farthest vertex keeps the occluder conservative
+    float z = a.z > b.z ? a.z : b.z;
+    if (c.z > z) z = c.z;
+    if (z > 1) return; // Reaches past the far plane
+    if (z < 0) z = 0;
+
+    float fMinX = a.x < b.x ? a.x : b.x, fMaxX = a.x > b.x ? a.x : b.x;
+    float fMinY = a.y < b.y ? a.y : b.y, fMaxY = a.y > b.y ? a.y : b.y;
+    if (c.x < fMinX) fMinX = c.x;
+    if (c.x > fMaxX) fMaxX = c.x;
+    if (c.y < fMinY) fMinY = c.y;
+    if (c.y > fMaxY) fMaxY = c.y;
+
+    int minX = fMinX < 0 ? 0 : (int)fMinX & ~3; // Rows are processed in aligned groups of four
+    int minY = fMinY < 0 ? 0 : (int)fMinY;
+    int maxX = fMaxX >= buffer.width ? buffer.width - 1 : (int)fMaxX;
+    int maxY = fMaxY >= buffer.height ? buffer.height - 1 : (int)fMaxY;
+    if (minX > maxX || minY > maxY) return;
+
+    // Edge functions e = A * x + B * y + C, positive inside
+    const ScreenVertex* v[3] = { &a, &b, &c };
+    float edgeA[3], edgeB[3], edgeC[3];
+    for (int i = 0; i < 3; i++) {
+        const ScreenVertex& p = *v[i];
+        const ScreenVertex& q = *v[(i + 1) % 3];
+        edgeA[i] = p.y - q.y;
+        edgeB[i] = q.x - p.x;
+        edgeC[i] = (q.y - p.y) * p.x - (q.x - p.x) * p.y;
+    }
+
+    float* depth = &buffer.levels[0][0];
+#ifdef VECMATH_SSE
+    __m128 triZ = _mm_set1_ps(z), zero = _mm_setzero_ps();
+    __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 stepX[3], rowStart[3];
+    for (int i = 0; i < 3; i++) {
+        stepX[i] = _mm_set1_ps(edgeA[i] * 4);
+        rowStart[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[i]), _mm_add_ps(_mm_set1_ps((float)minX), offsets)),
+                                 _mm_set1_ps(edgeC[i]));
+    }
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        __m128 e0 = _mm_add_ps(rowStart[0], _mm_set1_ps(edgeB[0] * py));
+        __m128 e1 = _mm_add_ps(rowStart[1], _mm_set1_ps(edgeB[1] * py));
+        __m128 e2 = _mm_add_ps(rowStart[2], _mm_set1_ps(edgeB[2] * py));
+        float* row = depth + y * buffer.width;
+
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside)) {
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(old, triZ);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+            e0 = _mm_add_ps(e0, stepX[0]);
+            e1 = _mm_add_ps(e1, stepX[1]);
+            e2 = _mm_add_ps(e2, stepX[2]);
+        }
+    }
+#else
+    for (int y = minY; y <= maxY; y++) {
+        float* row = depth + y * buffer.width;
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f, py = y + 0.5f;
+            bool inside = true;
+            for (int i = 0; i < 3; i++)
+                if (edgeA[i] * px + edgeB[i] * py + edgeC[i] < 0) inside = false;
+            if (inside && z < row[x]) row[x] = z;
+        }
+    }
+#endif
+}
+
+// Position(i) returns vertex i in the space mvp transforms from
+template <typename Index, typename Position>
+static void rasterizeIndexed(OcclusionBuffer& buffer, const Matrix4& mvp, const Index* indices, int numIndices,
+    Position position) {
+    for (int i = 0; i + 2 < numIndices; i += 3) {
+        ScreenVertex s[3];
+        bool inFront = true;
+        for (int k = 0; k < 3 && inFront; k++) {
+            Vec3 p = position(indices[i + k]);
+            inFront = toScreen(buffer, MatTransform(mvp, MakeVec4(p.x, p.y, p.z, 1)), &s[k]);
+        }
+        if (inFront) rasterizeTriangle(buffer, s[0], s[1], s[2]); // Triangles crossing the eye plane are dropped
+    }
+}
+
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const Vec3* vertices,
+    const int* indices, int numIndices) {
+    Matrix4 mvp = MatMultiply(buffer.viewProjection, world);
+    rasterizeIndexed(buffer, mvp, indices, numIndices, [vertices](int i) { return vertices[i]; });
+}
+
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const DoubleVertex* vertices,
+    const unsigned short* indices, int numIndices) {
+    Matrix4 mvp = MatMultiply(buffer.viewProjection, world);
+    rasterizeIndexed(buffer, mvp, indices, numIndices, [vertices](unsigned short i) {
+        const double* p = vertices[i].position;
+        return MakeVec3((float)p[0], (float)p[1], (float)p[2]);
+    });
+}
+
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const FloatVertex* vertices,
+    const unsigned short* indices, int numIndices) {
+    Matrix4 mvp = MatMultiply(buffer.viewProjection, world);
+    rasterizeIndexed(buffer, mvp, indices, numIndices, [vertices](unsigned short i) {
+        const float* p = vertices[i].position;
+        return MakeVec3(p[0], p[1], p[2]);
+    });
+}
+
+// Dequantization is folded into the matrix, as PackedMeshDraw does
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const PackedMesh& mesh) {
+    Matrix4 mvp = MatMultiply(buffer.viewProjection, MatMultiply(world, QuantizationMatrix(mesh.quantization)));
+    const PackedVertex* vertices = mesh.vertexData;
+    rasterizeIndexed(buffer, mvp, mesh.indexData, mesh.indexCount, [vertices](unsigned short i) {
+        const short* p = vertices[i].position;
+        return MakeVec3(p[0], p[1], p[2]);
+    });
+}
+
+// Each texel keeps the farthest depth of the four below it
+void OcclusionBuildPyramid(OcclusionBuffer& buffer) {
+    for (int level = 1; level < buffer.numLevels; level++) {
+        const float* src = &buffer.levels[level - 1][0];
+        float* dst = &buffer.levels[level][0];
+        int srcW = buffer.levelWidth[level - 1], srcH = buffer.levelHeight[level - 1];
+        int w = buffer.levelWidth[level], h = buffer.levelHeight[level];
+
+        for (int y = 0; y < h; y++) {
+            int y0 = y * 2, y1 = y * 2 + 1 < srcH ? y * 2 + 1 : y * 2;
+            for (int x = 0; x < w; x++) {
+                int x0 = x * 2, x1 = x * 2 + 1 < srcW ? x * 2 + 1 : x * 2;
+                float d = src[y0 * srcW + x0];
+                if (src[y0 * srcW + x1] > d) d = src[y0 * srcW + x1];
+                if (src[y1 * srcW + x0] > d) d = src[y1 * srcW + x0];
+                if (src[y1 * srcW + x1] > d) d = src[y1 * srcW + x1];
+                dst[y * w + x] = d;
+            }
+        }
+    }
+}
+
+// --- Queries ---
+bool OcclusionTestAabb(const OcclusionBuffer& buffer, const Aabb& box) {
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1;
+
+    for (int i = 0; i < 8; i++) {
+        Vec3 corner = MakeVec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+        ScreenVertex s;
+        if (!toScreen(buffer, MatTransform(buffer.viewProjection, MakeVec4(corner.x, corner.y, corner.z, 1)), &s))
+            return true; // Reaches behind the eye
+        if (s.x < minX) minX = s.x;
+        if (s.x > maxX) maxX = s.x;
+        if (s.y < minY) minY = s.y;
+        if (s.y > maxY) maxY = s.y;
+        if (s.z < minZ) minZ = s.z;
+    }
+    if (minZ <= 0) return true;
+
+    int x0 = minX < 0 ? 0 : (int)minX, y0 = minY < 0 ? 0 : (int)minY;
+    int x1 = maxX >= buffer.width ? buffer.width - 1 : (int)maxX;
+    int y1 = maxY >= buffer.height ? buffer.height - 1 : (int)maxY;
+    if (x0 > x1 || y0 > y1) return true; // Off screen, left to the frustum test
+
+    // Coarsest level at which the rectangle still spans at most 4x4 texels
+    int level = 0;
+    while (level + 1 < buffer.numLevels && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+        level++;
+
+    const float* depth = &buffer.levels[level][0];
+    int w = buffer.levelWidth[level];
+    for (int y = y0 >> level; y <= y1 >> level; y++)
+        for (int x = x0 >> level; x <= x1 >> level; x++)
+            if (depth[y * w + x] >= minZ) return true; // Something behind the occluders shows through
+    return false;
+}
+
+bool OcclusionTestSphere(const OcclusionBuffer& buffer, const Vec3& center, float radius) {
+    Vec3 extent = MakeVec3(radius, radius, radius);
+    Aabb box = { center - extent, center + extent };
+    return OcclusionTestAabb(buffer, box);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "culling.h"
+#include "vecmath.h"
+#include "vertex_format.h"
+
+// --- Software occlusion culling ---
+// A few large occluders are rasterized on the CPU into a small depth buffer
+// (window depth, 0 = near, 1 = far), four pixels at a time. Each triangle
+// writes its farthest vertex depth, so the buffer never claims more
+// occlusion than the real geometry gives. A max-depth pyramid is then built
+// from it, and an object's screen rectangle is tested against the one level
+// where it covers only a handful of texels.
+
+const int OCCLUSION_MAX_LEVELS = 8;
+
+struct OcclusionBuffer {
+    int width, height;    // Level 0, both multiples of 4
+    int numLevels;
+    int levelWidth[OCCLUSION_MAX_LEVELS], levelHeight[OCCLUSION_MAX_LEVELS];
+    std::vector<float> levels[OCCLUSION_MAX_LEVELS]; // levels[0] is the rasterized depth
+    Matrix4 viewProjection;                          // Of the frame being tested
+};
+
+void OcclusionInit(OcclusionBuffer& buffer, int width, int height);
+void OcclusionBegin(OcclusionBuffer& buffer, const Matrix4& viewProjection); // Clears to far
+// Triangles given as index triples into vertices (local space, placed by world)
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const Vec3* vertices,
+    const int* indices, int numIndices);
+// The same from each stored vertex format, for --bench-vertex
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const DoubleVertex* vertices,
+    const unsigned short* indices, int numIndices);
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const FloatVertex* vertices,
+    const unsigned short* indices, int numIndices);
+void OcclusionRasterize(OcclusionBuffer& buffer, const Matrix4& world, const PackedMesh& mesh);
+void OcclusionBuildPyramid(OcclusionBuffer& buffer); // Call after the last occluder
+
+// False only when the box is certainly hidden behind the occluders
+bool OcclusionTestAabb(const OcclusionBuffer& buffer, const Aabb& box);
+bool OcclusionTestSphere(const OcclusionBuffer& buffer, const Vec3& center, float radius);
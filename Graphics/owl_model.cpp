@@ -0,0 +1,182 @@
+#include <math.h>
+#include "mesh_opt.h"
+#include "owl_model.h"
+
+static int addPart(OwlModel& owl, int parent, const Matrix4& local, OwlShape shape, int sides, double r, double g,
+    double b);
+
+// --- Model ---
+// Group nodes mirror the matrix stack nesting the owl was first drawn with
+void OwlModelBuild(OwlModel& owl) {
+    owl.numParts = 0;
+    Matrix4 m;
+    int root = SceneAddNode(owl.graph, -1, MatIdentity());
+    int group;
+
+    //owl bar
+    m = MatIdentity();
+    MatTranslate(m, 0, 0, -10);
+    MatRotate(m, 90, 0, 0, 1);
+    MatScale(m, 1, 70, 1);
+    addPart(owl, root, m, OWL_BAR, 30, 0.2, 0.2, 0);
+
+    //main body
+    m = MatIdentity();
+    MatTranslate(m, -35, 14, -5);
+    MatScale(m, 13, 15, 20);
+    addPart(owl, root, m, OWL_SPHERE, 20, 0.4, 0.29, 0);
+
+    //side body
+    m = MatIdentity();
+    MatTranslate(m, -35, 14, 0);
+    MatRotate(m, 90, 0, 0, 1);
+    MatScale(m, 11, 20, 10);
+    addPart(owl, root, m, OWL_SPHERE, 20, 0.69, 0.49, 0);
+
+    //nose
+    m = MatIdentity();
+    MatTranslate(m, -35, 17, 10);
+    MatScale(m, 2, 4, 10);
+    addPart(owl, root, m, OWL_SPHERE, 20, 0.69, 0.49, 0);
+
+    //left legs, then the right legs as a copy moved 10 to the right
+    for (int side = 0; side < 2; side++) {
+        m = MatIdentity();
+        MatTranslate(m, 10 * side, 0, 0);
+        group = SceneAddNode(owl.graph, root, m);
+
+        for (int leg = 0; leg < 3; leg++) {
+            m = MatIdentity();
+            MatTranslate(m, -42 + 2 * leg, 0, -5);
+            MatScale(m, 0.8, 4, 0);
+            addPart(owl, group, m, OWL_SPHERE, 20, 0.69, 0.49, 0);
+        }
+    }
+
+    //head
+    m = MatIdentity();
+    MatTranslate(m, -35, 13.2, 6.9);
+    MatScale(m, 1.1, 10, 1);
+    MatRotate(m, 45, 0, 1, 0);
+    addPart(owl, root, m, OWL_HEAD, 4, 0.4, 0.29, 0);
+
+    //left eye
+    m = MatIdentity();
+    MatTranslate(m, -39, 20, 11.5);
+    MatScale(m, 4, 4, 3);
+    addPart(owl, root, m, OWL_SPHERE, 17, 1, 1, 1);
+
+    //right eye
+    m = MatIdentity();
+    MatTranslate(m, 8, 0, 0);
+    group = SceneAddNode(owl.graph, root, m);
+    m = MatIdentity();
+    MatTranslate(m, -39, 20, 11.5);
+    MatScale(m, 4, 4, 3);
+    addPart(owl, group, m, OWL_SPHERE, 15, 1, 1, 1);
+
+    //pupils, moved together by the slider
+    owl.pupilsNode = SceneAddNode(owl.graph, root, MatIdentity());
+    OwlModelSetPupils(owl, 0);
+
+    //left pupil
+    m = MatIdentity();
+    MatTranslate(m, -39.3, 19, 15);
+    MatScale(m, 0.7, 0.7, 0.7);
+    addPart(owl, owl.pupilsNode, m, OWL_SPHERE, 20, 0, 0, 0);
+
+    //right pupil
+    m = MatIdentity();
+    MatTranslate(m, 8.5, 0, 0);
+    group = SceneAddNode(owl.graph, owl.pupilsNode, m);
+    m = MatIdentity();
+    MatTranslate(m, -39.3, 19, 15);
+    MatScale(m, 0.7, 0.7, 0.7);
+    addPart(owl, group, m, OWL_SPHERE, 20, 0, 0, 0);
+
+    SceneUpdate(owl.graph);
+}
+
+static int addPart(OwlModel& owl, int parent, const Matrix4& local, OwlShape shape, int sides, double r, double g,
+    double b) {
+    OwlPart& part = owl.parts[owl.numParts++];
+    part.node = SceneAddNode(owl.graph, parent, local);
+    part.shape = shape;
+    part.sides = sides;
+    part.slices = sides;
+    part.color[0] = r;
+    part.color[1] = g;
+    part.color[2] = b;
+
+    // Unit sphere, or a cylinder standing on y = 0 with its height of 1
+    float radius = shape == OWL_HEAD ? 13.0f : 1.0f;
+    part.boundCenter = shape == OWL_SPHERE ? MakeVec3(0, 0, 0) : MakeVec3(0, 0.5f, 0);
+    part.boundRadius = shape == OWL_SPHERE ? 1.0f : sqrtf(radius * radius + 0.25f);
+    return part.node;
+}
+
+// Pupils circle with the eye slider; only the pupils group and its children move
+void OwlModelSetPupils(OwlModel& owl, double eyeOffset) {
+    double pupilRadius = 1.5; // Adjust as needed
+    double angle = eyeOffset * 0.01; // Adjust scaling factor as needed for a smooth circular movement
+    double pupilX = pupilRadius * cos(angle);
+    double pupilY = pupilRadius * sin(angle);
+
+    Matrix4 m = MatIdentity();
+    MatTranslate(m, pupilX, pupilY, 0);
+    SceneSetLocal(owl.graph, owl.pupilsNode, m);
+}
+
+// --- Meshes ---
+// Quad soup of a part's shape from the compile-time circle tables
+static int buildPartQuads(const OwlPart& part, PrimitiveVertex* out) {
+    switch (part.shape) {
+    case OWL_SPHERE: return PrimitiveSphereVertices(part.sides, part.slices, out); // Unit sphere
+    case OWL_HEAD: return PrimitivePrismVertices(4, 13, 0, 1, out);
+    case OWL_BAR: return PrimitivePrismVertices(30, 1, 1, 2, out);
+    }
+    return 0;
+}
+
+// 16 bytes per vertex instead of the 20 of the optimized mesh, 64 of immediate mode
+static void packMesh(const Mesh& mesh, PackedMesh& packed) {
+    int count = (int)mesh.vertices.size();
+    std::vector<Vec3> positions(count), normals(count);
+    std::vector<float> uvs(count * 2);
+    for (int i = 0; i < count; i++) {
+        const PrimitiveVertex& v = mesh.vertices[i];
+        positions[i] = MakeVec3(v.x, v.y, v.z);
+        uvs[i * 2] = v.u;
+        uvs[i * 2 + 1] = v.v;
+    }
+    ComputeNormals(positions.data(), count, mesh.indices.data(), (int)mesh.indices.size(), normals.data());
+    PackMesh(packed, positions.data(), normals.data(), uvs.data(), count, mesh.indices.data(), (int)mesh.indices.size());
+}
+
+// Welds and reorders every part's mesh once. Degenerate triangles are judged
+// under the part's world matrix, so flattened parts lose their edge-on faces.
+void OwlModelBuildMeshes(OwlModel& owl) {
+    const Matrix4* world = SceneWorldMatrices(owl.graph);
+    std::vector<PrimitiveVertex> quads(MAX_PRIMITIVE_SIDES * MAX_PRIMITIVE_SIDES * 4);
+    float missesBefore = 0, missesAfter = 0;
+    MeshStats zero = { 0, 0, 0 };
+    owl.meshesBefore = owl.meshesAfter = zero;
+
+    for (int i = 0; i < owl.numParts; i++) {
+        Mesh mesh;
+        int count = buildPartQuads(owl.parts[i], quads.data());
+        MeshFromQuads(mesh, quads.data(), count);
+
+        MeshStats before, after;
+        MeshOptimize(mesh, world[owl.parts[i].node], true, &before, &after); // Untextured
+        packMesh(mesh, owl.meshes[i]);
+        owl.meshesBefore.triangles += before.triangles;
+        owl.meshesBefore.vertices += before.vertices;
+        owl.meshesAfter.triangles += after.triangles;
+        owl.meshesAfter.vertices += after.vertices;
+        missesBefore += before.acmr * before.triangles;
+        missesAfter += after.acmr * after.triangles;
+    }
+    owl.meshesBefore.acmr = missesBefore / owl.meshesBefore.triangles;
+    owl.meshesAfter.acmr = missesAfter / owl.meshesAfter.triangles;
+}
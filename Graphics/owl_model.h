@@ -0,0 +1,33 @@
+#pragma once
+#include "mesh_opt.h"
+#include "scene_graph.h"
+#include "vertex_format.h"
+
+// --- Owl model ---
+// Every part of the owl is a node in the owl's scene graph plus what to draw
+// there. The owl scene draws one model; the house scene's city places copies
+// of it, each part at instance world * part world.
+
+enum OwlShape { OWL_SPHERE, OWL_HEAD, OWL_BAR };
+struct OwlPart {
+    int node;           // Scene graph node holding the part's transform
+    OwlShape shape;
+    int sides, slices;  // Sphere tessellation
+    double color[3];
+    Vec3 boundCenter;   // Local bounding sphere of the shape
+    float boundRadius;
+};
+const int MAX_OWL_PARTS = 32;
+
+struct OwlModel {
+    SceneGraph graph;
+    OwlPart parts[MAX_OWL_PARTS];
+    int numParts;
+    int pupilsNode;                    // Group node moved by the eye slider
+    PackedMesh meshes[MAX_OWL_PARTS];  // Optimized and packed geometry, one per part
+    MeshStats meshesBefore, meshesAfter; // Totals over all parts, ACMR per triangle
+};
+
+void OwlModelBuild(OwlModel& owl); // Scene graph with the pupils centered, world matrices up to date
+void OwlModelSetPupils(OwlModel& owl, double eyeOffset); // SceneUpdate afterwards
+void OwlModelBuildMeshes(OwlModel& owl); // Needs current world matrices
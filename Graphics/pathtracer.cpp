@@ -0,0 +1,532 @@
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <emmintrin.h>
+#include "jobs.h"
+#include "pathtracer.h"
+
+// --- Colors ---
+static float toLinear(double display) {
+    return (float)pow(display > 0 ? display : 0, 2.2);
+}
+
+// Texels are sRGB bytes
+struct LinearTable {
+    float value[256];
+    LinearTable() {
+        for (int i = 0; i < 256; i++) value[i] = toLinear(i / 255.0);
+    }
+};
+
+static const LinearTable& linearTable() {
+    static const LinearTable table;
+    return table;
+}
+
+static unsigned char toDisplay(float linear) {
+    if (linear <= 0) return 0;
+    if (linear >= 1) return 255;
+    return (unsigned char)(powf(linear, 1 / 2.2f) * 255 + 0.5f);
+}
+
+static Vec3 modulate(const Vec3& a, const Vec3& b) {
+    return MakeVec3(a.x * b.x, a.y * b.y, a.z * b.z);
+}
+
+// --- Scene ---
+void PtSceneBegin(PtScene& scene, const float sky[3], const Vec3& sunDirection, const float sun[3]) {
+    scene.triangles.clear();
+    scene.shading.clear();
+    scene.materials.clear();
+    scene.textures.clear();
+    scene.nodes.clear();
+    for (int i = 0; i < 3; i++) {
+        scene.sky[i] = toLinear(sky[i]);
+        scene.sun[i] = toLinear(sun[i]);
+    }
+    scene.sunDirection = Normalize(sunDirection);
+}
+
+int PtSceneAddTexture(PtScene& scene, const unsigned char* rgb, int width, int height) {
+    PtTexture texture = { rgb, width, height };
+    scene.textures.push_back(texture);
+    return (int)scene.textures.size() - 1;
+}
+
+int PtSceneAddMaterial(PtScene& scene, double r, double g, double b, int texture) {
+    PtMaterial material = { { toLinear(r), toLinear(g), toLinear(b) }, texture };
+    scene.materials.push_back(material);
+    return (int)scene.materials.size() - 1;
+}
+
+// Zero-area triangles, such as the sides of flattened parts, are left out
+static void addTriangle(PtScene& scene, const Vec3 corner[3], const Vec3 normal[3], const float uv[3][2], int material) {
+    PtTriangle triangle = { corner[0], corner[1] - corner[0], corner[2] - corner[0] };
+    if (Dot(Cross(triangle.edge1, triangle.edge2), Cross(triangle.edge1, triangle.edge2)) < 1e-12f) return;
+
+    PtShading shading;
+    for (int k = 0; k < 3; k++) {
+        shading.normal[k] = normal[k];
+        shading.uv[k][0] = uv[k][0];
+        shading.uv[k][1] = uv[k][1];
+    }
+    shading.material = material;
+    scene.triangles.push_back(triangle);
+    scene.shading.push_back(shading);
+}
+
+void PtSceneAddQuads(PtScene& scene, const Matrix4& world, const PrimitiveVertex* quads, int count, int material) {
+    static const int TRIANGLES[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+    for (int i = 0; i + 3 < count; i += 4) {
+        for (int half = 0; half < 2; half++) {
+            Vec3 corner[3], normal[3];
+            float uv[3][2];
+            for (int k = 0; k < 3; k++) {
+                const PrimitiveVertex& v = quads[i + TRIANGLES[half][k]];
+                corner[k] = MatTransformPoint(world, MakeVec3(v.x, v.y, v.z));
+                uv[k][0] = v.u;
+                uv[k][1] = v.v;
+            }
+            normal[0] = normal[1] = normal[2] = Normalize(Cross(corner[1] - corner[0], corner[2] - corner[0]));
+            addTriangle(scene, corner, normal, uv, material);
+        }
+    }
+}
+
+void PtSceneAddMesh(PtScene& scene, const Matrix4& world, const PackedMesh& mesh, int material, bool smooth) {
+    Matrix4 toWorld = MatMultiply(world, QuantizationMatrix(mesh.quantization));
+    // Normals go through the cofactor matrix: the inverse transpose up to scale,
+    // and still defined for flattened parts
+    Vec3 column[3];
+    for (int c = 0; c < 3; c++) column[c] = MakeVec3(world.m[c * 4], world.m[c * 4 + 1], world.m[c * 4 + 2]);
+    Vec3 cofactor[3] = { Cross(column[1], column[2]), Cross(column[2], column[0]), Cross(column[0], column[1]) };
+
+    for (int i = 0; i + 2 < mesh.indexCount; i += 3) {
+        Vec3 corner[3], normal[3];
+        float uv[3][2];
+        for (int k = 0; k < 3; k++) {
+            const PackedVertex& v = mesh.vertexData[mesh.indexData[i + k]];
+            corner[k] = MatTransformPoint(toWorld, MakeVec3(v.position[0], v.position[1], v.position[2]));
+            Vec3 n = OctDecode(v.normal);
+            normal[k] = Normalize(cofactor[0] * n.x + cofactor[1] * n.y + cofactor[2] * n.z);
+            uv[k][0] = HalfToFloat(v.uv[0]);
+            uv[k][1] = HalfToFloat(v.uv[1]);
+        }
+        if (!smooth) normal[0] = normal[1] = normal[2] = Normalize(Cross(corner[1] - corner[0], corner[2] - corner[0]));
+        addTriangle(scene, corner, normal, uv, material);
+    }
+}
+
+// Triangles are reordered so each leaf's are contiguous, and each inner
+// node's first child is the one lower along its axis
+void PtSceneBuild(PtScene& scene) {
+    int count = (int)scene.triangles.size();
+    std::vector<Aabb> bounds(count);
+    for (int i = 0; i < count; i++) {
+        const PtTriangle& t = scene.triangles[i];
+        Vec3 b = t.corner + t.edge1, c = t.corner + t.edge2;
+        bounds[i].min = Min(Min(t.corner, b), c);
+        bounds[i].max = Max(Max(t.corner, b), c);
+    }
+    Bvh bvh;
+    BvhBuild(bvh, bounds.data(), count);
+
+    std::vector<PtTriangle> triangles(count);
+    std::vector<PtShading> shading(count);
+    for (int i = 0; i < count; i++) {
+        triangles[i] = scene.triangles[bvh.items[i]];
+        shading[i] = scene.shading[bvh.items[i]];
+    }
+    scene.triangles.swap(triangles);
+    scene.shading.swap(shading);
+
+    scene.nodes.resize(bvh.nodes.size());
+    for (size_t i = 0; i < bvh.nodes.size(); i++) {
+        const BvhNode& from = bvh.nodes[i];
+        PtNode& node = scene.nodes[i];
+        node.box = from.box;
+        node.left = from.left;
+        node.first = from.first;
+        node.count = from.count;
+        node.axis = 0;
+    }
+    for (size_t i = 0; i < scene.nodes.size(); i++) {
+        PtNode& node = scene.nodes[i];
+        if (node.left < 0) continue;
+        const Aabb& a = scene.nodes[node.left].box;
+        const Aabb& b = scene.nodes[node.left + 1].box;
+        Vec3 apart = (b.min + b.max) - (a.min + a.max);
+        float along[3] = { apart.x, apart.y, apart.z };
+        for (int k = 1; k < 3; k++)
+            if (fabsf(along[k]) > fabsf(along[node.axis])) node.axis = k;
+        if (along[node.axis] < 0) { // Children keep their own child indices, so they can trade places
+            PtNode first = scene.nodes[node.left];
+            scene.nodes[node.left] = scene.nodes[node.left + 1];
+            scene.nodes[node.left + 1] = first;
+        }
+    }
+}
+
+// --- Ray packets ---
+// Four rays in SoA form, one per SSE lane
+struct Packet {
+    __m128 ox, oy, oz;
+    __m128 dx, dy, dz;
+    __m128 ix, iy, iz;   // 1 / direction
+    __m128 t, u, v;      // Closest hit so far and its barycentrics
+    __m128i triangle;    // -1 for none
+    int sign[3];         // 1 where the first active ray points down the axis
+};
+
+// Rays being set up lane by lane
+struct Rays {
+    alignas(16) float origin[3][4];
+    alignas(16) float direction[3][4];
+};
+
+static void setRay(Rays& rays, int lane, const Vec3& origin, const Vec3& direction) {
+    rays.origin[0][lane] = origin.x;
+    rays.origin[1][lane] = origin.y;
+    rays.origin[2][lane] = origin.z;
+    rays.direction[0][lane] = direction.x;
+    rays.direction[1][lane] = direction.y;
+    rays.direction[2][lane] = direction.z;
+}
+
+static __m128 laneMask(int lanes) {
+    return _mm_castsi128_ps(_mm_set_epi32(lanes & 8 ? -1 : 0, lanes & 4 ? -1 : 0, lanes & 2 ? -1 : 0, lanes & 1 ? -1 : 0));
+}
+
+static int laneCount(int lanes) {
+    return (lanes & 1) + (lanes >> 1 & 1) + (lanes >> 2 & 1) + (lanes >> 3 & 1);
+}
+
+static void loadPacket(Packet& packet, const Rays& rays, int active) {
+    alignas(16) float inverse[3][4];
+    for (int a = 0; a < 3; a++) {
+        for (int k = 0; k < 4; k++) { // Axis-parallel rays get a huge finite inverse instead of infinity
+            float d = rays.direction[a][k];
+            inverse[a][k] = 1 / (fabsf(d) > 1e-20f ? d : (d < 0 ? -1e-20f : 1e-20f));
+        }
+    }
+    packet.ox = _mm_load_ps(rays.origin[0]);
+    packet.oy = _mm_load_ps(rays.origin[1]);
+    packet.oz = _mm_load_ps(rays.origin[2]);
+    packet.dx = _mm_load_ps(rays.direction[0]);
+    packet.dy = _mm_load_ps(rays.direction[1]);
+    packet.dz = _mm_load_ps(rays.direction[2]);
+    packet.ix = _mm_load_ps(inverse[0]);
+    packet.iy = _mm_load_ps(inverse[1]);
+    packet.iz = _mm_load_ps(inverse[2]);
+    packet.t = _mm_set1_ps(FLT_MAX);
+    packet.u = packet.v = _mm_setzero_ps();
+    packet.triangle = _mm_set1_epi32(-1);
+
+    int lane = 0;
+    while (lane < 3 && !(active >> lane & 1)) lane++;
+    for (int a = 0; a < 3; a++) packet.sign[a] = rays.direction[a][lane] < 0;
+}
+
+static __m128 dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+static __m128 blend(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Lanes whose ray enters the box before its closest hit
+static int boxHit(const Packet& p, const Aabb& box, __m128 lanes) {
+    __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.x), p.ox), p.ix);
+    __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.x), p.ox), p.ix);
+    __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.y), p.oy), p.iy);
+    __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.y), p.oy), p.iy);
+    __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min.z), p.oz), p.iz);
+    __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max.z), p.oz), p.iz);
+    __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+        _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+    __m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), p.t));
+    return _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(enter, leave), lanes));
+}
+
+// Moller-Trumbore on four rays at once
+static void intersect(Packet& p, const PtTriangle& triangle, int index, __m128 lanes) {
+    __m128 e1x = _mm_set1_ps(triangle.edge1.x), e1y = _mm_set1_ps(triangle.edge1.y), e1z = _mm_set1_ps(triangle.edge1.z);
+    __m128 e2x = _mm_set1_ps(triangle.edge2.x), e2y = _mm_set1_ps(triangle.edge2.y), e2z = _mm_set1_ps(triangle.edge2.z);
+
+    __m128 px = _mm_sub_ps(_mm_mul_ps(p.dy, e2z), _mm_mul_ps(p.dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(p.dz, e2x), _mm_mul_ps(p.dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(p.dx, e2y), _mm_mul_ps(p.dy, e2x));
+    __m128 determinant = dot(e1x, e1y, e1z, px, py, pz);
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1), determinant);
+
+    __m128 sx = _mm_sub_ps(p.ox, _mm_set1_ps(triangle.corner.x));
+    __m128 sy = _mm_sub_ps(p.oy, _mm_set1_ps(triangle.corner.y));
+    __m128 sz = _mm_sub_ps(p.oz, _mm_set1_ps(triangle.corner.z));
+    __m128 u = _mm_mul_ps(dot(sx, sy, sz, px, py, pz), inverse);
+
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(dot(p.dx, p.dy, p.dz, qx, qy, qz), inverse);
+    __m128 t = _mm_mul_ps(dot(e2x, e2y, e2z, qx, qy, qz), inverse);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 absolute = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+    __m128 hit = _mm_and_ps(lanes, _mm_cmpgt_ps(absolute, _mm_set1_ps(1e-12f)));
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1)));
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, p.t)));
+    if (!_mm_movemask_ps(hit)) return;
+
+    p.t = blend(hit, t, p.t);
+    p.u = blend(hit, u, p.u);
+    p.v = blend(hit, v, p.v);
+    p.triangle = _mm_castps_si128(blend(hit, _mm_castsi128_ps(_mm_set1_epi32(index)), _mm_castsi128_ps(p.triangle)));
+}
+
+static int hitLanes(const Packet& p, int active) {
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(p.triangle, _mm_set1_epi32(-1)))) & active;
+}
+
+// Closest hits of the active lanes, or with anyHit just whether something
+// is in the way; returns the lanes that hit
+static int trace(const PtScene& scene, Packet& p, int active, bool anyHit) {
+    if (scene.nodes.empty() || !active) return 0;
+    __m128 lanes = laneMask(active);
+    int stack[64]; // Deeper than BvhBuild ever goes
+    int size = 0;
+    stack[size++] = 0;
+
+    while (size > 0) {
+        const PtNode& node = scene.nodes[stack[--size]];
+        if (!boxHit(p, node.box, lanes)) continue;
+        if (node.left >= 0) {
+            int nearer = node.left + p.sign[node.axis];
+            stack[size++] = node.left + 1 - p.sign[node.axis];
+            stack[size++] = nearer;
+            continue;
+        }
+
+        for (int i = node.first; i < node.first + node.count; i++) intersect(p, scene.triangles[i], i, lanes);
+        if (anyHit) { // Blocked lanes are done
+            int blocked = hitLanes(p, active);
+            if (blocked == active) return blocked;
+            lanes = _mm_andnot_ps(laneMask(blocked), lanes);
+        }
+    }
+    return hitLanes(p, active);
+}
+
+// --- Sampling ---
+static unsigned hashSeed(unsigned pixel, unsigned sample) {
+    unsigned h = pixel * 0x9E3779B1u ^ (sample + 1) * 0x85EBCA77u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h ? h : 1;
+}
+
+// xorshift32, in [0, 1)
+static float randomFloat(unsigned& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216);
+}
+
+// Cosine-weighted around normal, so a Lambertian bounce weighs by the albedo alone
+static Vec3 cosineSample(const Vec3& normal, unsigned& state) {
+    float sign = normal.z >= 0 ? 1.0f : -1.0f; // Orthonormal basis after Duff et al.
+    float a = -1 / (sign + normal.z), b = normal.x * normal.y * a;
+    Vec3 tangent = MakeVec3(1 + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+    Vec3 bitangent = MakeVec3(b, sign + normal.y * normal.y * a, -normal.y);
+
+    float r1 = randomFloat(state), angle = 2 * VECMATH_PI * randomFloat(state);
+    float radius = sqrtf(r1);
+    return tangent * (radius * cosf(angle)) + bitangent * (radius * sinf(angle)) + normal * sqrtf(1 - r1);
+}
+
+static Vec3 albedo(const PtScene& scene, const PtShading& shading, float u, float v) {
+    const PtMaterial& material = scene.materials[shading.material];
+    Vec3 color = MakeVec3(material.color[0], material.color[1], material.color[2]);
+    if (material.texture < 0) return color;
+
+    const PtTexture& texture = scene.textures[material.texture];
+    float w = 1 - u - v;
+    float s = shading.uv[0][0] * w + shading.uv[1][0] * u + shading.uv[2][0] * v;
+    float t = shading.uv[0][1] * w + shading.uv[1][1] * u + shading.uv[2][1] * v;
+    int x = (int)floorf(s * texture.width) % texture.width, y = (int)floorf(t * texture.height) % texture.height;
+    if (x < 0) x += texture.width; // Repeat, like GL_REPEAT
+    if (y < 0) y += texture.height;
+    const unsigned char* texel = texture.rgb + (y * texture.width + x) * 3;
+    const float* linear = linearTable().value;
+    return modulate(color, MakeVec3(linear[texel[0]], linear[texel[1]], linear[texel[2]]));
+}
+
+// --- Rendering ---
+// One sample for each pixel of a 2x2 block; returns the rays traced
+static int renderBlock(PtRender& render, const PtScene& scene, int x0, int y0) {
+    Rays rays = {};
+    Vec3 throughput[4], radiance[4], sunLight[4];
+    unsigned state[4];
+    int alive = 0;
+    for (int k = 0; k < 4; k++) {
+        int x = x0 + (k & 1), y = y0 + (k >> 1);
+        throughput[k] = MakeVec3(1, 1, 1);
+        radiance[k] = sunLight[k] = MakeVec3(0, 0, 0);
+        state[k] = 1;
+        if (x >= render.width || y >= render.height) continue;
+
+        alive |= 1 << k;
+        state[k] = hashSeed(y * render.width + x, render.samples);
+        Vec3 target = render.corner + render.stepX * (x + randomFloat(state[k])) + render.stepY * (y + randomFloat(state[k]));
+        setRay(rays, k, render.eye, Normalize(target - render.eye));
+    }
+
+    int pixels = alive, rayCount = 0;
+    Vec3 sun = MakeVec3(scene.sun[0], scene.sun[1], scene.sun[2]);
+    for (int bounce = 0; bounce <= PT_MAX_BOUNCES && alive; bounce++) {
+        Packet packet;
+        loadPacket(packet, rays, alive);
+        trace(scene, packet, alive, false);
+        rayCount += laneCount(alive);
+
+        alignas(16) float t[4], u[4], v[4];
+        alignas(16) int hit[4];
+        _mm_store_ps(t, packet.t);
+        _mm_store_ps(u, packet.u);
+        _mm_store_ps(v, packet.v);
+        _mm_store_si128((__m128i*)hit, packet.triangle);
+
+        Rays shadows = {};
+        int lit = 0;
+        for (int k = 0; k < 4; k++) {
+            if (!(alive >> k & 1)) continue;
+            if (hit[k] < 0) { // Out to the sky
+                radiance[k] = radiance[k] + modulate(throughput[k], MakeVec3(scene.sky[0], scene.sky[1], scene.sky[2]));
+                alive &= ~(1 << k);
+                continue;
+            }
+
+            const PtTriangle& triangle = scene.triangles[hit[k]];
+            const PtShading& shading = scene.shading[hit[k]];
+            Vec3 origin = MakeVec3(rays.origin[0][k], rays.origin[1][k], rays.origin[2][k]);
+            Vec3 direction = MakeVec3(rays.direction[0][k], rays.direction[1][k], rays.direction[2][k]);
+            Vec3 geometric = Normalize(Cross(triangle.edge1, triangle.edge2));
+            if (Dot(geometric, direction) > 0) geometric = -geometric; // Both sides are surfaces
+            float w = 1 - u[k] - v[k];
+            Vec3 normal = Normalize(shading.normal[0] * w + shading.normal[1] * u[k] + shading.normal[2] * v[k]);
+            if (Dot(normal, geometric) < 0) normal = -normal;
+            Vec3 start = origin + direction * t[k] + geometric * PT_RAY_OFFSET;
+            Vec3 color = albedo(scene, shading, u[k], v[k]);
+
+            // Sun, through a shadow ray to a point on its disk
+            Vec3 spread = MakeVec3(randomFloat(state[k]) * 2 - 1, randomFloat(state[k]) * 2 - 1, randomFloat(state[k]) * 2 - 1);
+            Vec3 toSun = Normalize(scene.sunDirection + spread * PT_SUN_SPREAD);
+            float cosine = Dot(normal, toSun);
+            if (cosine > 0 && Dot(geometric, toSun) > 0) {
+                sunLight[k] = modulate(modulate(throughput[k], color), sun) * cosine;
+                setRay(shadows, k, start, toSun);
+                lit |= 1 << k;
+            }
+
+            throughput[k] = modulate(throughput[k], color);
+            Vec3 next = cosineSample(normal, state[k]);
+            if (bounce == PT_MAX_BOUNCES || Dot(next, geometric) <= 0) {
+                alive &= ~(1 << k);
+                continue;
+            }
+            setRay(rays, k, start, next);
+        }
+
+        if (!lit) continue;
+        Packet shadow;
+        loadPacket(shadow, shadows, lit);
+        int blocked = trace(scene, shadow, lit, true);
+        rayCount += laneCount(lit);
+        for (int k = 0; k < 4; k++)
+            if ((lit & ~blocked) >> k & 1) radiance[k] = radiance[k] + sunLight[k];
+    }
+
+    for (int k = 0; k < 4; k++) {
+        if (!(pixels >> k & 1)) continue;
+        float* sum = &render.accumulated[((y0 + (k >> 1)) * render.width + x0 + (k & 1)) * 3];
+        sum[0] += radiance[k].x;
+        sum[1] += radiance[k].y;
+        sum[2] += radiance[k].z;
+    }
+    return rayCount;
+}
+
+struct PassContext {
+    PtRender* render;
+    const PtScene* scene;
+    int tilesX;
+};
+
+static void renderTiles(void* data, int begin, int end) {
+    PassContext& context = *(PassContext*)data;
+    PtRender& render = *context.render;
+    float scale = 1.0f / (render.samples + 1); // Average including this pass
+
+    for (int tile = begin; tile < end; tile++) {
+        int x0 = tile % context.tilesX * PT_TILE, y0 = tile / context.tilesX * PT_TILE;
+        int x1 = x0 + PT_TILE < render.width ? x0 + PT_TILE : render.width;
+        int y1 = y0 + PT_TILE < render.height ? y0 + PT_TILE : render.height;
+        int rays = 0;
+        for (int y = y0; y < y1; y += 2)
+            for (int x = x0; x < x1; x += 2) rays += renderBlock(render, *context.scene, x, y);
+        render.tileRays[tile] = rays;
+
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                int i = (y * render.width + x) * 3;
+                for (int c = 0; c < 3; c++) render.pixels[i + c] = toDisplay(render.accumulated[i + c] * scale);
+            }
+        }
+    }
+}
+
+void PtRenderReset(PtRender& render, int width, int height, const Matrix4& viewProjection, const Vec3& eye) {
+    // Far plane points are an affine function of the pixel for a perspective
+    // projection, so three unprojections give every pixel's
+    Matrix4 inverse = MatInverse(viewProjection);
+    Vec4 corners[3] = { MatTransform(inverse, MakeVec4(-1, -1, 1, 1)), MatTransform(inverse, MakeVec4(1, -1, 1, 1)),
+        MatTransform(inverse, MakeVec4(-1, 1, 1, 1)) };
+    Vec3 point[3];
+    for (int i = 0; i < 3; i++) point[i] = XYZ(corners[i]) * (1 / corners[i].w);
+
+    render.width = width;
+    render.height = height;
+    render.eye = eye;
+    render.corner = point[0];
+    render.stepX = (point[1] - point[0]) * (1.0f / width);
+    render.stepY = (point[2] - point[0]) * (1.0f / height);
+    render.accumulated.assign(width * height * 3, 0);
+    render.pixels.assign(width * height * 3, 0);
+    render.tileRays.assign(((width + PT_TILE - 1) / PT_TILE) * ((height + PT_TILE - 1) / PT_TILE), 0);
+    render.samples = 0;
+    render.passMilliseconds = render.samplesPerSecond = render.raysPerSecond = 0;
+}
+
+void PtRenderPass(PtRender& render, const PtScene& scene) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PassContext context;
+    context.render = &render;
+    context.scene = &scene;
+    context.tilesX = (render.width + PT_TILE - 1) / PT_TILE;
+    int tiles = context.tilesX * ((render.height + PT_TILE - 1) / PT_TILE);
+    int grain = tiles / (JobsWorkerCount() * PT_JOBS_PER_WORKER); // Enough ranges to balance, not one per tile
+    JobParallelFor(tiles, grain, renderTiles, &context);
+    render.samples++;
+
+    double rays = 0;
+    for (int i = 0; i < tiles; i++) rays += render.tileRays[i];
+    render.passMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    double seconds = render.passMilliseconds > 0 ? render.passMilliseconds / 1000 : 1e-6;
+    render.samplesPerSecond = (double)render.width * render.height / seconds;
+    render.raysPerSecond = rays / seconds;
+}
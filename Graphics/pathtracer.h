@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include "bvh.h"
+#include "primitives.h"
+#include "vertex_format.h"
+
+// --- CPU path tracer ---
+// Renders still images of the same geometry the scenes draw. The prisms,
+// quads, owl meshes and terrain are added as world space triangles. Lighting
+// comes from a uniform sky, in the color the rasterized view clears to,
+// and a sun. Surfaces are Lambertian, with the colors and textures the
+// rasterizer shows.
+//
+// Rays are traced four at a time, as SSE packets. In a pass a packet is a
+// 2x2 block of camera rays; after the first bounce its rays go their own
+// ways. A packet walks a BVH flattened from bvh.h's build. A node is
+// entered when any active ray hits its box, and the ray in the first active
+// lane chooses which child comes first. Leaf triangles are tested against
+// all four rays at once, and shadow rays stop at any hit.
+//
+// The image is cut into PT_TILE square tiles, rendered in runs of tiles,
+// a few runs per worker, on the job system. A pass adds one sample per
+// pixel to the running sums. While nothing changes, the sums keep
+// accumulating and the image converges; any change starts over with
+// PtRenderReset.
+
+const int PT_TILE = 16;            // Tile edge in pixels
+const int PT_JOBS_PER_WORKER = 8;  // Runs of tiles per worker in a pass, to balance uneven tiles
+const int PT_MAX_BOUNCES = 3;      // Diffuse bounces after the camera ray
+const float PT_RAY_OFFSET = 1e-3f; // New rays start this far off the surface
+const float PT_SUN_SPREAD = 0.02f; // Radius of the sun's disk, for soft shadow edges
+
+struct PtTexture {
+    const unsigned char* rgb; // width * height RGB texels, not owned
+    int width, height;
+};
+
+struct PtMaterial {
+    float color[3];  // Linear albedo; multiplies the texture
+    int texture;     // -1 for none
+};
+
+// Intersection data, in the order of the BVH's leaves
+struct PtTriangle {
+    Vec3 corner, edge1, edge2;
+};
+
+struct PtShading {
+    Vec3 normal[3];  // World space, per corner
+    float uv[3][2];
+    int material;
+};
+
+struct PtNode {
+    Aabb box;
+    int left;         // First child, the second follows it; -1 for a leaf
+    int first, count; // Triangles of a leaf
+    int axis;         // Along which the children are furthest apart
+};
+
+struct PtScene {
+    std::vector<PtTriangle> triangles;
+    std::vector<PtShading> shading;
+    std::vector<PtMaterial> materials;
+    std::vector<PtTexture> textures;
+    std::vector<PtNode> nodes;  // Built by PtSceneBuild
+    float sky[3];               // Linear radiance from every direction
+    Vec3 sunDirection;          // Towards the sun, normalized
+    float sun[3];               // Linear radiance a white surface facing the sun reflects
+};
+
+struct PtRender {
+    int width, height;
+    Vec3 eye;
+    Vec3 corner, stepX, stepY;          // Far plane point at the bottom-left pixel corner, and per pixel
+    std::vector<float> accumulated;     // Linear RGB sums, bottom row first
+    std::vector<unsigned char> pixels;  // Average as sRGB bytes, laid out for glDrawPixels
+    std::vector<int> tileRays;          // Traced by each tile in the last pass
+    int samples;                        // Per pixel so far
+    double passMilliseconds;            // Of the last pass
+    double samplesPerSecond, raysPerSecond;
+};
+
+// Empties the scene and sets the lights. Colors are in display (sRGB) units.
+void PtSceneBegin(PtScene& scene, const float sky[3], const Vec3& sunDirection, const float sun[3]);
+int PtSceneAddTexture(PtScene& scene, const unsigned char* rgb, int width, int height); // Returns the index
+int PtSceneAddMaterial(PtScene& scene, double r, double g, double b, int texture);      // Color in display units
+
+// Quads in DrawCylinder1's vertex order, flat shaded
+void PtSceneAddQuads(PtScene& scene, const Matrix4& world, const PrimitiveVertex* quads, int count, int material);
+// Smooth uses the mesh's packed normals; without them triangles are flat shaded
+void PtSceneAddMesh(PtScene& scene, const Matrix4& world, const PackedMesh& mesh, int material, bool smooth);
+void PtSceneBuild(PtScene& scene); // After every add, before rendering
+
+// Starts over for a new view. viewProjection is the camera the window
+// draws with; pixel (0, 0) is at the bottom left, as in glDrawPixels.
+void PtRenderReset(PtRender& render, int width, int height, const Matrix4& viewProjection, const Vec3& eye);
+// One more sample per pixel, tiles spread over the job system; updates pixels and the rates
+void PtRenderPass(PtRender& render, const PtScene& scene);
@@ -0,0 +1,72 @@
+#include <math.h>
+#include "picking.h"
+
+PickRay PickRayFromWindow(const Matrix4& viewProjection, int viewportX, int viewportY, int viewportWidth,
+    int viewportHeight, int windowX, int windowY) {
+    // Pixel center in normalized device coordinates, on the near and far planes
+    float x = 2 * (windowX - viewportX + 0.5f) / viewportWidth - 1;
+    float y = 2 * (windowY - viewportY + 0.5f) / viewportHeight - 1;
+    Matrix4 inverse = MatInverse(viewProjection);
+    Vec4 nearPoint = MatTransform(inverse, MakeVec4(x, y, -1, 1));
+    Vec4 farPoint = MatTransform(inverse, MakeVec4(x, y, 1, 1));
+
+    PickRay ray;
+    ray.origin = XYZ(nearPoint) * (1 / nearPoint.w);
+    ray.direction = Normalize(XYZ(farPoint) * (1 / farPoint.w) - ray.origin);
+    return ray;
+}
+
+// Moller-Trumbore
+bool PickTriangle(const PickRay& ray, const Vec3& a, const Vec3& b, const Vec3& c, float* t) {
+    Vec3 edge1 = b - a, edge2 = c - a;
+    Vec3 p = Cross(ray.direction, edge2);
+    float determinant = Dot(edge1, p);
+    if (fabsf(determinant) < 1e-12f) return false; // Parallel to the triangle, or degenerate
+    float inverse = 1 / determinant;
+
+    Vec3 s = ray.origin - a;
+    float u = Dot(s, p) * inverse;
+    if (u < 0 || u > 1) return false;
+    Vec3 q = Cross(s, edge1);
+    float v = Dot(ray.direction, q) * inverse;
+    if (v < 0 || u + v > 1) return false;
+
+    float distance = Dot(edge2, q) * inverse;
+    if (distance < 0 || distance >= *t) return false;
+    *t = distance;
+    return true;
+}
+
+bool PickSphere(const PickRay& ray, const Vec3& center, float radius, float t) {
+    Vec3 toCenter = center - ray.origin;
+    float along = Dot(toCenter, ray.direction);
+    float squared = Dot(toCenter, toCenter) - along * along; // Squared distance of the center from the ray
+    if (squared > radius * radius) return false;
+    return along - sqrtf(radius * radius - squared) < t; // Where the ray enters the sphere
+}
+
+bool PickMesh(const PickRay& ray, const Matrix4& world, const PackedMesh& mesh, float* t) {
+    Matrix4 toWorld = MatMultiply(world, QuantizationMatrix(mesh.quantization));
+    bool hit = false;
+    for (int i = 0; i + 2 < mesh.indexCount; i += 3) {
+        Vec3 corner[3];
+        for (int k = 0; k < 3; k++) {
+            const short* p = mesh.vertexData[mesh.indexData[i + k]].position;
+            corner[k] = MatTransformPoint(toWorld, MakeVec3(p[0], p[1], p[2]));
+        }
+        hit = PickTriangle(ray, corner[0], corner[1], corner[2], t) || hit;
+    }
+    return hit;
+}
+
+bool PickQuads(const PickRay& ray, const Matrix4& world, const PrimitiveVertex* quads, int count, float* t) {
+    bool hit = false;
+    for (int i = 0; i + 3 < count; i += 4) {
+        Vec3 corner[4];
+        for (int k = 0; k < 4; k++)
+            corner[k] = MatTransformPoint(world, MakeVec3(quads[i + k].x, quads[i + k].y, quads[i + k].z));
+        hit = PickTriangle(ray, corner[0], corner[1], corner[2], t) || hit;
+        hit = PickTriangle(ray, corner[0], corner[2], corner[3], t) || hit;
+    }
+    return hit;
+}
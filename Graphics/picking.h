@@ -0,0 +1,34 @@
+#pragma once
+#include "primitives.h"
+#include "vecmath.h"
+#include "vertex_format.h"
+
+// --- Ray picking ---
+// A click becomes a world-space ray through the pixel, unprojected with the
+// inverse of the camera's view-projection. Scenes find candidate objects
+// with a BVH ray query on their bounds and test only those exactly, against
+// the triangles they draw, all on the CPU: nothing is read back from the GPU.
+//
+// Triangles are taken to world space rather than the ray to object space,
+// so flattened parts (a zero scale) can still be hit.
+
+const float PICK_HIGHLIGHT[3] = { 1, 0.85f, 0 }; // Color the picked object is drawn in
+
+struct PickRay {
+    Vec3 origin;     // On the near plane
+    Vec3 direction;  // Normalized, so t is a world-space distance
+};
+
+// Window coordinates have their origin at the bottom-left corner, like UiHitTest's
+PickRay PickRayFromWindow(const Matrix4& viewProjection, int viewportX, int viewportY, int viewportWidth,
+    int viewportHeight, int windowX, int windowY);
+
+// Both sides count. True, with *t lowered, when hit closer than *t.
+bool PickTriangle(const PickRay& ray, const Vec3& a, const Vec3& b, const Vec3& c, float* t);
+
+// Whether the ray passes through the sphere closer than t, to skip a part's triangles
+bool PickSphere(const PickRay& ray, const Vec3& center, float radius, float t);
+
+// The same for every triangle of a mesh placed by world
+bool PickMesh(const PickRay& ray, const Matrix4& world, const PackedMesh& mesh, float* t);
+bool PickQuads(const PickRay& ray, const Matrix4& world, const PrimitiveVertex* quads, int count, float* t);
@@ -0,0 +1,167 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "poster.h"
+#include "glew.h"
+#include "image_writer.h"
+
+// --- Band hand-off ---
+// Band b goes through buffer b % 2. rows[i] is 0 while buffer i is free
+// for rendering, and its band's height once it is ready to write.
+struct BandQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<unsigned char> buffers[2]; // Bottom row first, as read back
+    int rows[2];
+};
+
+static void writeBands(BandQueue* queue, ImageWriter* writer, int bands) {
+    size_t rowBytes = (size_t)writer->width * 3;
+    for (int band = 0; band < bands; band++) {
+        int buffer = band % 2, rows;
+        {
+            std::unique_lock<std::mutex> lock(queue->mutex);
+            queue->changed.wait(lock, [&] { return queue->rows[buffer] > 0; });
+            rows = queue->rows[buffer];
+        }
+        const unsigned char* pixels = queue->buffers[buffer].data();
+        for (int row = rows - 1; row >= 0; row--) ImageWriterRow(*writer, pixels + row * rowBytes);
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->rows[buffer] = 0;
+        }
+        queue->changed.notify_all();
+    }
+}
+
+// --- Offscreen target ---
+struct TileTarget {
+    GLuint fbo, color, depth;
+};
+
+static bool createTarget(TileTarget& target, int width, int height) {
+    glGenRenderbuffers(1, &target.color);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &target.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void deleteTarget(TileTarget& target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &target.fbo);
+    glDeleteRenderbuffers(1, &target.color);
+    glDeleteRenderbuffers(1, &target.depth);
+}
+
+// Largest tile edge the GL can render and the band buffer can hold rows of
+static int tileSize() {
+    GLint renderbuffer = 0, viewport[2] = { 0, 0 };
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &renderbuffer);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, viewport);
+    int size = POSTER_MAX_TILE;
+    if (renderbuffer > 0 && renderbuffer < size) size = renderbuffer;
+    if (viewport[0] > 0 && viewport[0] < size) size = viewport[0];
+    if (viewport[1] > 0 && viewport[1] < size) size = viewport[1];
+    return size;
+}
+
+// --- Rendering ---
+bool PosterRender(const char* path, int width, int height, const float frustum[6], PosterDrawFunction draw,
+    void* data, PosterStats* stats) {
+    using namespace std::chrono;
+    if (!GLEW_ARB_framebuffer_object && !GLEW_VERSION_3_0) return false;
+    steady_clock::time_point start = steady_clock::now();
+
+    int tile = tileSize();
+    size_t rowBytes = (size_t)width * 3;
+    int bandRows = (int)(POSTER_BAND_BYTES / rowBytes);
+    if (bandRows > tile) bandRows = tile;
+    if (bandRows < 1) bandRows = 1;
+    int tileWidth = width < tile ? width : tile;
+    int bands = (height + bandRows - 1) / bandRows;
+
+    TileTarget target;
+    if (!createTarget(target, tileWidth, bandRows)) {
+        deleteTarget(target);
+        return false;
+    }
+    ImageWriter writer;
+    if (!ImageWriterOpen(writer, path, width, height)) {
+        deleteTarget(target);
+        ImageWriterClose(writer);
+        return false;
+    }
+
+    BandQueue queue;
+    for (int i = 0; i < 2; i++) {
+        queue.buffers[i].resize(rowBytes * bandRows);
+        queue.rows[i] = 0;
+    }
+    std::thread writerThread(writeBands, &queue, &writer, bands);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ROW_LENGTH, width);
+    float left = frustum[0], right = frustum[1], bottom = frustum[2], top = frustum[3];
+    int tiles = 0;
+
+    // Bands from the top of the image down, tiles left to right. GL rows
+    // count up from the bottom, so band b's lowest row is y0.
+    for (int band = 0; band < bands; band++) {
+        int buffer = band % 2;
+        int rows = height - band * bandRows < bandRows ? height - band * bandRows : bandRows;
+        int y0 = height - band * bandRows - rows;
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.changed.wait(lock, [&] { return queue.rows[buffer] == 0; });
+        }
+
+        for (int x0 = 0; x0 < width; x0 += tileWidth) {
+            int columns = width - x0 < tileWidth ? width - x0 : tileWidth;
+            Matrix4 projection = MatFrustum(left + (right - left) * x0 / width,
+                left + (right - left) * (x0 + columns) / width, bottom + (top - bottom) * y0 / height,
+                bottom + (top - bottom) * (y0 + rows) / height, frustum[4], frustum[5]);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+            glViewport(0, 0, columns, rows);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw(projection, data);
+            glBindFramebuffer(GL_FRAMEBUFFER, target.fbo); // In case draw bound another
+            glReadPixels(0, 0, columns, rows, GL_RGB, GL_UNSIGNED_BYTE, queue.buffers[buffer].data() + x0 * 3);
+            tiles++;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.rows[buffer] = rows;
+        }
+        queue.changed.notify_all();
+    }
+
+    writerThread.join();
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    deleteTarget(target);
+    bool written = ImageWriterClose(writer);
+
+    if (stats) {
+        stats->tiles = tiles;
+        stats->bands = bands;
+        stats->seconds = duration<double>(steady_clock::now() - start).count();
+        stats->peakBytes = rowBytes * bandRows * 2;
+    }
+    return written;
+}
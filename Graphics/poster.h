@@ -0,0 +1,35 @@
+#pragma once
+#include <stddef.h>
+#include "vecmath.h"
+
+// --- Tiled poster rendering ---
+// Renders the view at a size far beyond the window or any framebuffer,
+// e.g. 16384 pixels across for print. The view's frustum is cut into a
+// grid of sub-frustums, and each tile is drawn into an offscreen
+// framebuffer with its own projection, then read back.
+//
+// The image files stream rows top to bottom (image_writer.h), so tiles are
+// grouped into full-width bands. While one band is rendered, a writer
+// thread encodes the one before it, and the two band buffers are the only
+// pixels held in memory. A band is at most POSTER_BAND_BYTES, so its height
+// shrinks as the image gets wider and memory stays the same at any size.
+
+const int POSTER_MAX_TILE = 4096;             // Tile edge limit, below the GL's own
+const size_t POSTER_BAND_BYTES = 32u << 20;   // One band buffer
+
+// Draws the scene for one tile: loads projection (which replaces the
+// view's frustum) and draws as display() does. The framebuffer is bound,
+// cleared and has its viewport set.
+typedef void (*PosterDrawFunction)(const Matrix4& projection, void* data);
+
+struct PosterStats {
+    int tiles, bands;
+    double seconds;
+    size_t peakBytes;  // Band buffers
+};
+
+// frustum is as for MatFrustum, and has the image's aspect ratio for square
+// pixels. PNG, or TIFF for a .tif/.tiff path. False without framebuffer
+// objects or when the file cannot be written.
+bool PosterRender(const char* path, int width, int height, const float frustum[6], PosterDrawFunction draw,
+    void* data, PosterStats* stats);
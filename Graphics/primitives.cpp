@@ -0,0 +1,99 @@
+#include <math.h>
+#include "glew.h"
+#include "glut.h"
+#include "primitives.h"
+
+// Bands of a runtime side count, with trig on integer-indexed angles
+static void buildBandFallback(int sides, float topr, float topY, float bottomr, float bottomY, float uRepeat,
+    PrimitiveVertex* out) {
+    for (int k = 0; k < sides; k++, out += 4) {
+        double a0 = 2 * PRIMITIVE_PI * k / sides;
+        double a1 = k + 1 == sides ? 0 : 2 * PRIMITIVE_PI * (k + 1) / sides; // Close the seam exactly
+        float s0 = (float)sin(a0), c0 = (float)cos(a0), s1 = (float)sin(a1), c1 = (float)cos(a1);
+        PrimitiveVertex side[4] = {
+            { 0, 0, topr * s0, topY, topr * c0 },
+            { uRepeat, 0, topr * s1, topY, topr * c1 },
+            { uRepeat, 1, bottomr * s1, bottomY, bottomr * c1 },
+            { 0, 1, bottomr * s0, bottomY, bottomr * c0 }
+        };
+        for (int i = 0; i < 4; i++) out[i] = side[i];
+    }
+}
+
+int PrimitivePrismVertices(int sides, float topr, float bottomr, float uRepeat, PrimitiveVertex* out) {
+    switch (sides) {
+    case 4: BuildPrism<4>(topr, bottomr, uRepeat, out); break;
+    case 7: BuildPrism<7>(topr, bottomr, uRepeat, out); break;
+    case 15: BuildPrism<15>(topr, bottomr, uRepeat, out); break;
+    case 17: BuildPrism<17>(topr, bottomr, uRepeat, out); break;
+    case 20: BuildPrism<20>(topr, bottomr, uRepeat, out); break;
+    case 30: BuildPrism<30>(topr, bottomr, uRepeat, out); break;
+    default: buildBandFallback(sides, topr, 1, bottomr, 0, uRepeat, out); break;
+    }
+    return sides * 4;
+}
+
+static void drawQuads(const PrimitiveVertex* vertices, int count) {
+    glInterleavedArrays(GL_T2F_V3F, sizeof(PrimitiveVertex), vertices);
+    glDrawArrays(GL_QUADS, 0, count);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+void PrimitiveDrawPrism(int sides, float topr, float bottomr, float uRepeat) {
+    if (sides < 3 || sides > MAX_PRIMITIVE_SIDES) return;
+    PrimitiveVertex vertices[MAX_PRIMITIVE_SIDES * 4];
+    drawQuads(vertices, PrimitivePrismVertices(sides, topr, bottomr, uRepeat, vertices));
+}
+
+// Built once per tessellation the owl uses; the arrays never change
+template <int Sides, int Slices>
+static const PrimitiveVertex* sphereVertices() {
+    static PrimitiveVertex vertices[Sides * Slices * 4];
+    static bool built = (BuildSphere<Sides, Slices>(vertices), true);
+    (void)built;
+    return vertices;
+}
+
+// Compiled tessellations, or 0
+static const PrimitiveVertex* compiledSphere(int sides, int slices) {
+    if (sides != slices) return 0;
+    switch (sides) {
+    case 15: return sphereVertices<15, 15>();
+    case 17: return sphereVertices<17, 17>();
+    case 20: return sphereVertices<20, 20>();
+    }
+    return 0;
+}
+
+// Band i of the fallback sphere, with the same integer-indexed latitudes
+static void buildSphereBandFallback(int sides, int slices, int i, PrimitiveVertex* out) {
+    double b0 = PRIMITIVE_PI * i / slices, b1 = PRIMITIVE_PI * (i + 1) / slices;
+    buildBandFallback(sides, (float)sin(b1), (float)-cos(b1), (float)sin(b0), (float)-cos(b0), 1, out);
+}
+
+int PrimitiveSphereVertices(int sides, int slices, PrimitiveVertex* out) {
+    int count = sides * slices * 4;
+    const PrimitiveVertex* compiled = compiledSphere(sides, slices);
+    if (compiled) {
+        for (int i = 0; i < count; i++) out[i] = compiled[i];
+        return count;
+    }
+    for (int i = 0; i < slices; i++) buildSphereBandFallback(sides, slices, i, out + i * sides * 4);
+    return count;
+}
+
+void PrimitiveDrawSphere(int sides, int slices) {
+    const PrimitiveVertex* compiled = compiledSphere(sides, slices);
+    if (compiled) {
+        drawQuads(compiled, sides * slices * 4);
+        return;
+    }
+    if (sides < 3 || sides > MAX_PRIMITIVE_SIDES || slices < 1 || slices > MAX_PRIMITIVE_SIDES) return;
+
+    PrimitiveVertex vertices[MAX_PRIMITIVE_SIDES * 4];
+    for (int i = 0; i < slices; i++) { // Band by band
+        buildSphereBandFallback(sides, slices, i, vertices);
+        drawQuads(vertices, sides * 4);
+    }
+}
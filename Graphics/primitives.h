@@ -0,0 +1,105 @@
+#pragma once
+
+// --- Primitive tables and builders ---
+// Unit-circle tables are generated at compile time for each side count in
+// use, so prisms and spheres are built without runtime trig. The angle of
+// entry k is derived from k itself, never accumulated, and entry N repeats
+// entry 0 bit for bit, so every prism has exactly N sides and its last side
+// closes the seam exactly. Sphere bands share their ring vertices, so there
+// are no cracks between bands either.
+//
+// Side counts without a table fall back to runtime trig on the same
+// integer-indexed angles.
+
+const int MAX_PRIMITIVE_SIDES = 64; // Largest prism or sphere ring the draw functions accept
+
+// Laid out for glInterleavedArrays(GL_T2F_V3F)
+struct PrimitiveVertex {
+    float u, v;
+    float x, y, z;
+};
+
+// --- Compile-time trig ---
+constexpr double PRIMITIVE_PI = 3.14159265358979323846;
+
+// Taylor series after reduction to [-pi, pi]; accurate to double precision
+constexpr double ConstSin(double x) {
+    while (x > PRIMITIVE_PI) x -= 2 * PRIMITIVE_PI;
+    while (x < -PRIMITIVE_PI) x += 2 * PRIMITIVE_PI;
+
+    double term = x, sum = x;
+    for (int i = 1; i < 24; i++) {
+        term *= -x * x / ((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double ConstCos(double x) {
+    return ConstSin(x + PRIMITIVE_PI / 2);
+}
+
+template <int N>
+struct UnitCircle {
+    float sin[N + 1], cos[N + 1]; // Entry k at angle 2*pi*k/N; entry N repeats entry 0
+};
+
+template <int N>
+constexpr UnitCircle<N> MakeUnitCircle() {
+    UnitCircle<N> circle = {};
+    for (int k = 0; k < N; k++) {
+        double angle = 2 * PRIMITIVE_PI * k / N;
+        circle.sin[k] = (float)ConstSin(angle);
+        circle.cos[k] = (float)ConstCos(angle);
+    }
+    circle.sin[N] = circle.sin[0];
+    circle.cos[N] = circle.cos[0];
+    return circle;
+}
+
+template <int N>
+struct CircleTable {
+    static constexpr UnitCircle<N> value = MakeUnitCircle<N>();
+};
+
+template <int N>
+constexpr UnitCircle<N> CircleTable<N>::value;
+
+// --- Builders ---
+// One ring-to-ring band of Sides quads, four vertices per side in
+// DrawCylinder1's order (top two, then bottom two); each side spans u = 0..uRepeat
+template <int Sides>
+void BuildBand(float topr, float topY, float bottomr, float bottomY, float uRepeat, PrimitiveVertex* out) {
+    const UnitCircle<Sides>& c = CircleTable<Sides>::value;
+    for (int k = 0; k < Sides; k++, out += 4) {
+        PrimitiveVertex side[4] = {
+            { 0, 0, topr * c.sin[k], topY, topr * c.cos[k] },
+            { uRepeat, 0, topr * c.sin[k + 1], topY, topr * c.cos[k + 1] },
+            { uRepeat, 1, bottomr * c.sin[k + 1], bottomY, bottomr * c.cos[k + 1] },
+            { 0, 1, bottomr * c.sin[k], bottomY, bottomr * c.cos[k] }
+        };
+        for (int i = 0; i < 4; i++) out[i] = side[i];
+    }
+}
+
+// Prism sides from y = 0 (bottomr) to y = 1 (topr), as DrawCylinder1 draws them
+template <int Sides>
+void BuildPrism(float topr, float bottomr, float uRepeat, PrimitiveVertex* out) {
+    BuildBand<Sides>(topr, 1, bottomr, 0, uRepeat, out);
+}
+
+// Unit sphere as Slices bands of Sides quads, bottom to top. Latitudes come
+// from the circle with twice as many entries: sin(-pi/2 + pi*i/Slices) is
+// -cos(2*pi*i/(2*Slices)) and the ring radius is the matching sin.
+template <int Sides, int Slices>
+void BuildSphere(PrimitiveVertex* out) {
+    const UnitCircle<2 * Slices>& latitude = CircleTable<2 * Slices>::value;
+    for (int i = 0; i < Slices; i++, out += Sides * 4)
+        BuildBand<Sides>(latitude.sin[i + 1], -latitude.cos[i + 1], latitude.sin[i], -latitude.cos[i], 1, out);
+}
+
+// Side counts with compiled tables dispatch to the templates, others use the fallback
+int PrimitivePrismVertices(int sides, float topr, float bottomr, float uRepeat, PrimitiveVertex* out); // Returns sides * 4
+int PrimitiveSphereVertices(int sides, int slices, PrimitiveVertex* out); // Returns sides * slices * 4
+void PrimitiveDrawPrism(int sides, float topr, float bottomr, float uRepeat);
+void PrimitiveDrawSphere(int sides, int slices);
@@ -0,0 +1,35 @@
+#include "scene_graph.h"
+
+int SceneAddNode(SceneGraph& graph, int parent, const Matrix4& local) {
+    SceneNode node;
+    node.parent = parent;
+    node.local = local;
+    node.dirty = true;
+
+    graph.nodes.push_back(node);
+    graph.world.push_back(local);
+    graph.changed.push_back(0);
+    return (int)graph.nodes.size() - 1;
+}
+
+void SceneSetLocal(SceneGraph& graph, int node, const Matrix4& local) {
+    graph.nodes[node].local = local;
+    graph.nodes[node].dirty = true;
+}
+
+void SceneUpdate(SceneGraph& graph) {
+    int count = 0;
+
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        SceneNode& node = graph.nodes[i];
+        bool parentChanged = node.parent >= 0 && graph.changed[node.parent];
+
+        graph.changed[i] = node.dirty || parentChanged;
+        if (!graph.changed[i]) continue; // Cached matrix still valid
+
+        graph.world[i] = node.parent >= 0 ? MatMultiply(graph.world[node.parent], node.local) : node.local;
+        node.dirty = false;
+        count++;
+    }
+    graph.lastUpdateCount = count;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include "vecmath.h"
+
+// --- Scene graph ---
+// Nodes hold a local transform and a cached world matrix. Nodes are stored
+// parents-first, so one linear pass recomputes exactly the nodes whose
+// local transform changed and their descendants; everything else keeps its
+// cached matrix. Renderers read the flat world matrix array directly.
+
+struct SceneNode {
+    int parent;      // -1 for a root, always lower than the node's own index
+    Matrix4 local;   // Relative to the parent
+    bool dirty;      // Local transform changed since the last update
+};
+
+struct SceneGraph {
+    std::vector<SceneNode> nodes;
+    std::vector<Matrix4> world;          // Cached world matrices, one per node
+    std::vector<unsigned char> changed;  // Scratch: world matrix recomputed in this update
+    int lastUpdateCount;                 // World matrices recomputed by the last update
+};
+
+int SceneAddNode(SceneGraph& graph, int parent, const Matrix4& local);
+void SceneSetLocal(SceneGraph& graph, int node, const Matrix4& local);
+void SceneUpdate(SceneGraph& graph);
+
+inline const Matrix4* SceneWorldMatrices(const SceneGraph& graph) {
+    return graph.world.empty() ? 0 : &graph.world[0];
+}
@@ -0,0 +1,37 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "simulation.h"
+
+// Largest number of ticks caught up in one go after a stall
+static const int MAX_CATCH_UP_TICKS = 10;
+
+static std::thread simThread;
+static std::atomic<bool> simRunning(false);
+
+static void simulationLoop(void (*tick)(), int ticksPerSecond) {
+    using namespace std::chrono;
+    const steady_clock::duration step = duration_cast<steady_clock::duration>(seconds(1)) / ticksPerSecond;
+    steady_clock::time_point next = steady_clock::now();
+
+    while (simRunning.load(std::memory_order_relaxed)) {
+        int ticks = 0;
+        while (steady_clock::now() >= next && ticks < MAX_CATCH_UP_TICKS) {
+            tick();
+            next += step;
+            ticks++;
+        }
+        if (ticks == MAX_CATCH_UP_TICKS) next = steady_clock::now(); // Drop the backlog
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void StartSimulation(void (*tick)(), int ticksPerSecond) {
+    if (simRunning.exchange(true)) return; // Already running
+    simThread = std::thread(simulationLoop, tick, ticksPerSecond);
+}
+
+void StopSimulation() {
+    if (!simRunning.exchange(false)) return;
+    if (simThread.joinable()) simThread.join();
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// --- Simulation thread ---
+// Runs the given tick function at a fixed rate on its own thread, so input
+// handling and camera integration never wait for a slow frame and a slow
+// tick never stalls rendering. Ticks that fall behind are caught up without
+// sleeping, capped so a long stall does not turn into a burst of motion.
+void StartSimulation(void (*tick)(), int ticksPerSecond);
+void StopSimulation();
@@ -0,0 +1,231 @@
+#include <vector>
+#include "glew.h"
+#include "freeglut.h" // glutBitmapHeight
+#include "text.h"
+
+// Printable ASCII range kept in the atlas
+const int FIRST_GLYPH = 32;
+const int GLYPH_COUNT = 95;
+const int ATLAS_COLUMNS = 16;
+const int MAX_FONTS = 4;
+
+struct TextVertex {
+    float x, y;
+    float u, v;
+    unsigned char color[4];
+};
+
+struct Glyph {
+    float u0, v0, u1, v1; // Cell in the atlas
+    int advance;          // Pen advance in pixels
+};
+
+struct FontAtlas {
+    void* font;
+    GLuint texture;       // 0 when the atlas could not be built (fallback to glutBitmapCharacter)
+    int cellWidth, cellHeight;
+    int descent;          // Pixels below the baseline inside a cell
+    Glyph glyphs[GLYPH_COUNT];
+    std::vector<TextVertex> vertices; // Queued quads, reused every frame
+};
+
+static FontAtlas atlases[MAX_FONTS];
+static int numAtlases = 0;
+static GLuint textVbo = 0;
+static size_t textVboSize = 0;
+
+// --- Atlas construction ---
+static void buildAtlas(FontAtlas& atlas) {
+    int rows = (GLYPH_COUNT + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    int widest = 0;
+
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        atlas.glyphs[i].advance = glutBitmapWidth(atlas.font, FIRST_GLYPH + i);
+        if (atlas.glyphs[i].advance > widest) widest = atlas.glyphs[i].advance;
+    }
+    atlas.cellWidth = widest + 1; // 1 pixel gap so neighbours never bleed in
+    atlas.cellHeight = glutBitmapHeight(atlas.font) + 1;
+    atlas.descent = glutBitmapHeight(atlas.font) / 4;
+    atlas.texture = 0;
+
+    if (!GLEW_ARB_framebuffer_object && !GLEW_VERSION_3_0) return;
+
+    int w = ATLAS_COLUMNS * atlas.cellWidth, h = rows * atlas.cellHeight;
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        int cx = (i % ATLAS_COLUMNS) * atlas.cellWidth, cy = (i / ATLAS_COLUMNS) * atlas.cellHeight;
+        atlas.glyphs[i].u0 = cx / (float)w;
+        atlas.glyphs[i].v0 = cy / (float)h;
+        atlas.glyphs[i].u1 = (cx + atlas.cellWidth) / (float)w;
+        atlas.glyphs[i].v1 = (cy + atlas.cellHeight) / (float)h;
+    }
+
+    glGenTextures(1, &atlas.texture);
+    glBindTexture(GL_TEXTURE_2D, atlas.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+    GLint previousFbo; // Atlases may be built lazily while another target is bound
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas.texture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        // Rasterize every glyph once, white on transparent
+        glPushAttrib(GL_ALL_ATTRIB_BITS);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_TEXTURE_2D);
+        glViewport(0, 0, w, h);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0, w, 0, h, -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glColor4d(1, 1, 1, 1);
+        for (int i = 0; i < GLYPH_COUNT; i++) {
+            glRasterPos2i((i % ATLAS_COLUMNS) * atlas.cellWidth, (i / ATLAS_COLUMNS) * atlas.cellHeight + atlas.descent);
+            glutBitmapCharacter(atlas.font, FIRST_GLYPH + i);
+        }
+
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+    }
+    else {
+        glDeleteTextures(1, &atlas.texture);
+        atlas.texture = 0;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+    glDeleteFramebuffers(1, &fbo);
+
+    atlas.vertices.reserve(4 * 1024);
+}
+
+static FontAtlas* findAtlas(void* font) {
+    for (int i = 0; i < numAtlases; i++)
+        if (atlases[i].font == font) return &atlases[i];
+
+    if (numAtlases == MAX_FONTS) return 0;
+    FontAtlas* atlas = &atlases[numAtlases++];
+    atlas->font = font;
+    buildAtlas(*atlas);
+    return atlas;
+}
+
+void TextLoadFont(void* font) {
+    findAtlas(font);
+}
+
+// --- Queuing ---
+void TextPrint(void* font, double x, double y, double r, double g, double b, const char* text) {
+    FontAtlas* atlas = findAtlas(font);
+
+    if (!atlas || atlas->texture == 0) { // No atlas, draw straight away
+        glColor3d(r, g, b);
+        glRasterPos2d(x, y);
+        for (const char* c = text; *c; c++)
+            glutBitmapCharacter(font, *c);
+        return;
+    }
+
+    TextVertex v;
+    v.color[0] = (unsigned char)(r * 255);
+    v.color[1] = (unsigned char)(g * 255);
+    v.color[2] = (unsigned char)(b * 255);
+    v.color[3] = 255;
+
+    float penX = (float)x;
+    float bottom = (float)y - atlas->descent, top = bottom + atlas->cellHeight;
+
+    for (const char* c = text; *c; c++) {
+        int index = (unsigned char)*c - FIRST_GLYPH;
+        if (index < 0 || index >= GLYPH_COUNT) continue;
+        const Glyph& glyph = atlas->glyphs[index];
+        float right = penX + atlas->cellWidth;
+
+        if (*c != ' ') {
+            v.x = penX;  v.y = bottom; v.u = glyph.u0; v.v = glyph.v0; atlas->vertices.push_back(v);
+            v.x = right; v.y = bottom; v.u = glyph.u1; v.v = glyph.v0; atlas->vertices.push_back(v);
+            v.x = right; v.y = top;    v.u = glyph.u1; v.v = glyph.v1; atlas->vertices.push_back(v);
+            v.x = penX;  v.y = top;    v.u = glyph.u0; v.v = glyph.v1; atlas->vertices.push_back(v);
+        }
+        penX += glyph.advance;
+    }
+}
+
+int TextWidth(void* font, const char* text) {
+    int width = 0;
+    for (const char* c = text; *c; c++)
+        width += glutBitmapWidth(font, *c);
+    return width;
+}
+
+int TextHeight(void* font) {
+    return glutBitmapHeight(font);
+}
+
+// --- Drawing ---
+void TextFlush() {
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    if (textVbo == 0 && GLEW_VERSION_1_5) glGenBuffers(1, &textVbo);
+
+    for (int i = 0; i < numAtlases; i++) {
+        FontAtlas& atlas = atlases[i];
+        if (atlas.vertices.empty()) continue;
+
+        size_t bytes = atlas.vertices.size() * sizeof(TextVertex);
+        const char* base = (const char*)&atlas.vertices[0];
+        if (textVbo) { // One buffer upload per font per frame
+            glBindBuffer(GL_ARRAY_BUFFER, textVbo);
+            if (bytes > textVboSize) textVboSize = bytes * 2;
+            glBufferData(GL_ARRAY_BUFFER, textVboSize, 0, GL_STREAM_DRAW); // Orphan last frame's data
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, base);
+            base = 0;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, atlas.texture);
+        glVertexPointer(2, GL_FLOAT, sizeof(TextVertex), base);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(TextVertex), base + 2 * sizeof(float));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(TextVertex), base + 4 * sizeof(float));
+        glDrawArrays(GL_QUADS, 0, (GLsizei)atlas.vertices.size());
+
+        atlas.vertices.clear(); // Keeps capacity, no reallocation next frame
+    }
+
+    if (textVbo) glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glPopAttrib();
+}
+
+void TextRelease() {
+    for (int i = 0; i < numAtlases; i++)
+        if (atlases[i].texture) glDeleteTextures(1, &atlases[i].texture);
+    if (textVbo) glDeleteBuffers(1, &textVbo);
+    numAtlases = 0;
+    textVbo = 0;
+    textVboSize = 0;
+}
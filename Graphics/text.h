@@ -0,0 +1,15 @@
+#pragma once
+
+// --- Batched text rendering ---
+// Each GLUT bitmap font is rasterized once into a glyph atlas texture.
+// TextPrint() only appends textured quads to the font's vertex batch;
+// TextFlush() draws every queued string with one draw call per font.
+// Coordinates are in pixels of the current projection, (x, y) is the
+// baseline origin like glRasterPos.
+
+void TextLoadFont(void* font); // Build the atlas (needs a GL context)
+void TextPrint(void* font, double x, double y, double r, double g, double b, const char* text);
+int TextWidth(void* font, const char* text);
+int TextHeight(void* font);
+void TextFlush(); // Draw and clear all batches
+void TextRelease();
@@ -0,0 +1,196 @@
+#include "ui.h"
+#include "glut.h"
+#include "text.h"
+
+// --- Layout ---
+// Texture + FBO the panel is cached in; left at 0 to draw directly every frame
+static void createTarget(UiPanel& panel) {
+    if (!GLEW_ARB_framebuffer_object && !GLEW_VERSION_3_0) return; // Draw directly instead
+
+    glGenTextures(1, &panel.texture);
+    glBindTexture(GL_TEXTURE_2D, panel.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, panel.viewport.w, panel.viewport.h, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+
+    glGenFramebuffers(1, &panel.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, panel.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, panel.texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        UiRelease(panel);
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void UiInitPanel(UiPanel& panel, UiRect viewport, double r, double g, double b) {
+    panel.viewport = viewport;
+    panel.background[0] = r;
+    panel.background[1] = g;
+    panel.background[2] = b;
+    panel.numSliders = 0;
+    panel.dirty = true;
+    panel.fbo = 0;
+    panel.texture = 0;
+    createTarget(panel);
+}
+
+int UiAddSlider(UiPanel& panel, const UiSlider& slider) {
+    if (panel.numSliders == UI_MAX_SLIDERS) return -1;
+    panel.sliders[panel.numSliders] = slider;
+    panel.dirty = true; // Layout changed
+    if (slider.label) TextLoadFont(GLUT_BITMAP_TIMES_ROMAN_24);
+    return panel.numSliders++;
+}
+
+void UiSetSliderValue(UiPanel& panel, int slider, double value) {
+    if (panel.sliders[slider].value == value) return;
+    panel.sliders[slider].value = value;
+    panel.dirty = true;
+}
+
+// --- Hit testing ---
+// Bounding rect of the knob, in panel pixels
+static UiRect knobRect(const UiSlider& slider, double value) {
+    UiRect r;
+    r.x = (int)(slider.knobX + value) - slider.knobHalfWidth;
+    r.y = slider.knobBottom;
+    r.w = 2 * slider.knobHalfWidth;
+    r.h = slider.knobTop - slider.knobBottom;
+    return r;
+}
+
+static bool contains(const UiRect& r, int x, int y) {
+    return x >= r.x && x <= r.x + r.w && y >= r.y && y <= r.y + r.h;
+}
+
+int UiHitTest(const UiPanel& panel, const double* values, int windowX, int windowY) {
+    int x = windowX - panel.viewport.x;
+    int y = windowY - panel.viewport.y;
+
+    for (int i = 0; i < panel.numSliders; i++)
+        if (contains(knobRect(panel.sliders[i], values[i]), x, y))
+            return i;
+    return -1;
+}
+
+bool UiPanelContains(const UiPanel& panel, int windowX, int windowY) {
+    const UiRect& r = panel.viewport;
+    return windowX >= r.x && windowX < r.x + r.w && windowY >= r.y && windowY < r.y + r.h;
+}
+
+bool UiSliderDrag(const UiPanel& panel, int slider, int windowX, double* value) {
+    const UiSlider& s = panel.sliders[slider];
+    double offset = windowX - panel.viewport.x - s.knobX;
+
+    if (offset < s.minValue || offset > s.maxValue) return false; // Outside the slider area
+    *value = offset;
+    return true;
+}
+
+// --- Drawing ---
+static void drawSlider(const UiSlider& slider) {
+    if (slider.label) // Queued, drawn with the other labels at the end of the panel
+        TextPrint(GLUT_BITMAP_TIMES_ROMAN_24, slider.labelX, slider.labelY, 1, 1, 1, slider.label);
+
+    // Background strip
+    if (slider.box.w > 0) {
+        glColor3d(0.4, 0.4, 0.4);
+        glBegin(GL_POLYGON);
+        glVertex2d(slider.box.x, slider.box.y + slider.box.h);
+        glVertex2d(slider.box.x + slider.box.w, slider.box.y + slider.box.h);
+        glVertex2d(slider.box.x + slider.box.w, slider.box.y);
+        glVertex2d(slider.box.x, slider.box.y);
+        glEnd();
+    }
+
+    // Slider line
+    glColor3d(0, 0, 0);
+    glLineWidth(2);
+    glBegin(GL_LINES);
+    glVertex2d(slider.lineX0, slider.lineY);
+    glVertex2d(slider.lineX1, slider.lineY);
+    glEnd();
+    glLineWidth(1);
+
+    // Knob
+    double center = slider.knobX + slider.value;
+    glColor3d(1, 0, 0);
+    glBegin(GL_POLYGON);
+    glVertex2d(center, slider.knobTop);
+    glVertex2d(center + slider.knobHalfWidth, slider.knobMid);
+    glVertex2d(center + slider.knobHalfWidth, slider.knobBottom);
+    glVertex2d(center - slider.knobHalfWidth, slider.knobBottom);
+    glVertex2d(center - slider.knobHalfWidth, slider.knobMid);
+    glEnd();
+}
+
+// Draws the whole panel with the current projection (panel pixels)
+static void drawWidgets(const UiPanel& panel) {
+    int w = panel.viewport.w, h = panel.viewport.h;
+
+    glColor3d(panel.background[0], panel.background[1], panel.background[2]);
+    glBegin(GL_POLYGON);
+    glVertex2d(0, 0);
+    glVertex2d(0, h);
+    glVertex2d(w, h);
+    glVertex2d(w, 0);
+    glEnd();
+
+    for (int i = 0; i < panel.numSliders; i++)
+        drawSlider(panel.sliders[i]);
+    TextFlush();
+}
+
+void UiDraw(UiPanel& panel) {
+    int w = panel.viewport.w, h = panel.viewport.h;
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, w, 0, h, -1, 1); // Panel pixels
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    if (panel.fbo == 0) { // No render target: immediate drawing every frame
+        glViewport(panel.viewport.x, panel.viewport.y, w, h);
+        drawWidgets(panel);
+    }
+    else {
+        if (panel.dirty) { // Re-render the cached texture
+            glBindFramebuffer(GL_FRAMEBUFFER, panel.fbo);
+            glViewport(0, 0, w, h);
+            drawWidgets(panel);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        // Composite with one textured quad
+        glViewport(panel.viewport.x, panel.viewport.y, w, h);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, panel.texture);
+        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+        glBegin(GL_QUADS);
+        glTexCoord2d(0, 0); glVertex2d(0, 0);
+        glTexCoord2d(1, 0); glVertex2d(w, 0);
+        glTexCoord2d(1, 1); glVertex2d(w, h);
+        glTexCoord2d(0, 1); glVertex2d(0, h);
+        glEnd();
+        glDisable(GL_TEXTURE_2D);
+    }
+    panel.dirty = false;
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+void UiRelease(UiPanel& panel) {
+    if (panel.fbo) glDeleteFramebuffers(1, &panel.fbo);
+    if (panel.texture) glDeleteTextures(1, &panel.texture);
+    panel.fbo = 0;
+    panel.texture = 0;
+    panel.dirty = true;
+}
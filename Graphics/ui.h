@@ -0,0 +1,50 @@
+#pragma once
+#include "glew.h"
+
+// --- Retained-mode slider UI ---
+// The panel keeps its widgets between frames and renders them into a cached
+// texture only when a slider value or the layout changes. Every other frame
+// it is composited with a single textured quad.
+
+const int UI_MAX_SLIDERS = 8;
+
+// Rectangle in panel pixels, origin at the bottom-left corner
+struct UiRect {
+    int x, y, w, h;
+};
+
+struct UiSlider {
+    const char* label;            // Heading above the slider (NULL for none)
+    int labelX, labelY;           // Heading position
+    UiRect box;                   // Background strip (w == 0 for none)
+    int lineX0, lineX1, lineY;    // Slider line
+    int knobX;                    // Knob center at value 0
+    int knobBottom, knobMid, knobTop, knobHalfWidth; // Knob shape
+    double minValue, maxValue;    // Drag range, as offset from knobX
+    double value;                 // Current offset from knobX (render thread)
+};
+
+struct UiPanel {
+    UiRect viewport;              // Panel position in the window
+    double background[3];         // Panel background color
+    UiSlider sliders[UI_MAX_SLIDERS];
+    int numSliders;
+    bool dirty;                   // Cached texture is out of date
+    GLuint fbo, texture;          // Cached panel (0 when FBOs are unavailable)
+};
+
+// Layout (done once at init, before other threads read the panel)
+void UiInitPanel(UiPanel& panel, UiRect viewport, double r, double g, double b);
+int UiAddSlider(UiPanel& panel, const UiSlider& slider);
+
+// Render thread
+void UiSetSliderValue(UiPanel& panel, int slider, double value);
+void UiDraw(UiPanel& panel); // Sets its own viewport and projection
+void UiRelease(UiPanel& panel);
+
+// Hit testing against the widget rects. Takes the caller's own slider values,
+// so it can run on the simulation thread while the panel is being drawn.
+// Window coordinates have their origin at the bottom-left corner.
+int UiHitTest(const UiPanel& panel, const double* values, int windowX, int windowY);
+bool UiPanelContains(const UiPanel& panel, int windowX, int windowY); // Anywhere on the panel, knobs or not
+bool UiSliderDrag(const UiPanel& panel, int slider, int windowX, double* value);
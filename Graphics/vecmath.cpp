@@ -0,0 +1,137 @@
+#include "vecmath.h"
+
+// --- Matrix builders ---
+Matrix4 MatFromQuat(const Quat& q) {
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    Matrix4 r = { {
+        1 - 2 * (yy + zz), 2 * (xy + wz),     2 * (xz - wy),     0,
+        2 * (xy - wz),     1 - 2 * (xx + zz), 2 * (yz + wx),     0,
+        2 * (xz + wy),     2 * (yz - wx),     1 - 2 * (xx + yy), 0,
+        0, 0, 0, 1 } };
+    return r;
+}
+
+Quat QuatSlerp(const Quat& a, const Quat& b, float t) {
+    Quat to = b;
+    float cosTheta = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    if (cosTheta < 0) { // Take the short way around
+        cosTheta = -cosTheta;
+        to.x = -b.x; to.y = -b.y; to.z = -b.z; to.w = -b.w;
+    }
+
+    float wa = 1 - t, wb = t;
+    if (cosTheta < 0.9995f) { // Fall back to lerp when nearly parallel
+        float theta = acosf(cosTheta), s = sinf(theta);
+        wa = sinf((1 - t) * theta) / s;
+        wb = sinf(t * theta) / s;
+    }
+    Quat r = { a.x * wa + to.x * wb, a.y * wa + to.y * wb, a.z * wa + to.z * wb, a.w * wa + to.w * wb };
+    return QuatNormalize(r);
+}
+
+Matrix4 MatLookAt(const Vec3& eye, const Vec3& center, const Vec3& up) {
+    Vec3 f = Normalize(center - eye);
+    Vec3 s = Normalize(Cross(f, up));
+    Vec3 u = Cross(s, f);
+    Matrix4 r = { {
+        s.x, u.x, -f.x, 0,
+        s.y, u.y, -f.y, 0,
+        s.z, u.z, -f.z, 0,
+        -Dot(s, eye), -Dot(u, eye), Dot(f, eye), 1 } };
+    return r;
+}
+
+Matrix4 MatFrustum(float left, float right, float bottom, float top, float zNear, float zFar) {
+    Matrix4 r = { {
+        2 * zNear / (right - left), 0, 0, 0,
+        0, 2 * zNear / (top - bottom), 0, 0,
+        (right + left) / (right - left), (top + bottom) / (top - bottom), -(zFar + zNear) / (zFar - zNear), -1,
+        0, 0, -2 * zFar * zNear / (zFar - zNear), 0 } };
+    return r;
+}
+
+Matrix4 MatOrtho(float left, float right, float bottom, float top, float zNear, float zFar) {
+    Matrix4 r = { {
+        2 / (right - left), 0, 0, 0,
+        0, 2 / (top - bottom), 0, 0,
+        0, 0, -2 / (zFar - zNear), 0,
+        -(right + left) / (right - left), -(top + bottom) / (top - bottom), -(zFar + zNear) / (zFar - zNear), 1 } };
+    return r;
+}
+
+// General inverse by cofactors; returns identity for a singular matrix
+Matrix4 MatInverse(const Matrix4& mat) {
+    const float* m = mat.m;
+    Matrix4 r;
+    float* inv = r.m;
+
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0) return MatIdentity();
+
+    float invDet = 1.0f / det;
+    for (int i = 0; i < 16; i++) inv[i] *= invDet;
+    return r;
+}
+
+// --- Batched transforms ---
+void TransformPoints(const Matrix4& m, const Vec3* in, Vec4* out, int count) {
+#ifdef VECMATH_SSE
+    __m128 c0 = _mm_loadu_ps(m.m), c1 = _mm_loadu_ps(m.m + 4), c2 = _mm_loadu_ps(m.m + 8), c3 = _mm_loadu_ps(m.m + 12);
+    for (int i = 0; i < count; i++) {
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[i].x)), _mm_mul_ps(c1, _mm_set1_ps(in[i].y))),
+                              _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(in[i].z)), c3));
+        _mm_storeu_ps(&out[i].x, r);
+    }
+#else
+    for (int i = 0; i < count; i++)
+        out[i] = MatTransform(m, MakeVec4(in[i].x, in[i].y, in[i].z, 1));
+#endif
+}
+
+void TransformPointsSoA(const Matrix4& m, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, float* outW, int count) {
+    int i = 0;
+#ifdef VECMATH_SSE
+    __m128 e[16];
+    for (int k = 0; k < 16; k++) e[k] = _mm_set1_ps(m.m[k]);
+
+    for (; i + 4 <= count; i += 4) { // Four points per step, one lane each
+        __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        _mm_storeu_ps(outX + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[0], px), _mm_mul_ps(e[4], py)), _mm_add_ps(_mm_mul_ps(e[8], pz), e[12])));
+        _mm_storeu_ps(outY + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[1], px), _mm_mul_ps(e[5], py)), _mm_add_ps(_mm_mul_ps(e[9], pz), e[13])));
+        _mm_storeu_ps(outZ + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[2], px), _mm_mul_ps(e[6], py)), _mm_add_ps(_mm_mul_ps(e[10], pz), e[14])));
+        _mm_storeu_ps(outW + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[3], px), _mm_mul_ps(e[7], py)), _mm_add_ps(_mm_mul_ps(e[11], pz), e[15])));
+    }
+#endif
+    for (; i < count; i++) { // Remainder
+        Vec4 r = MatTransform(m, MakeVec4(x[i], y[i], z[i], 1));
+        outX[i] = r.x;
+        outY[i] = r.y;
+        outZ[i] = r.z;
+        outW[i] = r.w;
+    }
+}
+
+void MultiplyMatrices(const Matrix4& a, const Matrix4* b, Matrix4* out, int count) {
+    for (int i = 0; i < count; i++)
+        out[i] = MatMultiply(a, b[i]);
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <math.h>
+
+// --- Float vector / matrix math ---
+// CPU-side transforms in single precision. Matrices are column-major like
+// OpenGL, so a Matrix4 can go straight to glLoadMatrixf/glMultMatrixf.
+// MatTranslate/MatScale/MatRotate post-multiply in place exactly like
+// glTranslated/glScaled/glRotated do on the current matrix.
+// Matrix work uses SSE2 when available; storage is plain floats (loaded
+// unaligned), so matrices can live in std::vector and packed arrays.
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define VECMATH_SSE 1
+#include <emmintrin.h>
+#endif
+
+const float VECMATH_PI = 3.14159265358979323846f;
+
+struct Vec3 {
+    float x, y, z;
+};
+
+struct Vec4 {
+    float x, y, z, w;
+};
+
+struct Quat {
+    float x, y, z, w; // w is the scalar part
+};
+
+struct Matrix4 {
+    float m[16];
+};
+
+// --- Vec3 ---
+inline Vec3 MakeVec3(float x, float y, float z) { Vec3 v = { x, y, z }; return v; }
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return MakeVec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return MakeVec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator*(const Vec3& a, float s) { return MakeVec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator-(const Vec3& a) { return MakeVec3(-a.x, -a.y, -a.z); }
+inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross(const Vec3& a, const Vec3& b) {
+    return MakeVec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float Length(const Vec3& a) { return sqrtf(Dot(a, a)); }
+inline Vec3 Normalize(const Vec3& a) {
+    float len = Length(a);
+    return len > 0 ? a * (1.0f / len) : a;
+}
+inline Vec3 Min(const Vec3& a, const Vec3& b) {
+    return MakeVec3(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z);
+}
+inline Vec3 Max(const Vec3& a, const Vec3& b) {
+    return MakeVec3(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z);
+}
+
+// --- Vec4 ---
+inline Vec4 MakeVec4(float x, float y, float z, float w) { Vec4 v = { x, y, z, w }; return v; }
+inline Vec3 XYZ(const Vec4& v) { return MakeVec3(v.x, v.y, v.z); }
+
+// --- Matrix4 ---
+inline Matrix4 MatIdentity() {
+    Matrix4 r = { { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } };
+    return r;
+}
+
+inline Matrix4 MatMultiply(const Matrix4& a, const Matrix4& b) {
+    Matrix4 r;
+#ifdef VECMATH_SSE
+    __m128 a0 = _mm_loadu_ps(a.m), a1 = _mm_loadu_ps(a.m + 4), a2 = _mm_loadu_ps(a.m + 8), a3 = _mm_loadu_ps(a.m + 12);
+    for (int col = 0; col < 4; col++) {
+        const float* bc = b.m + col * 4;
+        __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(bc[0])), _mm_mul_ps(a1, _mm_set1_ps(bc[1]))),
+                              _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(bc[2])), _mm_mul_ps(a3, _mm_set1_ps(bc[3]))));
+        _mm_storeu_ps(r.m + col * 4, c);
+    }
+#else
+    for (int col = 0; col < 4; col++)
+        for (int row = 0; row < 4; row++)
+            r.m[col * 4 + row] = a.m[0 * 4 + row] * b.m[col * 4 + 0] + a.m[1 * 4 + row] * b.m[col * 4 + 1]
+                               + a.m[2 * 4 + row] * b.m[col * 4 + 2] + a.m[3 * 4 + row] * b.m[col * 4 + 3];
+#endif
+    return r;
+}
+
+inline Vec4 MatTransform(const Matrix4& m, const Vec4& v) {
+    Vec4 r;
+#ifdef VECMATH_SSE
+    __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m.m), _mm_set1_ps(v.x)), _mm_mul_ps(_mm_loadu_ps(m.m + 4), _mm_set1_ps(v.y))),
+                          _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m.m + 8), _mm_set1_ps(v.z)), _mm_mul_ps(_mm_loadu_ps(m.m + 12), _mm_set1_ps(v.w))));
+    _mm_storeu_ps(&r.x, c);
+#else
+    r.x = m.m[0] * v.x + m.m[4] * v.y + m.m[8] * v.z + m.m[12] * v.w;
+    r.y = m.m[1] * v.x + m.m[5] * v.y + m.m[9] * v.z + m.m[13] * v.w;
+    r.z = m.m[2] * v.x + m.m[6] * v.y + m.m[10] * v.z + m.m[14] * v.w;
+    r.w = m.m[3] * v.x + m.m[7] * v.y + m.m[11] * v.z + m.m[15] * v.w;
+#endif
+    return r;
+}
+
+inline Vec3 MatTransformPoint(const Matrix4& m, const Vec3& p) {
+    return XYZ(MatTransform(m, MakeVec4(p.x, p.y, p.z, 1)));
+}
+
+inline Vec3 MatTransformVector(const Matrix4& m, const Vec3& v) {
+    return XYZ(MatTransform(m, MakeVec4(v.x, v.y, v.z, 0)));
+}
+
+inline void MatTranslate(Matrix4& m, double x, double y, double z) {
+    Vec4 c = MatTransform(m, MakeVec4((float)x, (float)y, (float)z, 1));
+    m.m[12] = c.x; m.m[13] = c.y; m.m[14] = c.z; m.m[15] = c.w;
+}
+
+inline void MatScale(Matrix4& m, double x, double y, double z) {
+    for (int row = 0; row < 4; row++) {
+        m.m[row] *= (float)x;
+        m.m[4 + row] *= (float)y;
+        m.m[8 + row] *= (float)z;
+    }
+}
+
+// Rotation of angle radians around a unit axis
+inline Matrix4 MatAxisAngle(const Vec3& axis, float angle) {
+    float c = cosf(angle), s = sinf(angle), t = 1 - c;
+    float x = axis.x, y = axis.y, z = axis.z;
+    Matrix4 r = { {
+        t * x * x + c,     t * x * y + s * z, t * x * z - s * y, 0,
+        t * x * y - s * z, t * y * y + c,     t * y * z + s * x, 0,
+        t * x * z + s * y, t * y * z - s * x, t * z * z + c,     0,
+        0, 0, 0, 1 } };
+    return r;
+}
+
+// Angle in degrees around the (x, y, z) axis, like glRotated
+inline void MatRotate(Matrix4& m, double angle, double x, double y, double z) {
+    Vec3 axis = MakeVec3((float)x, (float)y, (float)z);
+    if (Length(axis) == 0) return;
+    m = MatMultiply(m, MatAxisAngle(Normalize(axis), (float)angle * VECMATH_PI / 180.0f));
+}
+
+inline Vec3 MatGetTranslation(const Matrix4& m) {
+    return MakeVec3(m.m[12], m.m[13], m.m[14]);
+}
+
+// --- Quaternions ---
+inline Quat QuatIdentity() { Quat q = { 0, 0, 0, 1 }; return q; }
+
+inline Quat QuatAxisAngle(const Vec3& axis, float angle) {
+    Vec3 a = Normalize(axis) * sinf(angle * 0.5f);
+    Quat q = { a.x, a.y, a.z, cosf(angle * 0.5f) };
+    return q;
+}
+
+inline Quat QuatMultiply(const Quat& a, const Quat& b) {
+    Quat q = {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z };
+    return q;
+}
+
+inline Quat QuatNormalize(const Quat& q) {
+    float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    Quat r = { q.x / len, q.y / len, q.z / len, q.w / len };
+    return r;
+}
+
+inline Vec3 QuatRotate(const Quat& q, const Vec3& v) {
+    Vec3 u = MakeVec3(q.x, q.y, q.z);
+    Vec3 t = Cross(u, v) * 2.0f;
+    return v + t * q.w + Cross(u, t);
+}
+
+// --- Matrix builders and batched transforms (vecmath.cpp) ---
+Matrix4 MatFromQuat(const Quat& q);
+Quat QuatSlerp(const Quat& a, const Quat& b, float t);
+Matrix4 MatLookAt(const Vec3& eye, const Vec3& center, const Vec3& up); // Like gluLookAt
+Matrix4 MatFrustum(float left, float right, float bottom, float top, float zNear, float zFar); // Like glFrustum
+Matrix4 MatOrtho(float left, float right, float bottom, float top, float zNear, float zFar); // Like glOrtho
+Matrix4 MatInverse(const Matrix4& m);
+
+// out[i] = m * (in[i], 1)
+void TransformPoints(const Matrix4& m, const Vec3* in, Vec4* out, int count);
+// Structure-of-arrays variant, four points per step
+void TransformPointsSoA(const Matrix4& m, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, float* outW, int count);
+// out[i] = a * b[i]
+void MultiplyMatrices(const Matrix4& a, const Matrix4* b, Matrix4* out, int count);
@@ -0,0 +1,215 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "glew.h"
+#include "glut.h"
+#include "frame_arena.h"
+#include "vertex_format.h"
+
+static const float QUANTIZED_MAX = 32767.0f; // Positions and normals use the symmetric snorm16 range
+
+// --- Scalar packing ---
+unsigned short FloatToHalf(float value) {
+    unsigned bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    unsigned mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF) return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0)); // Inf, NaN
+    if (exponent >= 31) return (unsigned short)(sign | 0x7C00); // Too large
+    if (exponent <= 0) { // Subnormal half, or zero
+        if (exponent < -10) return (unsigned short)sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        unsigned half = mantissa >> shift;
+        unsigned rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++; // Round to nearest even
+        return (unsigned short)(sign | half);
+    }
+
+    unsigned half = sign | (exponent << 10) | (mantissa >> 13);
+    unsigned rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // May carry into the exponent, which is right
+    return (unsigned short)half;
+}
+
+float HalfToFloat(unsigned short half) {
+    unsigned sign = (half & 0x8000) << 16;
+    unsigned exponent = (half >> 10) & 0x1F;
+    unsigned mantissa = half & 0x3FF;
+    unsigned bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        }
+        else { // Subnormal: normalize it
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    }
+    else if (exponent == 31) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static short toSnorm16(float value) {
+    if (value > 1) value = 1;
+    if (value < -1) value = -1;
+    return (short)floorf(value * QUANTIZED_MAX + 0.5f);
+}
+
+static float signNotZero(float value) {
+    return value >= 0 ? 1.0f : -1.0f;
+}
+
+// Projects onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the upper
+void OctEncode(const Vec3& normal, short out[2]) {
+    float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if (l1 == 0) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = normal.x / l1, y = normal.y / l1;
+    if (normal.z < 0) {
+        float foldedX = (1 - fabsf(y)) * signNotZero(x);
+        float foldedY = (1 - fabsf(x)) * signNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+Vec3 OctDecode(const short in[2]) {
+    float x = in[0] / QUANTIZED_MAX, y = in[1] / QUANTIZED_MAX;
+    float z = 1 - fabsf(x) - fabsf(y);
+    if (z < 0) {
+        float unfoldedX = (1 - fabsf(y)) * signNotZero(x);
+        float unfoldedY = (1 - fabsf(x)) * signNotZero(y);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    return Normalize(MakeVec3(x, y, z));
+}
+
+// --- Positions ---
+VertexQuantization QuantizationFromBounds(const Vec3& min, const Vec3& max) {
+    VertexQuantization q;
+    q.offset = (min + max) * 0.5f;
+    Vec3 half = (max - min) * 0.5f;
+    q.scale = MakeVec3(half.x > 0 ? half.x / QUANTIZED_MAX : 1, half.y > 0 ? half.y / QUANTIZED_MAX : 1,
+        half.z > 0 ? half.z / QUANTIZED_MAX : 1);
+    return q;
+}
+
+Matrix4 QuantizationMatrix(const VertexQuantization& quantization) {
+    Matrix4 m = MatIdentity();
+    MatTranslate(m, quantization.offset.x, quantization.offset.y, quantization.offset.z);
+    MatScale(m, quantization.scale.x, quantization.scale.y, quantization.scale.z);
+    return m;
+}
+
+Vec3 UnpackPosition(const PackedVertex& vertex, const VertexQuantization& quantization) {
+    const Vec3& o = quantization.offset;
+    const Vec3& s = quantization.scale;
+    return MakeVec3(o.x + vertex.position[0] * s.x, o.y + vertex.position[1] * s.y, o.z + vertex.position[2] * s.z);
+}
+
+// --- Meshes ---
+void ComputeNormals(const Vec3* positions, int vertexCount, const unsigned* indices, int indexCount, Vec3* normals) {
+    for (int i = 0; i < vertexCount; i++) normals[i] = MakeVec3(0, 0, 0);
+    for (int i = 0; i + 2 < indexCount; i += 3) {
+        const Vec3& a = positions[indices[i]];
+        Vec3 n = Cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a); // Length is twice the area
+        for (int k = 0; k < 3; k++) normals[indices[i + k]] = normals[indices[i + k]] + n;
+    }
+    for (int i = 0; i < vertexCount; i++) {
+        if (Dot(normals[i], normals[i]) > 0) normals[i] = Normalize(normals[i]);
+    }
+}
+
+void PackMesh(PackedMesh& mesh, const Vec3* positions, const Vec3* normals, const float* uvs, int vertexCount,
+    const unsigned* indices, int indexCount) {
+    assert(vertexCount <= 65536 && "16-bit indices cannot reach every vertex; split the mesh");
+    Vec3 lo = vertexCount ? positions[0] : MakeVec3(0, 0, 0), hi = lo;
+    for (int i = 1; i < vertexCount; i++) {
+        lo = Min(lo, positions[i]);
+        hi = Max(hi, positions[i]);
+    }
+    mesh.quantization = QuantizationFromBounds(lo, hi);
+    const VertexQuantization& q = mesh.quantization;
+
+    mesh.vertices.resize(vertexCount);
+    for (int i = 0; i < vertexCount; i++) {
+        PackedVertex& v = mesh.vertices[i];
+        Vec3 p = positions[i] - q.offset;
+        v.position[0] = (short)floorf(p.x / q.scale.x + 0.5f);
+        v.position[1] = (short)floorf(p.y / q.scale.y + 0.5f);
+        v.position[2] = (short)floorf(p.z / q.scale.z + 0.5f);
+        v.pad = 0;
+        if (normals) OctEncode(normals[i], v.normal);
+        else v.normal[0] = v.normal[1] = 0;
+        v.uv[0] = FloatToHalf(uvs ? uvs[i * 2] : 0);
+        v.uv[1] = FloatToHalf(uvs ? uvs[i * 2 + 1] : 0);
+    }
+    mesh.indices.assign(indices, indices + indexCount);
+    mesh.vertexData = mesh.vertices.empty() ? 0 : &mesh.vertices[0];
+    mesh.indexData = mesh.indices.empty() ? 0 : &mesh.indices[0];
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+}
+
+void PackedMeshMap(PackedMesh& mesh, const PackedVertex* vertices, int vertexCount, const unsigned short* indices,
+    int indexCount, const VertexQuantization& quantization) {
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.vertexData = vertices;
+    mesh.indexData = indices;
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+    mesh.quantization = quantization;
+}
+
+// Without half-float vertex arrays the UVs are widened to floats in the
+// frame arena each draw, which costs time but keeps textures mapped
+void PackedMeshDraw(const PackedMesh& mesh) {
+    if (mesh.indexCount == 0) return;
+    const PackedVertex* v = mesh.vertexData;
+    bool halfUv = GLEW_ARB_half_float_vertex || GLEW_VERSION_3_0;
+
+    glPushMatrix();
+    glMultMatrixf(QuantizationMatrix(mesh.quantization).m);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_SHORT, sizeof(PackedVertex), v->position);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    if (halfUv) glTexCoordPointer(2, GL_HALF_FLOAT, sizeof(PackedVertex), v->uv);
+    else {
+        static bool reported = false;
+        if (!reported) printf("No half-float vertex arrays: packed UVs are widened to floats per draw\n");
+        reported = true;
+        float* uvs = FrameAllocArray<float>(mesh.vertexCount * 2);
+        for (int i = 0; i < mesh.vertexCount; i++) {
+            uvs[i * 2] = HalfToFloat(v[i].uv[0]);
+            uvs[i * 2 + 1] = HalfToFloat(v[i].uv[1]);
+        }
+        glTexCoordPointer(2, GL_FLOAT, 0, uvs);
+    }
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, mesh.indexData);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glPopMatrix();
+}
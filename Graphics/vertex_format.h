@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include "vecmath.h"
+
+// --- Compact vertex formats ---
+// Immediate mode streams every attribute as doubles: 64 bytes per vertex
+// with a normal and texture coordinates, which the driver then converts.
+// Generated meshes and terrain are stored in one of these instead:
+//   FloatVertex   32 bytes  float position, normal and texture coordinates
+//   PackedVertex  16 bytes  16-bit position quantized to the mesh bounds,
+//                           octahedral 16-bit normal, half-float UV
+// A packed position is dequantized by the mesh's scale and offset, which
+// are folded into the modelview matrix, so GL reads the shorts directly.
+// The scenes are unlit, so normals are packed for the shader paths and the
+// software rasterizer but not handed to fixed-function GL.
+
+// What glVertex3d, glNormal3d and glTexCoord2d send
+struct DoubleVertex {
+    double position[3];
+    double normal[3];
+    double uv[2];
+};
+
+struct FloatVertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+struct PackedVertex {
+    short position[3];   // Quantized, see VertexQuantization
+    short pad;           // Keeps the position 8-byte aligned
+    short normal[2];     // Octahedral, snorm16
+    unsigned short uv[2]; // Half floats
+};
+
+// position = offset + quantized * scale
+struct VertexQuantization {
+    Vec3 offset, scale;
+};
+
+// Drawn from vertexData and indexData, which point either into the vectors
+// (built at run time) or straight into a mapped asset pack
+struct PackedMesh {
+    std::vector<PackedVertex> vertices;
+    std::vector<unsigned short> indices; // Triangles; at most 65536 vertices, which PackMesh asserts
+    const PackedVertex* vertexData;
+    const unsigned short* indexData;
+    int vertexCount, indexCount;
+    VertexQuantization quantization;
+};
+
+unsigned short FloatToHalf(float value);
+float HalfToFloat(unsigned short half);
+void OctEncode(const Vec3& normal, short out[2]);
+Vec3 OctDecode(const short in[2]);
+
+VertexQuantization QuantizationFromBounds(const Vec3& min, const Vec3& max);
+Matrix4 QuantizationMatrix(const VertexQuantization& quantization); // Quantized -> local space
+Vec3 UnpackPosition(const PackedVertex& vertex, const VertexQuantization& quantization);
+
+// Area-weighted vertex normals of an indexed triangle list
+void ComputeNormals(const Vec3* positions, int vertexCount, const unsigned* indices, int indexCount, Vec3* normals);
+
+// Packs an indexed triangle list; normals and uvs (two floats per vertex) may be null
+void PackMesh(PackedMesh& mesh, const Vec3* positions, const Vec3* normals, const float* uvs, int vertexCount,
+    const unsigned* indices, int indexCount);
+// Uses arrays owned by someone else, such as an asset pack, in place
+void PackedMeshMap(PackedMesh& mesh, const PackedVertex* vertices, int vertexCount, const unsigned short* indices,
+    int indexCount, const VertexQuantization& quantization);
+void PackedMeshDraw(const PackedMesh& mesh); // Client arrays under the dequantization matrix